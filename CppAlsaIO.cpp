@@ -0,0 +1,429 @@
+/*------------------------------------------------------------------*\
+Implementation of the direct ALSA mmap backend.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <cerrno>
+#include <pthread.h>
+#include "CppAlsaIO.h"
+#include "CppRTA.h"
+
+static void throwAlsa(snd_pcm_t *pcm, const std::string &name, const std::string &what, int err) {
+    if (pcm != nullptr) {
+        snd_pcm_close(pcm);
+    }
+    throw std::invalid_argument("ALSA " + name + ": " + what + ": " + snd_strerror(err));
+}
+
+static inline char *areaAddr(const snd_pcm_channel_area_t &area, snd_pcm_uframes_t offset) {
+    return (char*) area.addr + (area.first + offset*area.step)/8;
+}
+
+static void readArea(const snd_pcm_channel_area_t &area, snd_pcm_uframes_t offset, uint32_t frames,
+                     snd_pcm_format_t format, float *dst) {
+    const char *src = areaAddr(area, offset);
+    uint32_t step = area.step/8;
+
+    switch (format) {
+    case SND_PCM_FORMAT_FLOAT:
+        for (uint32_t k=0; k<frames; k++) {
+            dst[k] = *(const float*) (src+k*step);
+        }
+        break;
+    case SND_PCM_FORMAT_S32:
+        for (uint32_t k=0; k<frames; k++) {
+            dst[k] = (float) (*(const int32_t*) (src+k*step)*(1.0/2147483648.0));
+        }
+        break;
+    default:
+        for (uint32_t k=0; k<frames; k++) {
+            dst[k] = *(const int16_t*) (src+k*step)*(1.0f/32768.0f);
+        }
+        break;
+    }
+}
+
+static void writeArea(const snd_pcm_channel_area_t &area, snd_pcm_uframes_t offset, uint32_t frames,
+                      snd_pcm_format_t format, const float *src) {
+    char *dst = areaAddr(area, offset);
+    uint32_t step = area.step/8;
+    double x;
+
+    switch (format) {
+    case SND_PCM_FORMAT_FLOAT:
+        for (uint32_t k=0; k<frames; k++) {
+            *(float*) (dst+k*step) = src[k];
+        }
+        break;
+    case SND_PCM_FORMAT_S32:
+        for (uint32_t k=0; k<frames; k++) {
+            x = std::min(std::max((double) src[k], -1.0), 1.0-1.0/2147483648.0);
+            *(int32_t*) (dst+k*step) = (int32_t) (x*2147483648.0);
+        }
+        break;
+    default:
+        for (uint32_t k=0; k<frames; k++) {
+            x = std::min(std::max((double) src[k], -1.0), 1.0-1.0/32768.0);
+            *(int16_t*) (dst+k*step) = (int16_t) (x*32768.0);
+        }
+        break;
+    }
+}
+
+CppAlsaIO::CppAlsaIO(void)
+    : capture(nullptr), playback(nullptr), captureFormat(SND_PCM_FORMAT_FLOAT), playbackFormat(SND_PCM_FORMAT_FLOAT),
+      rta(nullptr), running(false), realtime(false), xruns(0), periods(2), blockLen(0), numIns(0), numOuts(0),
+      priority(80), linked(false) {
+
+}
+
+CppAlsaIO::~CppAlsaIO(void) {
+    stop();
+}
+
+std::string CppAlsaIO::getPcmName(const deviceContainerRTA &dev) {
+    size_t start, end;
+
+    // PortAudio names hardware devices "card: device (hw:0,0)"
+    start = dev.name.rfind("(hw:");
+    end = dev.name.find(')', start);
+    if (dev.hostAPI != "ALSA" || start == std::string::npos || end == std::string::npos) {
+        return std::string();
+    }
+    return dev.name.substr(start+1, end-start-1);
+}
+
+int CppAlsaIO::setPeriods(uint32_t periods) {
+    if (periods < 2 || periods > 32) {
+        return -1;
+    }
+    this->periods = periods;
+    return 0;
+}
+
+int CppAlsaIO::setPriority(int priority) {
+    if (priority < 1 || priority > 99) {
+        return -1;
+    }
+    this->priority = priority;
+    return 0;
+}
+
+snd_pcm_t *CppAlsaIO::openPcm(const std::string &name, snd_pcm_stream_t stream, uint32_t numChans,
+                              snd_pcm_format_t &format) {
+    const snd_pcm_format_t formats[] = {SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S16};
+    snd_pcm_hw_params_t *hwParams;
+    snd_pcm_sw_params_t *swParams;
+    snd_pcm_uframes_t periodSize = blockLen, boundary;
+    snd_pcm_t *pcm = nullptr;
+    unsigned int rate = rta->getSampleRate(), numPeriods = periods;
+    uint32_t i;
+    int err;
+
+    err = snd_pcm_open(&pcm, name.c_str(), stream, 0);
+    if (err < 0) {
+        throwAlsa(nullptr, name, "open", err);
+    }
+
+    snd_pcm_hw_params_alloca(&hwParams);
+    snd_pcm_hw_params_any(pcm, hwParams);
+    if (snd_pcm_hw_params_set_access(pcm, hwParams, SND_PCM_ACCESS_MMAP_INTERLEAVED) < 0) {
+        err = snd_pcm_hw_params_set_access(pcm, hwParams, SND_PCM_ACCESS_MMAP_NONINTERLEAVED);
+        if (err < 0) {
+            throwAlsa(pcm, name, "no mmap access", err);
+        }
+    }
+
+    for (i=0; i<3 && snd_pcm_hw_params_test_format(pcm, hwParams, formats[i]) < 0; i++) {}
+    if (i == 3) {
+        throwAlsa(pcm, name, "no float, S32 or S16 format", -EINVAL);
+    }
+    format = formats[i];
+    snd_pcm_hw_params_set_format(pcm, hwParams, format);
+
+    err = snd_pcm_hw_params_set_channels(pcm, hwParams, numChans);
+    if (err < 0) {
+        throwAlsa(pcm, name, "channel count", err);
+    }
+    snd_pcm_hw_params_set_rate_resample(pcm, hwParams, 0);
+    err = snd_pcm_hw_params_set_rate(pcm, hwParams, rate, 0);
+    if (err < 0) {
+        throwAlsa(pcm, name, "sample rate", err);
+    }
+
+    // every transfer is exactly one processing block
+    err = snd_pcm_hw_params_set_period_size(pcm, hwParams, periodSize, 0);
+    if (err < 0) {
+        throwAlsa(pcm, name, "period size", err);
+    }
+    err = snd_pcm_hw_params_set_periods(pcm, hwParams, numPeriods, 0);
+    if (err < 0) {
+        throwAlsa(pcm, name, "period count", err);
+    }
+    err = snd_pcm_hw_params(pcm, hwParams);
+    if (err < 0) {
+        throwAlsa(pcm, name, "hardware parameters", err);
+    }
+
+    // wake up per period, started explicitly once the playback buffer is primed
+    snd_pcm_sw_params_alloca(&swParams);
+    snd_pcm_sw_params_current(pcm, swParams);
+    snd_pcm_sw_params_get_boundary(swParams, &boundary);
+    snd_pcm_sw_params_set_avail_min(pcm, swParams, blockLen);
+    snd_pcm_sw_params_set_start_threshold(pcm, swParams, boundary);
+    err = snd_pcm_sw_params(pcm, swParams);
+    if (err < 0) {
+        throwAlsa(pcm, name, "software parameters", err);
+    }
+
+    return pcm;
+}
+
+void CppAlsaIO::start(CppRTA *rta) {
+    stop();
+    this->rta = rta;
+    blockLen = rta->getBlockLen();
+    numIns = rta->getNumIns();
+    numOuts = rta->getNumOuts();
+
+    try {
+        playback = openPcm(playbackName, SND_PCM_STREAM_PLAYBACK, numOuts, playbackFormat);
+        if (!captureName.empty()) {
+            capture = openPcm(captureName, SND_PCM_STREAM_CAPTURE, numIns, captureFormat);
+        }
+    } catch (const std::invalid_argument &) {
+        stop();
+        throw;
+    }
+    linked = capture != nullptr && snd_pcm_link(capture, playback) == 0;
+
+    inScratch.assign(numIns, std::vector<float>(blockLen, 0.0f));
+    outScratch.assign(numOuts, std::vector<float>(blockLen, 0.0f));
+    inPtrs.resize(numIns);
+    for (uint32_t j=0; j<numIns; j++) {
+        inPtrs[j] = inScratch[j].data();
+    }
+    outPtrs.resize(numOuts);
+    destPtrs.resize(numOuts);
+    for (uint32_t i=0; i<numOuts; i++) {
+        outPtrs[i] = outScratch[i].data();
+    }
+
+    xruns.store(0);
+    if (!startStreams()) {
+        stop();
+        throw std::invalid_argument(std::string("ALSA: could not start the streams"));
+    }
+    running.store(true);
+    audioThread = std::thread(&CppAlsaIO::audioLoop, this);
+}
+
+void CppAlsaIO::stop() {
+    running.store(false);
+    if (audioThread.joinable()) {
+        audioThread.join();
+    }
+    if (capture != nullptr) {
+        snd_pcm_drop(capture);
+        if (linked) {
+            snd_pcm_unlink(capture);
+        }
+        snd_pcm_close(capture);
+        capture = nullptr;
+    }
+    if (playback != nullptr) {
+        snd_pcm_drop(playback);
+        snd_pcm_close(playback);
+        playback = nullptr;
+    }
+    linked = false;
+}
+
+bool CppAlsaIO::primePlayback() {
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset, frames, remaining = periods*blockLen;
+    snd_pcm_sframes_t committed;
+
+    // a full buffer of silence, the output then lags the input by exactly the buffer length
+    while (remaining > 0) {
+        frames = remaining;
+        if (snd_pcm_mmap_begin(playback, &areas, &offset, &frames) < 0) {
+            return false;
+        }
+        snd_pcm_areas_silence(areas, offset, numOuts, frames, playbackFormat);
+        committed = snd_pcm_mmap_commit(playback, offset, frames);
+        if (committed < 0 || (snd_pcm_uframes_t) committed != frames) {
+            return false;
+        }
+        remaining -= frames;
+    }
+    return true;
+}
+
+bool CppAlsaIO::startStreams() {
+    if (!primePlayback()) {
+        return false;
+    }
+    // linked streams start together
+    if (capture != nullptr && !linked && snd_pcm_start(capture) < 0) {
+        return false;
+    }
+    return snd_pcm_start(playback) >= 0;
+}
+
+bool CppAlsaIO::recover(int err) {
+    xruns.fetch_add(1, std::memory_order_relaxed);
+
+    if (err == -ESTRPIPE) {
+        // suspended, wait until the hardware is back
+        while (running.load() && snd_pcm_resume(playback) == -EAGAIN) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        while (running.load() && capture != nullptr && !linked && snd_pcm_resume(capture) == -EAGAIN) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    snd_pcm_drop(playback);
+    if (snd_pcm_prepare(playback) < 0) {
+        return false;
+    }
+    if (capture != nullptr) {
+        snd_pcm_drop(capture);
+        if (snd_pcm_prepare(capture) < 0) {
+            return false;
+        }
+    }
+    return startStreams();
+}
+
+bool CppAlsaIO::readCapture() {
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset, frames;
+    snd_pcm_sframes_t committed;
+    uint32_t done = 0;
+
+    if (capture == nullptr) {
+        return true;
+    }
+
+    // one period, in two parts if it wraps around the end of the ring
+    while (done < blockLen) {
+        frames = blockLen-done;
+        if (snd_pcm_mmap_begin(capture, &areas, &offset, &frames) < 0) {
+            return false;
+        }
+        for (uint32_t j=0; j<numIns; j++) {
+            readArea(areas[j], offset, frames, captureFormat, &inScratch[j][done]);
+        }
+        committed = snd_pcm_mmap_commit(capture, offset, frames);
+        if (committed < 0 || (snd_pcm_uframes_t) committed != frames) {
+            return false;
+        }
+        done += frames;
+    }
+    return true;
+}
+
+bool CppAlsaIO::writePlayback() {
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset, frames = blockLen;
+    snd_pcm_sframes_t committed;
+    uint32_t done = 0;
+    bool direct;
+
+    if (snd_pcm_mmap_begin(playback, &areas, &offset, &frames) < 0) {
+        return false;
+    }
+
+    // float samples in one contiguous part: the limiters write into the hardware ring
+    direct = playbackFormat == SND_PCM_FORMAT_FLOAT && frames == blockLen && areas[0].step%32 == 0;
+    for (uint32_t i=0; direct && i<numOuts; i++) {
+        direct = areas[i].step == areas[0].step && areas[i].first%32 == 0;
+        destPtrs[i] = (float*) areaAddr(areas[i], offset);
+    }
+    if (direct) {
+        rta->processBlock(inPtrs.data(), destPtrs.data(), areas[0].step/32);
+        committed = snd_pcm_mmap_commit(playback, offset, frames);
+        return committed >= 0 && (snd_pcm_uframes_t) committed == frames;
+    }
+
+    rta->processBlock(inPtrs.data(), outPtrs.data(), 1);
+    while (true) {
+        for (uint32_t i=0; i<numOuts; i++) {
+            writeArea(areas[i], offset, frames, playbackFormat, &outScratch[i][done]);
+        }
+        committed = snd_pcm_mmap_commit(playback, offset, frames);
+        if (committed < 0 || (snd_pcm_uframes_t) committed != frames) {
+            return false;
+        }
+        done += frames;
+        if (done >= blockLen) {
+            return true;
+        }
+        frames = blockLen-done;
+        if (snd_pcm_mmap_begin(playback, &areas, &offset, &frames) < 0) {
+            return false;
+        }
+    }
+}
+
+void CppAlsaIO::audioLoop() {
+    struct sched_param param;
+    snd_pcm_sframes_t avail;
+    int timeout = std::max(10, (int) (4000*(uint64_t) blockLen/rta->getSampleRate())), err;
+
+    param.sched_priority = priority;
+    realtime.store(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0);
+
+    while (running.load(std::memory_order_relaxed)) {
+        err = snd_pcm_wait(playback, timeout);
+        if (err == 0) {
+            continue;
+        }
+        if (err < 0) {
+            if (!recover(err)) {
+                break;
+            }
+            continue;
+        }
+
+        avail = snd_pcm_avail_update(playback);
+        if (avail < 0) {
+            if (!recover((int) avail)) {
+                break;
+            }
+            continue;
+        }
+        if (avail < (snd_pcm_sframes_t) blockLen) {
+            continue;
+        }
+
+        // linked streams run in lockstep, the capture period is due at the same time
+        if (capture != nullptr) {
+            avail = snd_pcm_avail_update(capture);
+            if (avail >= 0 && avail < (snd_pcm_sframes_t) blockLen) {
+                err = snd_pcm_wait(capture, timeout);
+                avail = (err < 0) ? err : snd_pcm_avail_update(capture);
+            }
+            if (avail < 0) {
+                if (!recover((int) avail)) {
+                    break;
+                }
+                continue;
+            }
+            if (avail < (snd_pcm_sframes_t) blockLen) {
+                continue;
+            }
+        }
+
+        if (!readCapture() || !writePlayback()) {
+            if (!recover(-EPIPE)) {
+                break;
+            }
+        }
+    }
+    running.store(false);
+}
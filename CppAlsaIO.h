@@ -0,0 +1,113 @@
+/*------------------------------------------------------------------*\
+Interface to a direct ALSA backend for CppRTA, compiled with
+VDSP_USE_ALSA. It bypasses PortAudio and drives the processing from a
+dedicated SCHED_FIFO thread that sleeps in snd_pcm_wait() until a full
+period can be transferred.
+
+The period size is the CppRTA block length and the buffer holds a
+configurable number of periods, so every transfer is exactly one
+period. Capture and playback are linked and started together, the
+playback buffer is primed with silence, which makes the latency
+deterministic: periods x block length on top of the converter delays.
+
+Transfers go through snd_pcm_mmap_begin/commit. With a float format the
+limiters write the output samples straight into the mmap area of the
+hardware ring; integer formats (S32, S16) are converted from a planar
+scratch block into it. Input is always converted into a planar scratch
+block. After an xrun both streams are prepared, primed and restarted.
+
+Without hardware it runs against any ALSA PCM, e.g. the "null" plugin
+for both directions, a "file" plugin or a snd-dummy card.
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPALSAIO_H // include guard
+#define _CPPALSAIO_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <alsa/asoundlib.h>
+#include "CppAudioBackend.h"
+
+struct deviceContainerRTA;
+
+class CppAlsaIO : public CppAudioBackend {
+
+public:
+    CppAlsaIO(void);
+
+    ~CppAlsaIO(void) override;
+
+    // PCM name ("hw:card,device") of a device PortAudio lists under its ALSA host API,
+    // empty if the device is no plain hardware device.
+    static std::string getPcmName(const deviceContainerRTA &dev);
+
+    // Number of periods in the hardware buffer, at least 2. Takes effect at start().
+    int setPeriods(uint32_t periods);
+
+    inline uint32_t getPeriods() const {
+        return periods;
+    }
+
+    // SCHED_FIFO priority of the audio thread (1 ... 99). Takes effect at start().
+    int setPriority(int priority);
+
+    // PCMs to open at start(), no capture if captureName is empty.
+    inline void setPcmNames(const std::string &captureName, const std::string &playbackName) {
+        this->captureName = captureName;
+        this->playbackName = playbackName;
+    }
+
+    // Opens both PCMs and starts the audio thread, throws std::invalid_argument on failure.
+    void start(CppRTA *rta) override;
+
+    void stop() override;
+
+    inline uint32_t getXrunCount() const override {
+        return xruns.load(std::memory_order_relaxed);
+    }
+
+    // false if the thread could not get SCHED_FIFO and runs at normal priority
+    inline bool isRealtime() const {
+        return realtime.load(std::memory_order_relaxed);
+    }
+
+    // frames between capture and playback of the same sample
+    inline uint32_t getLatency() const {
+        return periods*blockLen;
+    }
+
+private:
+    snd_pcm_t *openPcm(const std::string &name, snd_pcm_stream_t stream, uint32_t numChans,
+                       snd_pcm_format_t &format);
+
+    void audioLoop();
+
+    bool startStreams();
+
+    bool recover(int err);
+
+    bool primePlayback();
+
+    bool readCapture();
+
+    bool writePlayback();
+
+    snd_pcm_t *capture, *playback;
+    snd_pcm_format_t captureFormat, playbackFormat;
+    CppRTA *rta;
+    std::string captureName, playbackName;
+    std::thread audioThread;
+    std::vector< std::vector<float> > inScratch, outScratch;
+    std::vector<const float*> inPtrs;
+    std::vector<float*> outPtrs, destPtrs;
+    std::atomic<bool> running, realtime;
+    std::atomic<uint32_t> xruns;
+    uint32_t periods, blockLen, numIns, numOuts;
+    int priority;
+    bool linked;
+};
+
+#endif // end of include guard
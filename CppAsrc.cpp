@@ -0,0 +1,178 @@
+/*------------------------------------------------------------------*\
+Implementation of a polyphase ASRC with a PI loop on the buffer fill.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <cmath>
+#include "CppAsrc.h"
+
+#ifndef M_PI
+#define M_PI 3.141592653589793
+#endif
+
+// Kaiser window shape, sidelobes around -80 dB
+#define ASRC_KAISER_BETA 8.0
+
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+
+    for (uint32_t k=1; k<50 && term > 1e-20*sum; k++) {
+        term *= (x/(2.0*k))*(x/(2.0*k));
+        sum += term;
+    }
+    return sum;
+}
+
+CppAsrc::CppAsrc(void)
+    : ratio(1.0), pos(ASRC_TAPS/2), setpoint(0.0), fill(0.0), integ(0.0), kp(0.0), ki(0.0), smooth(1.0),
+      maxInput(0), fillValid(false) {
+    designTable();
+}
+
+CppAsrc::CppAsrc(uint32_t numChans, uint32_t blockLen, double sampleRate)
+    : ratio(1.0), pos(ASRC_TAPS/2), setpoint(0.0), fill(0.0), integ(0.0), kp(0.0), ki(0.0), smooth(1.0),
+      maxInput(0), fillValid(false) {
+    designTable();
+    setSize(numChans, blockLen, sampleRate);
+}
+
+void CppAsrc::designTable() {
+    double t, w, sum;
+
+    // row p holds the taps for a fractional position of p/ASRC_PHASES, tap i sits at
+    // the offset i-(ASRC_TAPS/2-1) from the integer position. The extra last row
+    // (position 1) lets the weights be interpolated between neighbouring rows.
+    table.assign((ASRC_PHASES+1)*ASRC_TAPS, 0.0);
+    for (uint32_t p=0; p<=ASRC_PHASES; p++) {
+        sum = 0.0;
+        for (uint32_t i=0; i<ASRC_TAPS; i++) {
+            t = (double) i-(ASRC_TAPS/2-1)-(double) p/ASRC_PHASES;
+            w = 1.0-(2.0*t/ASRC_TAPS)*(2.0*t/ASRC_TAPS);
+            w = (w > 0.0) ? besselI0(ASRC_KAISER_BETA*sqrt(w))/besselI0(ASRC_KAISER_BETA) : 0.0;
+            if (t == floor(t)) {
+                // integer positions are an exact unit impulse
+                table[p*ASRC_TAPS+i] = (t == 0.0) ? 1.0 : 0.0;
+            } else {
+                table[p*ASRC_TAPS+i] = w*sin(M_PI*t)/(M_PI*t);
+            }
+            sum += table[p*ASRC_TAPS+i];
+        }
+        // unity gain at DC for every phase
+        for (uint32_t i=0; i<ASRC_TAPS; i++) {
+            table[p*ASRC_TAPS+i] /= sum;
+        }
+    }
+}
+
+int CppAsrc::setSize(uint32_t numChans, uint32_t blockLen, double sampleRate) {
+    double wn, zeta = 0.7;
+
+    if (numChans < 1 || blockLen < 1 || sampleRate <= 0.0) {
+        return -1;
+    }
+
+    // pos stays below ASRC_TAPS/2+ratio, so a block never takes more than 1+len*ratio frames
+    maxInput = (uint32_t) ceil(1.0+blockLen*(1.0+ASRC_MAX_DEVIATION))+1;
+    work.assign(numChans, std::vector<double>(ASRC_TAPS+maxInput, 0.0));
+    index.assign(blockLen, 0);
+    weights.assign(blockLen*ASRC_TAPS, 0.0);
+
+    // the fill changes by blockLen*(drift-ratio) per block, a second order loop
+    // with natural frequency wn (rad per block) and damping zeta needs these gains
+    wn = 2.0*M_PI*ASRC_LOOP_BANDWIDTH*blockLen/sampleRate;
+    kp = 2.0*zeta*wn/blockLen;
+    ki = wn*wn/blockLen;
+    smooth = 1.0-exp(-(double) blockLen/(sampleRate*ASRC_FILL_SMOOTHING));
+
+    setRatio(1.0);
+    reset();
+    return 0;
+}
+
+void CppAsrc::setRatio(double ratio) {
+    this->ratio = std::min(std::max(ratio, 1.0-ASRC_MAX_DEVIATION), 1.0+ASRC_MAX_DEVIATION);
+    integ = this->ratio-1.0;
+}
+
+void CppAsrc::reset() {
+    for (uint32_t j=0; j<work.size(); j++) {
+        std::fill(work[j].begin(), work[j].end(), 0.0);
+    }
+    pos = ASRC_TAPS/2;
+    fillValid = false;
+}
+
+void CppAsrc::updateRatio(double fill) {
+    double err;
+
+    // smoothing removes the scheduling jitter of both callbacks from the measurement
+    if (!fillValid) {
+        this->fill = fill;
+        fillValid = true;
+    } else {
+        this->fill += smooth*(fill-this->fill);
+    }
+
+    err = this->fill-setpoint;
+    integ = std::min(std::max(integ+ki*err, -ASRC_MAX_DEVIATION), ASRC_MAX_DEVIATION);
+    ratio = std::min(std::max(1.0+integ+kp*err, 1.0-ASRC_MAX_DEVIATION), 1.0+ASRC_MAX_DEVIATION);
+}
+
+uint32_t CppAsrc::inputNeeded(uint32_t len) const {
+    // the last output frame reads up to ASRC_TAPS/2 frames after floor(pos+(len-1)*ratio)
+    return (uint32_t) floor(pos+(len-1)*ratio)+1-ASRC_TAPS/2;
+}
+
+void CppAsrc::process(const std::vector< std::vector<double> > &in, std::vector< std::vector<double> > &out, uint32_t len) {
+    uint32_t inLen = inputNeeded(len), chans = std::min((uint32_t) work.size(), (uint32_t) out.size());
+    double p, frac, acc[4];
+    const double *x, *h0, *h1, *w;
+    double *y, *wk;
+    uint32_t row;
+
+    len = std::min(len, (uint32_t) index.size());
+    inLen = std::min(inLen, maxInput);
+
+    // the weights of the block, shared by all channels: the two nearest
+    // table rows linearly interpolated to the exact fractional position
+    for (uint32_t k=0; k<len; k++) {
+        p = pos+k*ratio;
+        index[k] = (uint32_t) p+1-ASRC_TAPS/2;
+        frac = (p-floor(p))*ASRC_PHASES;
+        row = std::min((uint32_t) frac, (uint32_t) ASRC_PHASES-1);
+        frac -= row;
+        h0 = &table[row*ASRC_TAPS];
+        h1 = h0+ASRC_TAPS;
+        wk = &weights[k*ASRC_TAPS];
+        for (uint32_t i=0; i<ASRC_TAPS; i++) {
+            wk[i] = h0[i]+frac*(h1[i]-h0[i]);
+        }
+    }
+
+    for (uint32_t j=0; j<chans; j++) {
+        std::copy(in[j].begin(), in[j].begin()+inLen, work[j].begin()+ASRC_TAPS);
+        y = out[j].data();
+
+        // contiguous dot products of fixed length, four independent partial
+        // sums let the compiler vectorise without reordering any single sum
+        for (uint32_t k=0; k<len; k++) {
+            x = &work[j][index[k]];
+            w = &weights[k*ASRC_TAPS];
+            acc[0] = acc[1] = acc[2] = acc[3] = 0.0;
+            for (uint32_t i=0; i<ASRC_TAPS; i+=4) {
+                acc[0] += w[i]*x[i];
+                acc[1] += w[i+1]*x[i+1];
+                acc[2] += w[i+2]*x[i+2];
+                acc[3] += w[i+3]*x[i+3];
+            }
+            y[k] = (acc[0]+acc[1])+(acc[2]+acc[3]);
+        }
+
+        std::copy(work[j].begin()+inLen, work[j].begin()+inLen+ASRC_TAPS, work[j].begin());
+    }
+    for (uint32_t j=chans; j<out.size(); j++) {
+        std::fill(out[j].begin(), out[j].begin()+len, 0.0);
+    }
+
+    pos += len*ratio-inLen;
+}
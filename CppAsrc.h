@@ -0,0 +1,94 @@
+/*------------------------------------------------------------------*\
+Interface to an asynchronous sample rate converter for the drift
+between two devices on independent clocks. A polyphase interpolator
+reads the input at a fractional position that advances by the ratio
+(input frames per output frame) for every output frame. Its Kaiser
+windowed sinc table has ASRC_PHASES phases of ASRC_TAPS taps, the
+weights for the exact position are interpolated linearly between the
+two nearest phases (a first order Farrow structure over the table).
+
+The ratio is steered by a PI loop on the fill of the ring buffer in
+front of the converter (a software DLL): a fill above the set point
+means the input clock runs fast, so the ratio goes up and more input is
+consumed per block. The integrator converges to the relative clock
+drift, the proportional part pulls the fill back to the set point, so
+the latency stays bounded in long sessions without dropouts.
+
+The weights of a block are computed once and shared by all channels,
+the per channel work is one contiguous dot product per output frame,
+which the compiler vectorises. At a ratio of exactly 1 the output is
+the input delayed by ASRC_TAPS/2 frames, bit exact.
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPASRC_H // include guard
+#define _CPPASRC_H
+
+#include <vector>
+#include <cstdint>
+
+// interpolation filter length (a multiple of 4) and number of table phases
+#define ASRC_TAPS 16
+#define ASRC_PHASES 256
+// ratio limit around 1, far beyond the tolerance of real crystal clocks
+#define ASRC_MAX_DEVIATION 0.005
+// natural frequency of the fill control loop in Hz
+#define ASRC_LOOP_BANDWIDTH 0.05
+// time constant of the fill measurement smoothing in seconds
+#define ASRC_FILL_SMOOTHING 0.5
+
+class CppAsrc {
+
+public:
+    CppAsrc(void);
+
+    CppAsrc(uint32_t numChans, uint32_t blockLen, double sampleRate);
+
+    // Allocates for output blocks of up to blockLen frames. Not while processing.
+    int setSize(uint32_t numChans, uint32_t blockLen, double sampleRate);
+
+    // Fill of the ring buffer (measured before every read) the loop settles to.
+    inline void setSetpoint(double frames) {
+        setpoint = frames;
+    }
+
+    inline double getSetpoint() const {
+        return setpoint;
+    }
+
+    // Input frames per output frame, also restarts the loop integrator at this ratio.
+    void setRatio(double ratio);
+
+    inline double getRatio() const {
+        return ratio;
+    }
+
+    // Clears the interpolator history and the fill smoothing, keeps the drift estimate.
+    void reset();
+
+    // Control step with the current (estimated) fill, once per block before inputNeeded().
+    void updateRatio(double fill);
+
+    // Input frames the next process() call consumes for len output frames.
+    uint32_t inputNeeded(uint32_t len) const;
+
+    // Upper bound of inputNeeded() for blocks up to the allocated length.
+    inline uint32_t getMaxInput() const {
+        return maxInput;
+    }
+
+    // Converts inputNeeded(len) planar input frames into len output frames.
+    void process(const std::vector< std::vector<double> > &in, std::vector< std::vector<double> > &out, uint32_t len);
+
+private:
+    void designTable();
+
+    std::vector< std::vector<double> > work;
+    std::vector<uint32_t> index;
+    std::vector<double> table, weights;
+    double ratio, pos, setpoint, fill, integ;
+    double kp, ki, smooth;
+    uint32_t maxInput;
+    bool fillValid;
+};
+
+#endif // end of include guard
@@ -0,0 +1,29 @@
+/*------------------------------------------------------------------*\
+Interface of the audio backends that drive CppRTA themselves instead
+of through PortAudio (JACK, direct ALSA, null/loopback). A backend
+calls CppRTA::processBlock() once per block from its own thread and
+is started and stopped by CppRTA::startStream()/stopStream().
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPAUDIOBACKEND_H // include guard
+#define _CPPAUDIOBACKEND_H
+
+#include <cstdint>
+
+class CppRTA;
+
+class CppAudioBackend {
+
+public:
+    virtual ~CppAudioBackend(void) {}
+
+    // Starts processing rta, throws std::invalid_argument on failure.
+    virtual void start(CppRTA *rta) = 0;
+
+    virtual void stop() = 0;
+
+    // blocks that missed their deadline since start()
+    virtual uint32_t getXrunCount() const = 0;
+};
+
+#endif // end of include guard
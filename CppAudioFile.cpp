@@ -0,0 +1,647 @@
+/*------------------------------------------------------------------*\
+Implementation of the memory mapped audio file reader and the block
+aligned audio file writer.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include "CppAudioFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static inline uint16_t getLE16(const uint8_t *p) {
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+static inline uint32_t getLE32(const uint8_t *p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline uint64_t getLE64(const uint8_t *p) {
+    return (uint64_t) getLE32(p) | (uint64_t) getLE32(p+4) << 32;
+}
+
+static inline uint16_t getBE16(const uint8_t *p) {
+    return (uint16_t) (p[0] << 8 | p[1]);
+}
+
+static inline uint32_t getBE32(const uint8_t *p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | (uint32_t) p[3];
+}
+
+static inline uint64_t getBE64(const uint8_t *p) {
+    return (uint64_t) getBE32(p) << 32 | (uint64_t) getBE32(p+4);
+}
+
+static inline void putLE16(uint8_t *p, uint16_t x) {
+    p[0] = (uint8_t) x;
+    p[1] = (uint8_t) (x >> 8);
+}
+
+static inline void putLE32(uint8_t *p, uint32_t x) {
+    putLE16(p, (uint16_t) x);
+    putLE16(p+2, (uint16_t) (x >> 16));
+}
+
+static inline void putLE64(uint8_t *p, uint64_t x) {
+    putLE32(p, (uint32_t) x);
+    putLE32(p+4, (uint32_t) (x >> 32));
+}
+
+static inline void putBE16(uint8_t *p, uint16_t x) {
+    p[0] = (uint8_t) (x >> 8);
+    p[1] = (uint8_t) x;
+}
+
+static inline void putBE32(uint8_t *p, uint32_t x) {
+    putBE16(p, (uint16_t) (x >> 16));
+    putBE16(p+2, (uint16_t) x);
+}
+
+static inline void putBE64(uint8_t *p, uint64_t x) {
+    putBE32(p, (uint32_t) (x >> 32));
+    putBE32(p+4, (uint32_t) x);
+}
+
+static uint32_t getSampleBytes(sampleFormat format) {
+    switch (format) {
+    case SAMPLE_INT16:
+        return 2;
+    case SAMPLE_INT24:
+        return 3;
+    case SAMPLE_INT32:
+    case SAMPLE_FLOAT32:
+        return 4;
+    case SAMPLE_FLOAT64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+static sampleFormat getSampleFormat(bool isFloat, uint32_t bits) {
+    if (isFloat) {
+        return (bits == 32) ? SAMPLE_FLOAT32 : (bits == 64) ? SAMPLE_FLOAT64 : UNKNOWN_SAMPLEFORMAT;
+    }
+    return (bits == 16) ? SAMPLE_INT16 : (bits == 24) ? SAMPLE_INT24 : (bits == 32) ? SAMPLE_INT32 : UNKNOWN_SAMPLEFORMAT;
+}
+
+static bool isLittleEndianHost() {
+    const uint16_t probe = 1;
+    return *(const uint8_t*) &probe == 1;
+}
+
+// One channel of frames samples, step bytes apart, into contiguous floats.
+static void readSamples(const uint8_t *src, size_t step, uint32_t frames, sampleFormat format, bool bigEndian, float *dst) {
+    uint32_t u32;
+    uint64_t u64;
+    float f32;
+    double f64;
+
+    switch (format) {
+    case SAMPLE_INT16:
+        for (uint32_t k=0; k<frames; k++, src+=step) {
+            dst[k] = (int16_t) (bigEndian ? getBE16(src) : getLE16(src))*(1.0f/32768.0f);
+        }
+        break;
+    case SAMPLE_INT24:
+        for (uint32_t k=0; k<frames; k++, src+=step) {
+            u32 = bigEndian ? (uint32_t) src[0] << 24 | (uint32_t) src[1] << 16 | (uint32_t) src[2] << 8
+                            : (uint32_t) src[2] << 24 | (uint32_t) src[1] << 16 | (uint32_t) src[0] << 8;
+            dst[k] = (float) ((int32_t) u32*(1.0/2147483648.0));
+        }
+        break;
+    case SAMPLE_INT32:
+        for (uint32_t k=0; k<frames; k++, src+=step) {
+            dst[k] = (float) ((int32_t) (bigEndian ? getBE32(src) : getLE32(src))*(1.0/2147483648.0));
+        }
+        break;
+    case SAMPLE_FLOAT32:
+        for (uint32_t k=0; k<frames; k++, src+=step) {
+            u32 = bigEndian ? getBE32(src) : getLE32(src);
+            std::memcpy(&f32, &u32, 4);
+            dst[k] = f32;
+        }
+        break;
+    case SAMPLE_FLOAT64:
+        for (uint32_t k=0; k<frames; k++, src+=step) {
+            u64 = bigEndian ? getBE64(src) : getLE64(src);
+            std::memcpy(&f64, &u64, 8);
+            dst[k] = (float) f64;
+        }
+        break;
+    default:
+        std::fill(dst, dst+frames, 0.0f);
+        break;
+    }
+}
+
+// One channel of frames floats into little endian samples step bytes apart, integers clipped.
+static void writeSamples(const float *src, uint32_t frames, sampleFormat format, uint8_t *dst, size_t step) {
+    uint32_t u32;
+    uint64_t u64;
+    double x;
+
+    switch (format) {
+    case SAMPLE_INT16:
+        for (uint32_t k=0; k<frames; k++, dst+=step) {
+            x = std::min(std::max((double) src[k], -1.0), 1.0-1.0/32768.0);
+            putLE16(dst, (uint16_t) (int16_t) lrint(x*32768.0));
+        }
+        break;
+    case SAMPLE_INT24:
+        for (uint32_t k=0; k<frames; k++, dst+=step) {
+            x = std::min(std::max((double) src[k], -1.0), 1.0-1.0/8388608.0);
+            u32 = (uint32_t) (int32_t) lrint(x*8388608.0);
+            dst[0] = (uint8_t) u32;
+            dst[1] = (uint8_t) (u32 >> 8);
+            dst[2] = (uint8_t) (u32 >> 16);
+        }
+        break;
+    case SAMPLE_INT32:
+        for (uint32_t k=0; k<frames; k++, dst+=step) {
+            x = std::min(std::max((double) src[k], -1.0), 1.0-1.0/2147483648.0);
+            putLE32(dst, (uint32_t) (int32_t) llrint(x*2147483648.0));
+        }
+        break;
+    case SAMPLE_FLOAT32:
+        for (uint32_t k=0; k<frames; k++, dst+=step) {
+            std::memcpy(&u32, &src[k], 4);
+            putLE32(dst, u32);
+        }
+        break;
+    case SAMPLE_FLOAT64:
+        for (uint32_t k=0; k<frames; k++, dst+=step) {
+            x = src[k];
+            std::memcpy(&u64, &x, 8);
+            putLE64(dst, u64);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+CppAudioFileReader::CppAudioFileReader(void)
+    : base(nullptr), fileSize(0), dataOffset(0), numFrames(0), released(0), type(UNKNOWN_AUDIOFILE),
+      format(UNKNOWN_SAMPLEFORMAT), sampleRate(0.0), numChans(0), sampleBytes(0), planar(false), bigEndian(false),
+#ifdef _WIN32
+      fileHandle(INVALID_HANDLE_VALUE), mapHandle(NULL) {
+#else
+      fd(-1) {
+#endif
+
+}
+
+CppAudioFileReader::~CppAudioFileReader(void) {
+    close();
+}
+
+int CppAudioFileReader::map(const std::string &path) {
+    close();
+
+#ifdef _WIN32
+    LARGE_INTEGER size;
+
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0) {
+        close();
+        return -1;
+    }
+    fileSize = (uint64_t) size.QuadPart;
+    mapHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapHandle == NULL) {
+        close();
+        return -1;
+    }
+    base = (const uint8_t*) MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+    if (base == nullptr) {
+        close();
+        return -1;
+    }
+#else
+    struct stat info;
+    void *addr;
+
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+        close();
+        return -1;
+    }
+    fileSize = (uint64_t) info.st_size;
+    addr = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        close();
+        return -1;
+    }
+    // read ahead aggressively, pages behind the reader may go early
+    madvise(addr, fileSize, MADV_SEQUENTIAL);
+    base = (const uint8_t*) addr;
+#endif
+
+    released = 0;
+    return 0;
+}
+
+void CppAudioFileReader::close() {
+#ifdef _WIN32
+    if (base != nullptr) {
+        UnmapViewOfFile(base);
+    }
+    if (mapHandle != NULL) {
+        CloseHandle(mapHandle);
+        mapHandle = NULL;
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (base != nullptr) {
+        munmap((void*) base, fileSize);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+    base = nullptr;
+    fileSize = 0;
+    numFrames = 0;
+    numChans = 0;
+    type = UNKNOWN_AUDIOFILE;
+    format = UNKNOWN_SAMPLEFORMAT;
+}
+
+int CppAudioFileReader::open(const std::string &path) {
+    if (map(path) != 0) {
+        return -1;
+    }
+    planar = false;
+    bigEndian = false;
+    if (parseWav() != 0 && parseCaf() != 0) {
+        close();
+        return -1;
+    }
+    return 0;
+}
+
+int CppAudioFileReader::openRaw(const std::string &path, uint32_t numChans, double sampleRate,
+                                sampleFormat format, bool planar) {
+    if (numChans < 1 || getSampleBytes(format) == 0 || map(path) != 0) {
+        return -1;
+    }
+    this->numChans = numChans;
+    this->sampleRate = sampleRate;
+    this->format = format;
+    this->planar = planar;
+    type = AUDIOFILE_RAW;
+    bigEndian = false;
+    sampleBytes = getSampleBytes(format);
+    dataOffset = 0;
+    numFrames = fileSize/((uint64_t) numChans*sampleBytes);
+    return 0;
+}
+
+int CppAudioFileReader::parseWav() {
+    uint64_t pos = 12, body, dataBytes = 0, ds64Data = 0;
+    uint32_t size, tag = 0, bits = 0;
+    bool haveData = false;
+
+    if (fileSize < 12 || (std::memcmp(base, "RIFF", 4) != 0 && std::memcmp(base, "RF64", 4) != 0 &&
+                          std::memcmp(base, "BW64", 4) != 0) || std::memcmp(base+8, "WAVE", 4) != 0) {
+        return -1;
+    }
+
+    while (!haveData && pos+8 <= fileSize) {
+        size = getLE32(base+pos+4);
+        body = pos+8;
+        if (std::memcmp(base+pos, "ds64", 4) == 0 && body+16 <= fileSize) {
+            // 64 bit sizes of RF64, the 32 bit fields then hold 0xFFFFFFFF
+            ds64Data = getLE64(base+body+8);
+        } else if (std::memcmp(base+pos, "fmt ", 4) == 0 && size >= 16 && body+16 <= fileSize) {
+            tag = getLE16(base+body);
+            numChans = getLE16(base+body+2);
+            sampleRate = getLE32(base+body+4);
+            bits = getLE16(base+body+14);
+            if (tag == 0xFFFE && size >= 26 && body+26 <= fileSize) {
+                // WAVE_FORMAT_EXTENSIBLE, the sub format GUID starts with the format tag
+                tag = getLE16(base+body+24);
+            }
+        } else if (std::memcmp(base+pos, "data", 4) == 0) {
+            dataOffset = body;
+            dataBytes = (size == 0xFFFFFFFF && ds64Data > 0) ? ds64Data : size;
+            haveData = true;
+        }
+        pos = body+size+(size & 1);
+    }
+
+    format = (tag == 1 || tag == 3) ? getSampleFormat(tag == 3, bits) : UNKNOWN_SAMPLEFORMAT;
+    sampleBytes = getSampleBytes(format);
+    if (!haveData || numChans == 0 || sampleBytes == 0) {
+        return -1;
+    }
+    type = AUDIOFILE_WAV;
+    dataBytes = std::min(dataBytes, fileSize-dataOffset);
+    numFrames = dataBytes/((uint64_t) numChans*sampleBytes);
+    return 0;
+}
+
+int CppAudioFileReader::parseCaf() {
+    uint64_t pos = 8, body, dataBytes = 0, u64;
+    uint32_t flags = 0, bits = 0, packetBytes = 0;
+    int64_t size;
+    bool haveDesc = false, haveData = false;
+
+    if (fileSize < 8 || std::memcmp(base, "caff", 4) != 0) {
+        return -1;
+    }
+
+    // chunks are big endian with 64 bit sizes, a data size of -1 runs to the end of the file
+    while (!haveData && pos+12 <= fileSize) {
+        size = (int64_t) getBE64(base+pos+4);
+        body = pos+12;
+        if (std::memcmp(base+pos, "desc", 4) == 0 && body+32 <= fileSize) {
+            u64 = getBE64(base+body);
+            std::memcpy(&sampleRate, &u64, 8);
+            if (std::memcmp(base+body+8, "lpcm", 4) != 0) {
+                return -1;
+            }
+            flags = getBE32(base+body+12);
+            packetBytes = getBE32(base+body+16);
+            numChans = getBE32(base+body+24);
+            bits = getBE32(base+body+28);
+            haveDesc = true;
+        } else if (std::memcmp(base+pos, "data", 4) == 0 && body+4 <= fileSize) {
+            dataOffset = body+4;
+            dataBytes = (size < 4) ? fileSize-dataOffset : (uint64_t) size-4;
+            haveData = true;
+        }
+        if (size < 0) {
+            break;
+        }
+        pos = body+(uint64_t) size;
+    }
+
+    format = getSampleFormat((flags & 1) != 0, bits);
+    sampleBytes = getSampleBytes(format);
+    if (!haveDesc || !haveData || numChans == 0 || sampleBytes == 0 || packetBytes != numChans*sampleBytes) {
+        return -1;
+    }
+    type = AUDIOFILE_CAF;
+    bigEndian = (flags & 2) == 0;
+    dataBytes = std::min(dataBytes, fileSize-dataOffset);
+    numFrames = dataBytes/((uint64_t) numChans*sampleBytes);
+    return 0;
+}
+
+const float *CppAudioFileReader::getPlanar(uint32_t chan) const {
+    const uint8_t *addr;
+
+    if (base == nullptr || format != SAMPLE_FLOAT32 || bigEndian || !isLittleEndianHost() || chan >= numChans ||
+        (!planar && numChans > 1)) {
+        return nullptr;
+    }
+    addr = base+dataOffset+chan*numFrames*sampleBytes;
+    return ((uintptr_t) addr % sizeof(float) == 0) ? (const float*) addr : nullptr;
+}
+
+uint32_t CppAudioFileReader::read(uint64_t frame, uint32_t frames, float *const *dest, uint32_t numDest) const {
+    const uint8_t *src;
+    size_t step = planar ? sampleBytes : (size_t) numChans*sampleBytes;
+
+    if (base == nullptr || frame >= numFrames) {
+        return 0;
+    }
+    frames = (uint32_t) std::min((uint64_t) frames, numFrames-frame);
+
+    for (uint32_t c=0; c<std::min(numDest, numChans); c++) {
+        if (planar) {
+            src = base+dataOffset+(c*numFrames+frame)*sampleBytes;
+        } else {
+            src = base+dataOffset+(frame*numChans+c)*sampleBytes;
+        }
+        readSamples(src, step, frames, format, bigEndian, dest[c]);
+    }
+    return frames;
+}
+
+void CppAudioFileReader::release(uint64_t frame) {
+#ifndef _WIN32
+    uint64_t end, pageSize = (uint64_t) sysconf(_SC_PAGESIZE);
+
+    // planar channels spread over the whole file, nothing lies behind the reader
+    if (base == nullptr || planar) {
+        return;
+    }
+    end = std::min(dataOffset+frame*numChans*sampleBytes, fileSize) & ~(pageSize-1);
+    if (end < released) {
+        // the reader started over
+        released = 0;
+    }
+    if (end >= released+AUDIOFILE_BLOCK_SIZE) {
+        madvise((void*) (base+released), end-released, MADV_DONTNEED);
+        released = end;
+    }
+#else
+    (void) frame;
+#endif
+}
+
+CppAudioFileWriter::CppAudioFileWriter(void)
+    : file(nullptr), block(nullptr), fill(0), headerLen(0), numFrames(0), type(UNKNOWN_AUDIOFILE),
+      format(UNKNOWN_SAMPLEFORMAT), sampleRate(0.0), numChans(0), sampleBytes(0), failed(false) {
+
+}
+
+CppAudioFileWriter::~CppAudioFileWriter(void) {
+    close();
+}
+
+int CppAudioFileWriter::open(const std::string &path, audioFileType type, uint32_t numChans, double sampleRate,
+                             sampleFormat format) {
+    close();
+    if (numChans < 1 || getSampleBytes(format) == 0 || (type != AUDIOFILE_WAV && type != AUDIOFILE_CAF &&
+                                                         type != AUDIOFILE_RAW)) {
+        return -1;
+    }
+
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return -1;
+    }
+    // the blocks are large already, stdio would only copy them once more
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+    this->type = type;
+    this->format = format;
+    this->numChans = numChans;
+    this->sampleRate = sampleRate;
+    sampleBytes = getSampleBytes(format);
+    numFrames = 0;
+    failed = false;
+
+    // room for one frame beyond the block, so a frame never has to be split
+    storage.reset(new uint8_t[AUDIOFILE_BLOCK_SIZE+numChans*sampleBytes+AUDIOFILE_ALIGN]);
+    block = storage.get()+(AUDIOFILE_ALIGN-(uintptr_t) storage.get()%AUDIOFILE_ALIGN)%AUDIOFILE_ALIGN;
+
+    // the header occupies the first aligned unit, rewritten with the final sizes at close()
+    headerLen = (type == AUDIOFILE_RAW) ? 0 : AUDIOFILE_ALIGN;
+    if (headerLen > 0) {
+        buildHeader(block, 0);
+    }
+    fill = headerLen;
+    return 0;
+}
+
+int CppAudioFileWriter::write(const float *const *src, uint32_t frames) {
+    size_t frameBytes = (size_t) numChans*sampleBytes;
+    uint32_t done = 0, n;
+
+    if (file == nullptr) {
+        return -1;
+    }
+
+    while (done < frames) {
+        // fill the block just past its end, the overhang moves to the front after the write
+        n = (uint32_t) std::min((size_t) (frames-done), (AUDIOFILE_BLOCK_SIZE-fill+frameBytes-1)/frameBytes);
+        for (uint32_t c=0; c<numChans; c++) {
+            writeSamples(src[c]+done, n, format, block+fill+c*sampleBytes, frameBytes);
+        }
+        fill += n*frameBytes;
+        done += n;
+        if (fill >= AUDIOFILE_BLOCK_SIZE) {
+            flush(AUDIOFILE_BLOCK_SIZE);
+            fill -= AUDIOFILE_BLOCK_SIZE;
+            std::memmove(block, block+AUDIOFILE_BLOCK_SIZE, fill);
+        }
+    }
+    numFrames += frames;
+    return failed ? -1 : 0;
+}
+
+int CppAudioFileWriter::flush(size_t bytes) {
+    if (bytes > 0 && std::fwrite(block, 1, bytes, file) != bytes) {
+        failed = true;
+    }
+    return failed ? -1 : 0;
+}
+
+int CppAudioFileWriter::close() {
+    uint64_t dataBytes = numFrames*numChans*sampleBytes;
+    std::vector<uint8_t> header(headerLen);
+
+    if (file == nullptr) {
+        return 0;
+    }
+
+    // RIFF chunks are padded to an even length
+    if (type == AUDIOFILE_WAV && (dataBytes & 1) != 0) {
+        block[fill++] = 0;
+    }
+    flush(fill);
+    fill = 0;
+
+    if (headerLen > 0) {
+        buildHeader(header.data(), dataBytes);
+        if (std::fseek(file, 0, SEEK_SET) != 0 || std::fwrite(header.data(), 1, headerLen, file) != headerLen) {
+            failed = true;
+        }
+    }
+    if (std::fclose(file) != 0) {
+        failed = true;
+    }
+    file = nullptr;
+    storage.reset();
+    block = nullptr;
+    return failed ? -1 : 0;
+}
+
+void CppAudioFileWriter::buildHeader(uint8_t *header, uint64_t dataBytes) const {
+    uint32_t frameBytes = numChans*sampleBytes, bits = 8*sampleBytes, fmtLen, tag;
+    bool isFloat = format == SAMPLE_FLOAT32 || format == SAMPLE_FLOAT64, extensible, rf64;
+    uint64_t riffSize = headerLen-8+dataBytes+(dataBytes & 1), u64;
+    static const uint8_t guidTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+                                         0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+    uint8_t *p;
+
+    std::memset(header, 0, headerLen);
+
+    if (type == AUDIOFILE_CAF) {
+        std::memcpy(header, "caff", 4);
+        putBE16(header+4, 1);
+        p = header+8;
+        std::memcpy(p, "desc", 4);
+        putBE64(p+4, 32);
+        std::memcpy(&u64, &sampleRate, 8);
+        putBE64(p+12, u64);
+        std::memcpy(p+20, "lpcm", 4);
+        putBE32(p+24, (isFloat ? 1 : 0) | 2);
+        putBE32(p+28, frameBytes);
+        putBE32(p+32, 1);
+        putBE32(p+36, numChans);
+        putBE32(p+40, bits);
+        // padding up to the data chunk, whose samples start at headerLen
+        p = header+52;
+        std::memcpy(p, "free", 4);
+        putBE64(p+4, headerLen-80);
+        p = header+headerLen-16;
+        std::memcpy(p, "data", 4);
+        putBE64(p+4, dataBytes+4);
+        return;
+    }
+
+    // the JUNK chunk reserves the room of the ds64 chunk, which replaces it beyond 4 GiB
+    rf64 = riffSize > 0xFFFFFFFF;
+    std::memcpy(header, rf64 ? "RF64" : "RIFF", 4);
+    putLE32(header+4, rf64 ? 0xFFFFFFFF : (uint32_t) riffSize);
+    std::memcpy(header+8, "WAVE", 4);
+    p = header+12;
+    std::memcpy(p, rf64 ? "ds64" : "JUNK", 4);
+    putLE32(p+4, 28);
+    if (rf64) {
+        putLE64(p+8, riffSize);
+        putLE64(p+16, dataBytes);
+        putLE64(p+24, numFrames);
+    }
+
+    extensible = numChans > 2 || bits > 16;
+    fmtLen = extensible ? 40 : 16;
+    tag = isFloat ? 3 : 1;
+    p = header+48;
+    std::memcpy(p, "fmt ", 4);
+    putLE32(p+4, fmtLen);
+    putLE16(p+8, (uint16_t) (extensible ? 0xFFFE : tag));
+    putLE16(p+10, (uint16_t) numChans);
+    putLE32(p+12, (uint32_t) lrint(sampleRate));
+    putLE32(p+16, (uint32_t) lrint(sampleRate)*frameBytes);
+    putLE16(p+20, (uint16_t) frameBytes);
+    putLE16(p+22, (uint16_t) bits);
+    if (extensible) {
+        putLE16(p+24, 22);
+        putLE16(p+26, (uint16_t) bits);
+        putLE32(p+28, (numChans <= 18) ? (1u << numChans)-1 : 0);
+        putLE16(p+32, (uint16_t) tag);
+        std::memcpy(p+34, guidTail, 14);
+    }
+
+    // padding up to the data chunk, whose samples start at headerLen
+    p = header+56+fmtLen;
+    std::memcpy(p, "JUNK", 4);
+    putLE32(p+4, (uint32_t) (headerLen-8-(p+8-header)));
+    p = header+headerLen-8;
+    std::memcpy(p, "data", 4);
+    putLE32(p+4, rf64 ? 0xFFFFFFFF : (uint32_t) dataBytes);
+}
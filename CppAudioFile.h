@@ -0,0 +1,166 @@
+/*------------------------------------------------------------------*\
+Interface to a reader and a writer of multichannel audio files for
+offline renders and measurements, sized for multi-hour files with many
+channels.
+
+The reader maps the whole file into memory (advised for sequential
+access) and converts straight out of the mapping, no sample is copied
+twice. It reads RIFF/WAVE, RF64/BW64 (WAVE beyond 4 GiB), CAF and raw
+headerless files, with 16, 24 or 32 bit integer or 32/64 bit float
+samples. Raw files hold interleaved frames (like debug.raw, one float64
+channel) or whole channels one after another. Planar raw float32 files
+and mono float32 files can be used in place through getPlanar().
+
+The writer collects interleaved frames in an aligned block of
+AUDIOFILE_BLOCK_SIZE bytes and hands every full block to the system
+in a single unbuffered write. The headers of WAV and CAF files are
+padded to AUDIOFILE_ALIGN bytes, so every block lands on an aligned
+file offset. A WAV file turns into RF64 once it passes 4 GiB.
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPAUDIOFILE_H // include guard
+#define _CPPAUDIOFILE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+
+// bytes per write of the writer, and the alignment of its blocks
+#define AUDIOFILE_BLOCK_SIZE 0x400000
+#define AUDIOFILE_ALIGN 0x1000
+
+typedef enum {
+    AUDIOFILE_WAV = 0x40,
+    AUDIOFILE_CAF,
+    AUDIOFILE_RAW,
+    UNKNOWN_AUDIOFILE
+} audioFileType;
+
+typedef enum {
+    SAMPLE_INT16 = 0x50,
+    SAMPLE_INT24,
+    SAMPLE_INT32,
+    SAMPLE_FLOAT32,
+    SAMPLE_FLOAT64,
+    UNKNOWN_SAMPLEFORMAT
+} sampleFormat;
+
+class CppAudioFileReader {
+
+public:
+    CppAudioFileReader(void);
+
+    ~CppAudioFileReader(void);
+
+    // Maps a WAV, RF64/BW64 or CAF file, -1 if it cannot be read or is not supported.
+    int open(const std::string &path);
+
+    // Maps a headerless file, interleaved or one channel after another (planar).
+    int openRaw(const std::string &path, uint32_t numChans, double sampleRate,
+                sampleFormat format = SAMPLE_FLOAT32, bool planar = false);
+
+    void close();
+
+    inline bool isOpen() const {
+        return base != nullptr;
+    }
+
+    inline audioFileType getType() const {
+        return type;
+    }
+
+    inline sampleFormat getFormat() const {
+        return format;
+    }
+
+    inline uint32_t getNumChans() const {
+        return numChans;
+    }
+
+    inline double getSampleRate() const {
+        return sampleRate;
+    }
+
+    inline uint64_t getNumFrames() const {
+        return numFrames;
+    }
+
+    // Channel chan as contiguous float32 samples inside the mapping, nullptr unless the
+    // file holds native float32 samples planar (raw planar or mono).
+    const float *getPlanar(uint32_t chan) const;
+
+    // Converts up to frames frames from frame on into dest[0] ... dest[numDest-1], channels
+    // beyond the file are left alone. Returns the frames read, 0 at the end.
+    uint32_t read(uint64_t frame, uint32_t frames, float *const *dest, uint32_t numDest) const;
+
+    // Tells the system the frames before frame are done, their pages can go.
+    void release(uint64_t frame);
+
+private:
+    int map(const std::string &path);
+
+    int parseWav();
+
+    int parseCaf();
+
+    const uint8_t *base;
+    uint64_t fileSize, dataOffset, numFrames, released;
+    audioFileType type;
+    sampleFormat format;
+    double sampleRate;
+    uint32_t numChans, sampleBytes;
+    bool planar, bigEndian;
+#ifdef _WIN32
+    void *fileHandle, *mapHandle;
+#else
+    int fd;
+#endif
+};
+
+class CppAudioFileWriter {
+
+public:
+    CppAudioFileWriter(void);
+
+    ~CppAudioFileWriter(void);
+
+    // Creates path, -1 if it cannot be created or the format does not fit the type
+    // (CAF and WAV take all formats, raw files too).
+    int open(const std::string &path, audioFileType type, uint32_t numChans, double sampleRate,
+             sampleFormat format = SAMPLE_FLOAT32);
+
+    // Appends frames frames of the planar buffers src[0] ... src[numChans-1].
+    int write(const float *const *src, uint32_t frames);
+
+    // Writes the rest and the final header, -1 if any write failed.
+    int close();
+
+    inline bool isOpen() const {
+        return file != nullptr;
+    }
+
+    inline uint64_t getFramesWritten() const {
+        return numFrames;
+    }
+
+private:
+    int flush(size_t bytes);
+
+    // Header of dataBytes bytes of samples, headerLen bytes long.
+    void buildHeader(uint8_t *header, uint64_t dataBytes) const;
+
+    std::FILE *file;
+    std::unique_ptr<uint8_t[]> storage;
+    uint8_t *block;
+    size_t fill, headerLen;
+    uint64_t numFrames;
+    audioFileType type;
+    sampleFormat format;
+    double sampleRate;
+    uint32_t numChans, sampleBytes;
+    bool failed;
+};
+
+#endif // end of include guard
@@ -0,0 +1,260 @@
+/*------------------------------------------------------------------*\
+Implementation of the audio system (PortAudio init and device cache).
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <chrono>
+#include "CppAudioSystem.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
+// longest device name shown, longer ones are cut
+#define AUDIOSYSTEM_MAX_NAME_LEN 50
+
+static bool sameDevice(const deviceContainerRTA &a, const deviceContainerRTA &b) {
+    return a.name == b.name && a.hostAPI == b.hostAPI && a.ID == b.ID && a.numChans == b.numChans
+            && a.inputFlag == b.inputFlag && a.latency == b.latency;
+}
+
+static bool sameDevices(const std::vector<deviceContainerRTA> &a, const std::vector<deviceContainerRTA> &b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), sameDevice);
+}
+
+// the name without the "(ID) " prefix, which changes with a scan
+static std::string stableName(const std::string &name) {
+    size_t pos = (!name.empty() && name[0] == '(') ? name.find(") ") : std::string::npos;
+    return (pos != std::string::npos) ? name.substr(pos+2) : name;
+}
+
+CppAudioSystem &CppAudioSystem::instance() {
+    static CppAudioSystem audioSystem;
+    return audioSystem;
+}
+
+CppAudioSystem::CppAudioSystem(void)
+    : generation(0), refreshInterval(AUDIOSYSTEM_REFRESH_INTERVAL), openStreams(0), initError(paNoError),
+      status(-1), initialized(false), scanned(false), refreshPending(false), quit(false),
+      watching(!deviceSignature().empty()) {
+    thread = std::thread(&CppAudioSystem::threadLoop, this);
+}
+
+CppAudioSystem::~CppAudioSystem(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (initialized) {
+        Pa_Terminate();
+    }
+}
+
+int CppAudioSystem::getHostAPIs(std::vector<std::string> &apis) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!scanned) {
+        scan();
+    }
+    apis = this->apis;
+    return (status == -1) ? -1 : (apis.empty() ? -2 : 0);
+}
+
+int CppAudioSystem::getDevices(std::vector<deviceContainerRTA> &inDevices,
+                               std::vector<deviceContainerRTA> &outDevices) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!scanned) {
+        scan();
+    }
+    inDevices = this->inDevices;
+    outDevices = this->outDevices;
+    return status;
+}
+
+int CppAudioSystem::refresh() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (openStreams > 0) {
+        refreshPending = true;
+        return 1;
+    }
+    return scan();
+}
+
+void CppAudioSystem::requestRefresh() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        refreshPending = true;
+    }
+    wake.notify_one();
+}
+
+void CppAudioSystem::setRefreshInterval(double seconds) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        refreshInterval = std::max(seconds, 0.0);
+    }
+    wake.notify_one();
+}
+
+PaError CppAudioSystem::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!initialized) {
+        scan();
+    }
+    if (!initialized) {
+        return initError;
+    }
+    openStreams++;
+    return paNoError;
+}
+
+void CppAudioSystem::release() {
+    bool pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        openStreams -= (openStreams > 0) ? 1 : 0;
+        pending = openStreams == 0 && refreshPending;
+    }
+    if (pending) {
+        wake.notify_one();
+    }
+}
+
+int CppAudioSystem::resolve(deviceContainerRTA &device) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::vector<deviceContainerRTA> &devices = device.inputFlag ? inDevices : outDevices;
+    std::string name = stableName(device.name);
+
+    for (uint32_t i=0; i<devices.size(); i++) {
+        if (devices[i].ID == device.ID && devices[i].name == device.name && devices[i].hostAPI == device.hostAPI) {
+            return 0;
+        }
+    }
+    for (uint32_t i=0; i<devices.size(); i++) {
+        if (devices[i].hostAPI == device.hostAPI && stableName(devices[i].name) == name) {
+            device.ID = devices[i].ID;
+            device.name = devices[i].name;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int CppAudioSystem::scan() {
+    std::vector<std::string> newApis;
+    std::vector<deviceContainerRTA> newIns, newOuts;
+    const PaDeviceInfo *paDevInfo;
+    deviceContainerRTA devInfo;
+    std::string name;
+
+    // only a full restart makes PortAudio see devices that came or went
+    if (initialized) {
+        Pa_Terminate();
+        initialized = false;
+    }
+    scanned = true;
+    refreshPending = false;
+    initError = Pa_Initialize();
+    if (initError != paNoError) {
+        status = -1;
+        return status;
+    }
+    initialized = true;
+
+    for (PaHostApiIndex i=0; i<Pa_GetHostApiCount(); i++) {
+        newApis.push_back(std::string(Pa_GetHostApiInfo(i)->name));
+    }
+
+    for (PaDeviceIndex i=0; i<Pa_GetDeviceCount(); i++) {
+        paDevInfo = Pa_GetDeviceInfo(i);
+
+        name = paDevInfo->name;
+        if (name.size()>AUDIOSYSTEM_MAX_NAME_LEN) {
+            name = name.substr(0, AUDIOSYSTEM_MAX_NAME_LEN) + std::string("...");
+        }
+        devInfo.ID = i;
+        devInfo.hostAPI = Pa_GetHostApiInfo(paDevInfo->hostApi)->name;
+
+        if (paDevInfo->maxInputChannels>0) {
+            devInfo.numChans = paDevInfo->maxInputChannels;
+            devInfo.latency = paDevInfo->defaultLowInputLatency;
+            devInfo.inputFlag = true;
+            devInfo.name = std::string("(") + std::to_string(devInfo.ID) + std::string(") ") + name
+                    + std::string("  |  ") + std::to_string(devInfo.numChans) + std::string(" channels");
+            newIns.push_back(devInfo);
+        }
+
+        if (paDevInfo->maxOutputChannels>0) {
+            devInfo.numChans = paDevInfo->maxOutputChannels;
+            devInfo.latency = paDevInfo->defaultLowOutputLatency;
+            devInfo.inputFlag = false;
+            devInfo.name = std::string("(") + std::to_string(devInfo.ID) + std::string(") ") + name
+                    + std::string("  |  ") + std::to_string(devInfo.numChans) + std::string(" channels");
+            newOuts.push_back(devInfo);
+        }
+    }
+
+    if (newApis != apis || !sameDevices(newIns, inDevices) || !sameDevices(newOuts, outDevices)) {
+        apis.swap(newApis);
+        inDevices.swap(newIns);
+        outDevices.swap(newOuts);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    status = (inDevices.empty() && outDevices.empty()) ? -2 : 0;
+    return status;
+}
+
+std::string CppAudioSystem::deviceSignature() {
+    std::string signature;
+#ifdef __linux__
+    std::vector<std::string> names;
+    DIR *dir = opendir("/dev/snd");
+    struct dirent *entry;
+
+    if (dir == nullptr) {
+        return signature;
+    }
+    while ((entry = readdir(dir)) != nullptr) {
+        names.push_back(entry->d_name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    for (uint32_t i=0; i<names.size(); i++) {
+        signature += names[i] + "/";
+    }
+#endif
+    return signature;
+}
+
+void CppAudioSystem::threadLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    std::string lastSignature = deviceSignature(), signature;
+
+    while (!quit) {
+        if (refreshInterval > 0.0) {
+            wake.wait_for(lock, std::chrono::duration<double>(refreshInterval));
+        } else {
+            wake.wait(lock);
+        }
+        if (quit) {
+            break;
+        }
+
+        // a changed device node means a card came or went, before the first scan there is nothing to refresh
+        signature = deviceSignature();
+        if (signature != lastSignature && scanned) {
+            refreshPending = true;
+        }
+        lastSignature = signature;
+        if (refreshPending && openStreams == 0) {
+            scan();
+        }
+    }
+}
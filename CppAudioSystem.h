@@ -0,0 +1,110 @@
+/*------------------------------------------------------------------*\
+Interface to the long-lived audio system: PortAudio is initialized
+once for the whole process, the host APIs and devices are scanned once
+and served from a cache afterwards. Scanning (Pa_Initialize) probes
+every host API, which takes hundreds of ms with JACK and ALSA.
+
+Devices that are plugged in or removed are picked up in the
+background: on Linux a thread watches /dev/snd and scans again when it
+changes, elsewhere requestRefresh() asks for a scan. A scan restarts
+PortAudio, so it waits until no stream is open. getGeneration()
+changes whenever a scan found a different device list. Device IDs may
+change with a scan; CppRTA looks its devices up again by name before
+it opens them (resolve()).
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPAUDIOSYSTEM_H // include guard
+#define _CPPAUDIOSYSTEM_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include "portaudio.h"
+
+// seconds between two checks of the background thread for changed devices
+#define AUDIOSYSTEM_REFRESH_INTERVAL 2.0
+
+struct deviceContainerRTA {
+    std::string name, hostAPI;
+    double latency;
+    uint32_t ID = 0;
+    uint32_t numChans = 0;
+    bool inputFlag = false;
+};
+
+class CppAudioSystem {
+
+public:
+    static CppAudioSystem &instance();
+
+    // Cached host APIs, -1 if PortAudio cannot be initialized, -2 without any.
+    int getHostAPIs(std::vector<std::string> &apis);
+
+    // Cached devices (the lists are replaced), -1 if PortAudio cannot be initialized,
+    // -2 without any device.
+    int getDevices(std::vector<deviceContainerRTA> &inDevices, std::vector<deviceContainerRTA> &outDevices);
+
+    inline uint64_t getGeneration() const {
+        return generation.load(std::memory_order_acquire);
+    }
+
+    // Scans now and returns like getDevices(), or 1 if streams are open (the scan
+    // follows once the last one is closed).
+    int refresh();
+
+    // Asks the background thread for a scan, returns at once.
+    void requestRefresh();
+
+    // true if devices that come or go are noticed without requestRefresh()
+    inline bool isWatching() const {
+        return watching;
+    }
+
+    // Seconds between the checks of the background thread, 0 checks on request only.
+    void setRefreshInterval(double seconds);
+
+    // Keeps PortAudio initialized and holds off scans until release(), for every
+    // stream that is opened. Returns the error of Pa_Initialize, if any.
+    PaError acquire();
+
+    void release();
+
+    // Updates the ID of a device from an earlier scan, found by name, host API and
+    // direction. -1 if the device is gone. Call it between acquire() and release().
+    int resolve(deviceContainerRTA &device);
+
+private:
+    CppAudioSystem(void);
+
+    ~CppAudioSystem(void);
+
+    CppAudioSystem(const CppAudioSystem&) = delete;
+
+    CppAudioSystem &operator=(const CppAudioSystem&) = delete;
+
+    // (Re)initializes PortAudio and fills the cache, mutex held.
+    int scan();
+
+    // Cheap fingerprint of the present sound devices, empty where there is none.
+    static std::string deviceSignature();
+
+    void threadLoop();
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+    std::vector<std::string> apis;
+    std::vector<deviceContainerRTA> inDevices, outDevices;
+    std::atomic<uint64_t> generation;
+    double refreshInterval;
+    uint32_t openStreams;
+    PaError initError;
+    int status;
+    bool initialized, scanned, refreshPending, quit, watching;
+};
+
+#endif // end of include guard
@@ -0,0 +1,513 @@
+/*------------------------------------------------------------------*\
+Implementation of the OSC control server.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include "CppControl.h"
+#include "CppRTA.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define closeSocket closesocket
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define closeSocket close
+#endif
+
+// largest datagram the server receives
+#define CONTROL_MAX_PACKET 0x10000
+// bundles nested deeper are rejected
+#define CONTROL_MAX_DEPTH 8
+
+// address, command and the numeric arguments it needs (i: int, f: float), in order
+static const struct {
+    const char *address;
+    controlCommandType type;
+    const char *args;
+} commandTable[] = {
+    {"/vdsp/eq/num", CONTROL_EQ_NUM, "ii"},
+    {"/vdsp/eq", CONTROL_EQ, "iiifff"},
+    {"/vdsp/eq/gain", CONTROL_EQ_GAIN, "iif"},
+    {"/vdsp/eq/freq", CONTROL_EQ_FREQ, "iif"},
+    {"/vdsp/eq/q", CONTROL_EQ_Q, "iif"},
+    {"/vdsp/eq/type", CONTROL_EQ_TYPE, "iii"},
+    {"/vdsp/cut", CONTROL_CUT, "iiifi"},
+    {"/vdsp/limiter", CONTROL_LIMITER, "ifff"},
+    {"/vdsp/route", CONTROL_ROUTE, "iif"},
+    {"/vdsp/ping", CONTROL_PING, ""},
+    {"/vdsp/subscribe", CONTROL_SUBSCRIBE, ""},
+    {"/vdsp/unsubscribe", CONTROL_UNSUBSCRIBE, ""}
+};
+
+static inline uint32_t readBig32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline uint64_t readBig64(const uint8_t *p) {
+    return ((uint64_t) readBig32(p) << 32) | readBig32(p+4);
+}
+
+static inline uint32_t pad4(uint32_t len) {
+    return (len+3) & ~3u;
+}
+
+// Length of the padded string at pos, 0 if it is not terminated within len.
+static uint32_t oscStringLen(const uint8_t *data, uint32_t pos, uint32_t len) {
+    for (uint32_t k=pos; k<len; k++) {
+        if (data[k] == 0) {
+            return pad4(k-pos+1);
+        }
+    }
+    return 0;
+}
+
+static void putBig32(std::vector<uint8_t> &out, uint32_t value) {
+    out.push_back((uint8_t) (value >> 24));
+    out.push_back((uint8_t) (value >> 16));
+    out.push_back((uint8_t) (value >> 8));
+    out.push_back((uint8_t) value);
+}
+
+static void putString(std::vector<uint8_t> &out, const char *str) {
+    size_t len = std::strlen(str);
+
+    out.insert(out.end(), str, str+len);
+    out.resize(out.size()+pad4((uint32_t) len+1)-len, 0);
+}
+
+static void putFloat(std::vector<uint8_t> &out, float value) {
+    uint32_t bits;
+
+    std::memcpy(&bits, &value, sizeof(bits));
+    putBig32(out, bits);
+}
+
+// Starts an OSC message in out, the arguments follow.
+static void beginMessage(std::vector<uint8_t> &out, const char *address, const char *tags) {
+    out.clear();
+    putString(out, address);
+    putString(out, tags);
+}
+
+static void putFloatTags(std::vector<uint8_t> &tags, uint32_t numFloats) {
+    tags.assign(1, ',');
+    tags.resize(numFloats+1, 'f');
+    tags.push_back(0);
+}
+
+// Appends message as an element to the bundle in packet.
+static void appendToBundle(std::vector<uint8_t> &packet, const std::vector<uint8_t> &message) {
+    putBig32(packet, (uint32_t) message.size());
+    packet.insert(packet.end(), message.begin(), message.end());
+}
+
+static bool sameAddress(const controlAddress &a, const controlAddress &b) {
+    return a.len == b.len && std::memcmp(a.data, b.data, a.len) == 0;
+}
+
+CppControlServer::CppControlServer(void)
+    : queue(CONTROL_QUEUE_SIZE), writePos(0), readPos(0), dropped(0), errors(0), unsent(0), running(false),
+      nextTelemetry(std::chrono::steady_clock::now()), sock(-1) {
+    setTelemetryRate(10.0);
+}
+
+CppControlServer::~CppControlServer(void) {
+    stop();
+}
+
+void CppControlServer::start(uint16_t port, const std::string &address) {
+    struct addrinfo hints, *info = nullptr;
+    std::string portStr = std::to_string(port);
+    int yes = 1;
+
+    stop();
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        throw std::invalid_argument("control server: no sockets available");
+    }
+#endif
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST;
+    if (getaddrinfo(address.c_str(), portStr.c_str(), &hints, &info) != 0 || info == nullptr) {
+        throw std::invalid_argument("control server: invalid address " + address);
+    }
+
+    sock = (intptr_t) socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (sock < 0) {
+        freeaddrinfo(info);
+        throw std::invalid_argument("control server: cannot create socket");
+    }
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*) &yes, sizeof(yes));
+    // sending must not stall processCommands(), receiving waits in select() anyway
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(sock, FIONBIO, &nonBlocking);
+#else
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    if (bind(sock, info->ai_addr, (socklen_t) info->ai_addrlen) != 0) {
+        freeaddrinfo(info);
+        closeSocket(sock);
+        sock = -1;
+        throw std::invalid_argument("control server: cannot bind " + address + ":" + portStr);
+    }
+    freeaddrinfo(info);
+
+    writePos.store(0);
+    readPos.store(0);
+    running.store(true);
+    thread = std::thread(&CppControlServer::threadLoop, this);
+}
+
+void CppControlServer::stop() {
+    running.store(false);
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (sock >= 0) {
+        closeSocket(sock);
+        sock = -1;
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+    subscribers.clear();
+}
+
+void CppControlServer::threadLoop() {
+    std::vector<uint8_t> buffer(CONTROL_MAX_PACKET);
+    controlAddress sender;
+    struct sockaddr_storage from;
+    socklen_t fromLen;
+    struct timeval timeout;
+    fd_set fds;
+    int received;
+
+    while (running.load(std::memory_order_relaxed)) {
+        // wakes up regularly to see whether the server is stopped
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        timeout.tv_sec = 0;
+        timeout.tv_usec = 100000;
+        if (select((int) sock+1, &fds, nullptr, nullptr, &timeout) <= 0) {
+            continue;
+        }
+        fromLen = sizeof(from);
+        received = (int) recvfrom(sock, (char*) buffer.data(), CONTROL_MAX_PACKET, 0,
+                                  (struct sockaddr*) &from, &fromLen);
+        if (received <= 0) {
+            continue;
+        }
+        sender.len = std::min((uint32_t) fromLen, (uint32_t) sizeof(sender.data));
+        std::memcpy(sender.data, &from, sender.len);
+        parsePacket(buffer.data(), (uint32_t) received, sender, 0);
+    }
+}
+
+void CppControlServer::parsePacket(const uint8_t *data, uint32_t len, const controlAddress &sender, uint32_t depth) {
+    controlCommand command;
+    double nums[8];
+    uint32_t pos, tagPos, tagLen, numNums = 0, numInts = 0, numValues = 0, size;
+    const char *args = nullptr;
+    uint64_t bits64;
+    uint32_t bits;
+    float f;
+    double d;
+
+    if (depth > CONTROL_MAX_DEPTH || len < 4 || (len & 3) != 0) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // a bundle holds size-prefixed packets after its time tag, they are queued in order
+    if (len >= 16 && std::memcmp(data, "#bundle", 8) == 0) {
+        for (pos = 16; pos+4 <= len; pos += 4+size) {
+            size = readBig32(data+pos);
+            if (size > len-pos-4) {
+                errors.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            parsePacket(data+pos+4, size, sender, depth+1);
+        }
+        return;
+    }
+
+    pos = oscStringLen(data, 0, len);
+    if (pos == 0) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    command.type = UNKNOWN_CONTROL;
+    for (uint32_t k=0; k<sizeof(commandTable)/sizeof(commandTable[0]); k++) {
+        if (std::strcmp((const char*) data, commandTable[k].address) == 0) {
+            command.type = commandTable[k].type;
+            args = commandTable[k].args;
+        }
+    }
+    if (command.type == UNKNOWN_CONTROL) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // numeric arguments of any type, strings and blobs are skipped
+    tagPos = pos;
+    tagLen = (pos < len && data[pos] == ',') ? oscStringLen(data, pos, len) : 0;
+    pos += tagLen;
+    for (uint32_t k=tagPos+1; tagLen > 0 && data[k] != 0 && numNums < 8; k++) {
+        if ((data[k] == 'i' || data[k] == 'f') && pos+4 <= len) {
+            bits = readBig32(data+pos);
+            std::memcpy(&f, &bits, sizeof(f));
+            nums[numNums++] = (data[k] == 'i') ? (double) (int32_t) bits : (double) f;
+            pos += 4;
+        } else if ((data[k] == 'd' || data[k] == 'h') && pos+8 <= len) {
+            bits64 = readBig64(data+pos);
+            std::memcpy(&d, &bits64, sizeof(d));
+            nums[numNums++] = (data[k] == 'h') ? (double) (int64_t) bits64 : d;
+            pos += 8;
+        } else if ((data[k] == 's' || data[k] == 'S') && oscStringLen(data, pos, len) > 0) {
+            pos += oscStringLen(data, pos, len);
+        } else if (data[k] == 'b' && pos+4 <= len && readBig32(data+pos) <= len-pos-4) {
+            pos += 4+pad4(readBig32(data+pos));
+        } else if (data[k] != 'T' && data[k] != 'F' && data[k] != 'N' && data[k] != 'I') {
+            break; // truncated or unknown, the arguments so far count
+        }
+    }
+
+    if (numNums < std::strlen(args)) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    for (uint32_t k=0; args[k] != 0; k++) {
+        if (args[k] == 'i') {
+            command.ints[numInts++] = (int32_t) nums[k];
+        } else {
+            command.values[numValues++] = nums[k];
+        }
+    }
+    // the optional port of a subscription
+    if (command.type == CONTROL_SUBSCRIBE) {
+        command.ints[0] = (numNums > 0) ? (int32_t) nums[0] : 0;
+    }
+    command.sender = sender;
+
+    if (!push(command)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool CppControlServer::push(const controlCommand &command) {
+    uint32_t pos = writePos.load(std::memory_order_relaxed);
+
+    if (pos-readPos.load(std::memory_order_acquire) >= CONTROL_QUEUE_SIZE) {
+        return false;
+    }
+    queue[pos & (CONTROL_QUEUE_SIZE-1)] = command;
+    writePos.store(pos+1, std::memory_order_release);
+    return true;
+}
+
+uint32_t CppControlServer::processCommands(CppRTA *rta) {
+    uint32_t pos = readPos.load(std::memory_order_relaxed), end = writePos.load(std::memory_order_acquire);
+    uint32_t numHandled = 0, chanID, eqID;
+    std::chrono::steady_clock::time_point now;
+    CppRTAChangeSet changes;
+    bool changed = false;
+    int error;
+
+    for (; pos != end; pos++, numHandled++) {
+        const controlCommand &command = queue[pos & (CONTROL_QUEUE_SIZE-1)];
+        chanID = (uint32_t) command.ints[0];
+        eqID = (uint32_t) command.ints[1];
+
+        // everything of one drain goes to the audio thread as one change set, the
+        // commands up to CONTROL_LIMITER are the ones that go through it
+        if (command.type <= CONTROL_LIMITER && !changed) {
+            changes = rta->beginChanges();
+            changed = true;
+        }
+        switch (command.type) {
+        case CONTROL_EQ_NUM:
+            error = (eqID <= CONTROL_MAX_EQS) ? changes.setNumEQs(chanID, eqID) : -1;
+            break;
+        case CONTROL_EQ:
+            error = changes.setEq(chanID, eqID, (eqType) command.ints[2], command.values[0],
+                                  command.values[1], command.values[2]);
+            break;
+        case CONTROL_EQ_GAIN:
+            error = changes.setEqGain(chanID, eqID, command.values[0]);
+            break;
+        case CONTROL_EQ_FREQ:
+            error = changes.setEqFrequency(chanID, eqID, command.values[0]);
+            break;
+        case CONTROL_EQ_Q:
+            error = changes.setEqQFactor(chanID, eqID, command.values[0]);
+            break;
+        case CONTROL_EQ_TYPE:
+            error = changes.setEqType(chanID, eqID, (eqType) command.ints[2]);
+            break;
+        case CONTROL_CUT:
+            error = (command.ints[2] >= FLAT_THRU && command.ints[2] < UNKNOWN_FILTERCHAR && command.ints[3] > 0) ?
+                    changes.setCutParams((filterType) command.ints[1], chanID, (filterChar) command.ints[2],
+                                         command.values[0], (uint32_t) command.ints[3]) : -1;
+            break;
+        case CONTROL_LIMITER:
+            error = changes.setThreshold(chanID, command.values[0]);
+            error |= changes.setMakeupGain(chanID, command.values[1]);
+            error |= changes.setReleaseTime(chanID, command.values[2]);
+            break;
+        case CONTROL_ROUTE:
+            error = rta->setRoutingGain(chanID, eqID, command.values[0]);
+            break;
+        case CONTROL_PING:
+            beginMessage(message, "/vdsp/pong", ",");
+            send(message, command.sender);
+            error = 0;
+            break;
+        case CONTROL_SUBSCRIBE:
+            subscribe(command.sender, command.ints[0]);
+            error = 0;
+            break;
+        case CONTROL_UNSUBSCRIBE:
+            unsubscribe(command.sender);
+            error = 0;
+            break;
+        default:
+            error = -1;
+            break;
+        }
+        if (error != 0) {
+            errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    readPos.store(pos, std::memory_order_release);
+
+    if (changed && rta->commitChanges(changes) != 0) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    now = std::chrono::steady_clock::now();
+    if (now >= nextTelemetry) {
+        subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+            [now](const subscriber &s) { return s.expiry < now; }), subscribers.end());
+        if (!subscribers.empty()) {
+            sendTelemetry(rta);
+        }
+        // keeps the rate, unless the caller fell behind by more than a period
+        nextTelemetry += telemetryPeriod;
+        if (nextTelemetry < now) {
+            nextTelemetry = now+telemetryPeriod;
+        }
+    }
+    return numHandled;
+}
+
+void CppControlServer::subscribe(const controlAddress &address, int32_t port) {
+    subscriber entry;
+
+    entry.address = address;
+    entry.expiry = std::chrono::steady_clock::now()+std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(CONTROL_SUBSCRIBE_TIMEOUT));
+    if (port > 0 && port < 0x10000) {
+        struct sockaddr *addr = (struct sockaddr*) entry.address.data;
+        if (addr->sa_family == AF_INET) {
+            ((struct sockaddr_in*) addr)->sin_port = htons((uint16_t) port);
+        } else if (addr->sa_family == AF_INET6) {
+            ((struct sockaddr_in6*) addr)->sin6_port = htons((uint16_t) port);
+        }
+    }
+
+    for (uint32_t k=0; k<subscribers.size(); k++) {
+        if (sameAddress(subscribers[k].address, entry.address)) {
+            subscribers[k].expiry = entry.expiry;
+            return;
+        }
+    }
+    if (subscribers.size() < CONTROL_MAX_SUBSCRIBERS) {
+        subscribers.push_back(entry);
+    } else {
+        errors.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void CppControlServer::unsubscribe(const controlAddress &address) {
+    // a subscription with a port of its own comes from the same host, any port
+    for (uint32_t k=0; k<subscribers.size(); ) {
+        const struct sockaddr *a = (const struct sockaddr*) subscribers[k].address.data;
+        const struct sockaddr *b = (const struct sockaddr*) address.data;
+        bool sameHost = a->sa_family == b->sa_family &&
+            ((a->sa_family == AF_INET && std::memcmp(&((const struct sockaddr_in*) a)->sin_addr,
+                &((const struct sockaddr_in*) b)->sin_addr, sizeof(struct in_addr)) == 0) ||
+             (a->sa_family == AF_INET6 && std::memcmp(&((const struct sockaddr_in6*) a)->sin6_addr,
+                &((const struct sockaddr_in6*) b)->sin6_addr, sizeof(struct in6_addr)) == 0));
+        if (sameHost) {
+            subscribers.erase(subscribers.begin()+k);
+        } else {
+            k++;
+        }
+    }
+}
+
+void CppControlServer::sendTelemetry(CppRTA *rta) {
+    std::vector<uint8_t> tags;
+    uint32_t numIns = rta->getNumIns(), numOuts = rta->getNumOuts();
+
+    // immediate time tag
+    packet.clear();
+    putString(packet, "#bundle");
+    putBig32(packet, 0);
+    putBig32(packet, 1);
+
+    putFloatTags(tags, numIns);
+    beginMessage(message, "/vdsp/meter/in", (const char*) tags.data());
+    for (uint32_t j=0; j<numIns; j++) {
+        putFloat(message, (float) rta->getInputPeak(j));
+    }
+    appendToBundle(packet, message);
+
+    putFloatTags(tags, numOuts);
+    beginMessage(message, "/vdsp/meter/out", (const char*) tags.data());
+    for (uint32_t i=0; i<numOuts; i++) {
+        putFloat(message, (float) rta->getOutputPeak(i));
+    }
+    appendToBundle(packet, message);
+
+    beginMessage(message, "/vdsp/meter/gr", (const char*) tags.data());
+    for (uint32_t i=0; i<numOuts; i++) {
+        putFloat(message, (float) rta->getGainReduction(i));
+    }
+    appendToBundle(packet, message);
+
+    beginMessage(message, "/vdsp/timing", ",hiff");
+    uint64_t blocks = rta->getBlockCount();
+    putBig32(message, (uint32_t) (blocks >> 32));
+    putBig32(message, (uint32_t) blocks);
+    putBig32(message, rta->getXrunCount());
+    putFloat(message, (float) rta->getDspLoad());
+    putFloat(message, (float) rta->getDriftRatio());
+    appendToBundle(packet, message);
+
+    for (uint32_t k=0; k<subscribers.size(); k++) {
+        send(packet, subscribers[k].address);
+    }
+}
+
+void CppControlServer::send(const std::vector<uint8_t> &data, const controlAddress &address) {
+    // never waits (non-blocking socket), a full socket buffer drops the packet like the
+    // network would
+    if (sendto(sock, (const char*) data.data(), (int) data.size(), 0,
+               (const struct sockaddr*) address.data, (socklen_t) address.len) < 0) {
+        unsent.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,162 @@
+/*------------------------------------------------------------------*\
+Interface to a control server for remote parameter control and
+telemetry, so one controller can drive many units (e.g. a rack of
+loudspeaker processors running virtualDSP-cli).
+
+The server listens on a UDP port and speaks OSC 1.0 (messages and
+bundles, int32/float32/float64/int64 arguments, each accepted for any
+numeric parameter). Its thread only receives and parses; every command
+goes into a wait-free single producer / single consumer queue. The
+thread that owns the CppRTA instance drains it with processCommands(),
+which applies all parameter changes of one drain as a single change
+set, so the audio thread never waits, locks or allocates for remote
+control. processCommands() also sends the telemetry at a fixed rate.
+
+Addresses, channels and EQs count from 0, types use the values of the
+enums in CppDSP.h:
+  /vdsp/eq/num     i chan, i numEQs
+  /vdsp/eq         i chan, i eq, i eqType, f freq, f gain, f Q
+  /vdsp/eq/gain    i chan, i eq, f gain (also /freq, /q, and /type i)
+  /vdsp/cut        i chan, i filterType, i filterChar, f freq, i order
+  /vdsp/limiter    i chan, f threshold, f makeup, f release
+  /vdsp/route      i out, i in, f gain
+  /vdsp/ping       answered by /vdsp/pong to the sender
+  /vdsp/subscribe  [i port] telemetry to the sender (or its port) for
+                   CONTROL_SUBSCRIBE_TIMEOUT seconds, renew to keep it
+  /vdsp/unsubscribe
+Telemetry is one bundle per period: /vdsp/meter/in, /vdsp/meter/out
+(peaks in dBFS), /vdsp/meter/gr (limiter gain reduction in dB), one
+float per channel each, and /vdsp/timing (h blocks, i xruns, f DSP
+load, f drift ratio).
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPCONTROL_H // include guard
+#define _CPPCONTROL_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// commands the queue holds, a power of two
+#define CONTROL_QUEUE_SIZE 0x400
+#define CONTROL_MAX_SUBSCRIBERS 16
+#define CONTROL_SUBSCRIBE_TIMEOUT 10.0
+// EQs per channel a controller may ask for
+#define CONTROL_MAX_EQS 0x40
+
+class CppRTA;
+
+typedef enum {
+    CONTROL_EQ_NUM = 0x60,
+    CONTROL_EQ,
+    CONTROL_EQ_GAIN,
+    CONTROL_EQ_FREQ,
+    CONTROL_EQ_Q,
+    CONTROL_EQ_TYPE,
+    CONTROL_CUT,
+    CONTROL_LIMITER,
+    CONTROL_ROUTE,
+    CONTROL_PING,
+    CONTROL_SUBSCRIBE,
+    CONTROL_UNSUBSCRIBE,
+    UNKNOWN_CONTROL
+} controlCommandType;
+
+// socket address of a sender, large enough for IPv4 and IPv6
+struct controlAddress {
+    uint8_t data[128];
+    uint32_t len = 0;
+};
+
+struct controlCommand {
+    controlCommandType type;
+    int32_t ints[4];
+    double values[3];
+    controlAddress sender;
+};
+
+class CppControlServer {
+
+public:
+    CppControlServer(void);
+
+    ~CppControlServer(void);
+
+    // Binds the UDP port on address (loopback by default, "0.0.0.0" for all interfaces)
+    // and starts receiving. Throws std::invalid_argument if the port cannot be bound.
+    void start(uint16_t port, const std::string &address = "127.0.0.1");
+
+    void stop();
+
+    inline bool isRunning() const {
+        return running.load(std::memory_order_relaxed);
+    }
+
+    // Telemetry bundles per second to every subscriber.
+    inline void setTelemetryRate(double rate) {
+        if (rate > 0.0) {
+            telemetryPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(1.0/rate));
+        }
+    }
+
+    // Applies the queued commands to rta and sends the telemetry if due. Call it from the
+    // thread that starts, stops and changes rta, at least at the telemetry rate. Returns
+    // the number of commands handled.
+    uint32_t processCommands(CppRTA *rta);
+
+    // commands lost because the queue was full
+    inline uint32_t getDroppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    // telemetry packets not sent because the socket buffer was full
+    inline uint32_t getUnsentCount() const {
+        return unsent.load(std::memory_order_relaxed);
+    }
+
+    // packets that could not be parsed and commands rejected by CppRTA
+    inline uint32_t getErrorCount() const {
+        return errors.load(std::memory_order_relaxed);
+    }
+
+    inline uint32_t getNumSubscribers() const {
+        return (uint32_t) subscribers.size();
+    }
+
+private:
+    struct subscriber {
+        controlAddress address;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    void threadLoop();
+
+    // Parses an OSC packet (message or bundle) into the queue.
+    void parsePacket(const uint8_t *data, uint32_t len, const controlAddress &sender, uint32_t depth);
+
+    bool push(const controlCommand &command);
+
+    void subscribe(const controlAddress &address, int32_t port);
+
+    void unsubscribe(const controlAddress &address);
+
+    void sendTelemetry(CppRTA *rta);
+
+    void send(const std::vector<uint8_t> &packet, const controlAddress &address);
+
+    std::vector<controlCommand> queue;
+    std::vector<subscriber> subscribers;
+    std::vector<uint8_t> packet, message;
+    std::thread thread;
+    std::atomic<uint32_t> writePos, readPos, dropped, errors, unsent;
+    std::atomic<bool> running;
+    std::chrono::steady_clock::duration telemetryPeriod;
+    std::chrono::steady_clock::time_point nextTelemetry;
+    intptr_t sock;
+};
+
+#endif // end of include guard
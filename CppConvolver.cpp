@@ -0,0 +1,199 @@
+/*------------------------------------------------------------------*\
+Implementation of a multichannel uniformly partitioned overlap-save
+convolution engine with shared frequency-domain delay lines.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include "CppConvolver.h"
+
+CppConvolver::CppConvolver(void)
+    : blockLen(0), numBins(0) {
+
+}
+
+CppConvolver::CppConvolver(uint32_t blockLen, uint32_t numIns, uint32_t numOuts)
+    : blockLen(0), numBins(0) {
+    setSize(blockLen, numIns, numOuts);
+}
+
+CppConvolver::~CppConvolver(void) {
+
+}
+
+int CppConvolver::setSize(uint32_t blockLen, uint32_t numIns, uint32_t numOuts) {
+    if (blockLen < 1) {
+        return -1;
+    }
+
+    this->blockLen = blockLen;
+    numBins = blockLen+1;
+    fft.setSize(2*blockLen);
+    work.resize(2*blockLen+2, 0.0f);
+    accu.resize(numBins);
+
+    filters.clear();
+    filters.resize(numOuts);
+
+    inputs.clear();
+    inputs.resize(numIns);
+    for (uint32_t i=0; i<numIns; i++) {
+        inputs[i].timeBuf.resize(2*blockLen, 0.0f);
+        inputs[i].numParts = 0;
+        inputs[i].pos = 0;
+        inputs[i].numUsers = 0;
+    }
+
+    return 0;
+}
+
+int CppConvolver::setFilter(uint32_t outID, uint32_t inID, const std::vector<double> &ir) {
+    firFilter newFilter;
+    uint32_t len;
+
+    if (outID >= filters.size() || inID >= inputs.size() || blockLen < 1) {
+        return -1;
+    }
+
+    if (ir.empty()) {
+        return clearFilter(outID, inID);
+    }
+
+    // every partition is the spectrum of blockLen taps, zero padded to the FFT length
+    newFilter.inID = inID;
+    newFilter.numParts = ((uint32_t) ir.size() + blockLen-1)/blockLen;
+    newFilter.parts.resize(newFilter.numParts*numBins);
+    for (uint32_t p=0; p<newFilter.numParts; p++) {
+        std::fill(work.begin(), work.end(), 0.0f);
+        len = std::min(blockLen, (uint32_t) ir.size()-p*blockLen);
+        for (uint32_t j=0; j<len; j++) {
+            work[j] = (float) ir[p*blockLen+j];
+        }
+        fft.forward(work.data(), &newFilter.parts[p*numBins]);
+    }
+
+    for (uint32_t i=0; i<filters[outID].size(); i++) {
+        if (filters[outID][i].inID == inID) {
+            std::swap(filters[outID][i], newFilter);
+            updateInputLine(inID);
+            return 0;
+        }
+    }
+
+    filters[outID].push_back(newFilter);
+    updateInputLine(inID);
+    return 0;
+}
+
+int CppConvolver::clearFilter(uint32_t outID, uint32_t inID) {
+    if (outID >= filters.size() || inID >= inputs.size()) {
+        return -1;
+    }
+
+    for (uint32_t i=0; i<filters[outID].size(); i++) {
+        if (filters[outID][i].inID == inID) {
+            filters[outID].erase(filters[outID].begin()+i);
+            updateInputLine(inID);
+            return 0;
+        }
+    }
+    return 0;
+}
+
+void CppConvolver::updateInputLine(uint32_t inID) {
+    inputLine &line = inputs[inID];
+    uint32_t numParts = 0, numUsers = 0;
+
+    for (uint32_t o=0; o<filters.size(); o++) {
+        for (uint32_t i=0; i<filters[o].size(); i++) {
+            if (filters[o][i].inID == inID) {
+                numParts = std::max(numParts, filters[o][i].numParts);
+                numUsers++;
+            }
+        }
+    }
+
+    line.numUsers = numUsers;
+    if (numParts > line.numParts) {
+        line.fdl.assign(numParts*numBins, complex(0.0f, 0.0f));
+        line.numParts = numParts;
+        line.pos = 0;
+    }
+}
+
+void CppConvolver::reset() {
+    for (uint32_t i=0; i<inputs.size(); i++) {
+        std::fill(inputs[i].timeBuf.begin(), inputs[i].timeBuf.end(), 0.0f);
+        std::fill(inputs[i].fdl.begin(), inputs[i].fdl.end(), complex(0.0f, 0.0f));
+    }
+}
+
+int CppConvolver::takeOver(CppConvolver &old) {
+    if (old.blockLen != blockLen || old.inputs.size() != inputs.size()) {
+        return -1;
+    }
+
+    // a line of another length starts empty, as after setFilter()
+    for (uint32_t i=0; i<inputs.size(); i++) {
+        inputLine &line = inputs[i];
+        inputLine &oldLine = old.inputs[i];
+        if (oldLine.numUsers == 0) {
+            continue;
+        }
+        line.timeBuf.swap(oldLine.timeBuf);
+        if (line.numParts == oldLine.numParts) {
+            line.fdl.swap(oldLine.fdl);
+            std::swap(line.pos, oldLine.pos);
+        }
+    }
+    return 0;
+}
+
+void CppConvolver::process(const std::vector< std::vector<double> > &in, std::vector< std::vector<double> > &out) {
+    const complex_float32 *x, *h;
+    uint32_t slot;
+
+    // forward transform of each used input, once per block
+    for (uint32_t i=0; i<inputs.size() && i<in.size(); i++) {
+        inputLine &line = inputs[i];
+        if (line.numUsers == 0) {
+            continue;
+        }
+
+        std::copy(line.timeBuf.begin()+blockLen, line.timeBuf.end(), line.timeBuf.begin());
+        for (uint32_t j=0; j<blockLen; j++) {
+            line.timeBuf[blockLen+j] = (float) in[i][j];
+        }
+
+        line.pos = (line.pos+line.numParts-1)%line.numParts;
+        std::copy(line.timeBuf.begin(), line.timeBuf.end(), work.begin());
+        fft.forward(work.data(), &line.fdl[line.pos*numBins]);
+    }
+
+    // complex multiply-accumulate over all partitions of all filters of an output
+    for (uint32_t o=0; o<filters.size() && o<out.size(); o++) {
+        if (filters[o].empty()) {
+            continue;
+        }
+
+        std::fill(accu.begin(), accu.end(), complex(0.0f, 0.0f));
+        for (uint32_t f=0; f<filters[o].size(); f++) {
+            const firFilter &filt = filters[o][f];
+            const inputLine &line = inputs[filt.inID];
+            for (uint32_t p=0; p<filt.numParts; p++) {
+                slot = (line.pos+p)%line.numParts;
+                x = &line.fdl[slot*numBins];
+                h = &filt.parts[p*numBins];
+                for (uint32_t k=0; k<numBins; k++) {
+                    accu[k].re += x[k].re*h[k].re - x[k].im*h[k].im;
+                    accu[k].im += x[k].re*h[k].im + x[k].im*h[k].re;
+                }
+            }
+        }
+
+        // overlap-save: the second half of the inverse transform is valid
+        fft.inverse(accu.data(), work.data());
+        for (uint32_t j=0; j<blockLen; j++) {
+            out[o][j] = work[blockLen+j];
+        }
+    }
+}
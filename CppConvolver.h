@@ -0,0 +1,78 @@
+/*------------------------------------------------------------------*\
+Interface to a multichannel (MIMO) FIR convolution engine. Uniformly
+partitioned overlap-save convolution with a frequency-domain delay
+line (FDL) per input: the forward FFT of every input is computed once
+per block and shared by all outputs convolving that input, so the FFT
+cost grows with inputs + outputs instead of inputs x outputs.
+
+Partition size equals the audio block length, the FFT length is twice
+the block length and need not be a power of two (see CppFFT.h). The
+output block is computed from the input block of the same call, so
+there is no latency on top of the audio block itself. The spectral
+processing runs in single precision.
+
+setSize(), setFilter() and clearFilter() must not run while process()
+does. A running engine changes its filters by a second one configured
+on another thread, which continues its input history with takeOver()
+at a block boundary.
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPCONVOLVER_H // include guard
+#define _CPPCONVOLVER_H
+
+#include <vector>
+#include <cstdint>
+#include "CppFFT.h"
+
+class CppConvolver {
+
+public:
+    CppConvolver(void);
+
+    CppConvolver(uint32_t blockLen, uint32_t numIns, uint32_t numOuts);
+
+    ~CppConvolver(void);
+
+    int setSize(uint32_t blockLen, uint32_t numIns, uint32_t numOuts);
+
+    int setFilter(uint32_t outID, uint32_t inID, const std::vector<double> &ir);
+
+    int clearFilter(uint32_t outID, uint32_t inID);
+
+    inline bool isActive(uint32_t outID) const {
+        return outID < filters.size() && !filters[outID].empty();
+    }
+
+    uint32_t getBlockLen() const { return blockLen; }
+
+    void process(const std::vector< std::vector<double> > &in, std::vector< std::vector<double> > &out);
+
+    void reset();
+
+    // Continues the delay lines of old, an engine of the same size that was running until
+    // now. Swaps only, so it may run on the audio thread.
+    int takeOver(CppConvolver &old);
+
+private:
+    struct firFilter {
+        uint32_t inID, numParts;
+        std::vector<complex_float32> parts;
+    };
+
+    struct inputLine {
+        std::vector<float> timeBuf;
+        std::vector<complex_float32> fdl;
+        uint32_t numParts, pos, numUsers;
+    };
+
+    void updateInputLine(uint32_t inID);
+
+    CppFFTf fft;
+    std::vector< std::vector<firFilter> > filters;
+    std::vector<inputLine> inputs;
+    std::vector<float> work;
+    std::vector<complex_float32> accu;
+    uint32_t blockLen, numBins;
+};
+
+#endif // end of include guard
@@ -11,19 +11,150 @@ Version 0.1.0 (debugged and tested, 05.07.2019).
 \*------------------------------------------------------------------*/
 
 #include <algorithm>
+#include <map>
+#include <mutex>
 #include "fft.h"
+#include "CppFFT.h"
 #include "complex_float64.h"
 #include "CppDSP.h"
+#include "CppDenormal.h"
 
 #ifndef M_PI
 #define M_PI 3.141592653589793
 #endif
 
+static inline int realFFT(CppFFT &plan, double *data, uint32_t nfft) {
+	// powers of two use the radix-2 FFT with the static twiddle table
+	if (plan.getSize() == nfft) {
+		return plan.forward(data, (complex_float64*) data);
+	}
+	return fft_double(data, (complex_float64*) data, nfft);
+}
+
+// sin^2(w/2) and cos^2(w/2) of every bin as float pairs hi+lo, the lo part holds what
+// the float hi part rounds away.
+struct binSinCosSquared {
+	std::vector<float> sinSq, sinSqLo, cosSq, cosSqLo;
+
+	explicit binSinCosSquared(uint32_t nfft)
+		: sinSq(nfft/2+1), sinSqLo(nfft/2+1), cosSq(nfft/2+1), cosSqLo(nfft/2+1) {
+		double x;
+		for (uint32_t i=0; i<nfft/2+1; i++) {
+			x = pow(sin(M_PI*i/nfft), 2);
+			sinSq[i] = (float) x;
+			sinSqLo[i] = (float) (x - sinSq[i]);
+			x = pow(cos(M_PI*i/nfft), 2);
+			cosSq[i] = (float) x;
+			cosSqLo[i] = (float) (x - cosSq[i]);
+		}
+	}
+};
+
+struct magnitudePoly {
+	uint32_t order;
+	float k, r1, r1Lo, r2, r2Lo, v;
+};
+
+static magnitudePoly factorMagnitudePoly(double b0, double b1, double b2) {
+	// |b0+b1*z^-1+b2*z^-2|^2 on the unit circle as k2*x^2+k1*x+k0 with x = sin^2(w/2)
+	// (for x = cos^2(w/2) pass -b1), in root or vertex form, so a float evaluation
+	// close to a zero does not cancel. The vertex offset comes from the factored
+	// discriminant 4*k0*k2-k1^2 = -16*(b0-b2)^2*(b1^2-4*b0*b2), which is exactly 0 for
+	// zeros on the unit circle; k0/k2-h^2 would cancel and split such a double root.
+	// Coefficients and roots are computed in double, the roots are kept as float
+	// pairs hi+lo like the bins.
+	const double k0 = pow(b0+b1+b2, 2), k1 = -4.0*(b1*(b0+b2) + 4.0*b0*b2), k2 = 16.0*b0*b2;
+	magnitudePoly p = {0, (float) k0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+	double h, v, r1 = 0.0, r2 = 0.0;
+
+	if (k2 != 0.0) {
+		h = -k1/(2.0*k2);
+		v = -pow(b0-b2, 2)*(b1*b1 - 4.0*b0*b2)/(64.0*b0*b0*b2*b2);
+		p.order = 2;
+		p.k = (float) k2;
+		if (v >= 0.0) {
+			r1 = r2 = h;
+			p.v = (float) v;
+		} else {
+			r1 = h - sqrt(-v);
+			r2 = h + sqrt(-v);
+		}
+	} else if (k1 != 0.0) {
+		p.order = 1;
+		p.k = (float) k1;
+		r1 = -k0/k1;
+	}
+	p.r1 = (float) r1;
+	p.r1Lo = (float) (r1 - p.r1);
+	p.r2 = (float) r2;
+	p.r2Lo = (float) (r2 - p.r2);
+	return p;
+}
+
+static inline float evalMagnitudePoly(const magnitudePoly &p, float x, float xLo) {
+	// close to a root both hi parts are within a factor of two, their difference is
+	// exact and the lo parts restore the digits float rounding took from x and the root
+	if (p.order == 2) {
+		return p.k*(((x-p.r1)+(xLo-p.r1Lo))*((x-p.r2)+(xLo-p.r2Lo)) + p.v);
+	} else if (p.order == 1) {
+		return p.k*((x-p.r1)+(xLo-p.r1Lo));
+	}
+	return p.k;
+}
+
+static void addBiquadMagnitude(std::vector<float> &tf, const binSinCosSquared &bins, const double *c) {
+	// |H|^2 as polynomial in s = sin^2(w/2) below fs/4 and in c = cos^2(w/2) above,
+	// so zeros at DC and Nyquist are both resolved without cancellation.
+	const magnitudePoly numS = factorMagnitudePoly(c[0], c[1], c[2]);
+	const magnitudePoly numC = factorMagnitudePoly(c[0], -c[1], c[2]);
+	const magnitudePoly denS = factorMagnitudePoly(1.0, c[3], c[4]);
+	const magnitudePoly denC = factorMagnitudePoly(1.0, -c[3], c[4]);
+	const uint32_t numBins = (uint32_t) std::min(tf.size(), bins.sinSq.size());
+	uint32_t i;
+	float num, den;
+
+	for (i=0; i<numBins && bins.sinSq[i]<0.5f; i++) {
+		num = evalMagnitudePoly(numS, bins.sinSq[i], bins.sinSqLo[i]);
+		den = evalMagnitudePoly(denS, bins.sinSq[i], bins.sinSqLo[i]);
+		tf[i] += 10.0f*log10f(fmaxf(num/den, 1e-30f));
+	}
+	for (; i<numBins; i++) {
+		num = evalMagnitudePoly(numC, bins.cosSq[i], bins.cosSqLo[i]);
+		den = evalMagnitudePoly(denC, bins.cosSq[i], bins.cosSqLo[i]);
+		tf[i] += 10.0f*log10f(fmaxf(num/den, 1e-30f));
+	}
+}
+
+// Cutoff designs shared by all CppXover instances. Only the GUI / control side designs
+// filters, the audio thread never touches the cache.
+struct xoverDesignKey {
+	double fs, freq, ripple, attenuation;
+	uint32_t ord;
+	int charac, type;
+
+	bool operator<(const xoverDesignKey &other) const {
+		if (fs != other.fs) return fs < other.fs;
+		if (freq != other.freq) return freq < other.freq;
+		if (ord != other.ord) return ord < other.ord;
+		if (charac != other.charac) return charac < other.charac;
+		if (type != other.type) return type < other.type;
+		if (ripple != other.ripple) return ripple < other.ripple;
+		return attenuation < other.attenuation;
+	}
+};
+
+#define XOVER_DESIGN_CACHE_SIZE 4096
+
+static std::map< xoverDesignKey, std::vector< std::vector<double> > > xoverDesignCache;
+static std::mutex xoverDesignMutex;
+
 CppXover::CppXover(void)
-    : fs(44100.), freq(1000.0), charac(FLAT_THRU), type(LOWPASS), ord(2), nSOS(1) {
+    : freq(1000.0), fs(44100.), ripple(1.0), attenuation(40.0), secFade(0.01), ord(2), nSOS(1),
+	  fadeLen(441), fadeCnt(0), charac(FLAT_THRU), type(LOWPASS), topology(DIRECT_FORM), smoothing(false),
+	  pipelined(false), kernel(nullptr) {
 	int error;
 
-    error = designFilter(this->ord);
+    error = designFilter();
     reset();
     if (error <0) {
     	for (uint32_t i=0; i<((uint32_t)coeffs.size()); i++) {
@@ -33,11 +164,13 @@ CppXover::CppXover(void)
 }
 
 CppXover::CppXover(double sampleRate, double freq, filterChar charac, filterType type, uint32_t order)
-    : fs(sampleRate), freq(freq), charac(charac), type(type), ord(order), nSOS((order+1)/2) {
+    : freq(freq), fs(sampleRate), ripple(1.0), attenuation(40.0), secFade(0.01), ord(order), nSOS((order+1)/2),
+	  fadeLen(std::max(1u, (uint32_t) (0.01*sampleRate))), fadeCnt(0), charac(charac), type(type),
+	  topology(DIRECT_FORM), smoothing(false), pipelined(false), kernel(nullptr) {
 
 	int error;
 
-    error = designFilter(this->ord);
+    error = designFilter();
     reset();
     if (error <0) {
     	for (uint32_t i=0; i<((uint32_t)coeffs.size()); i++) {
@@ -50,7 +183,94 @@ CppXover::~CppXover(void) {
 
 }
 
-int CppXover::designFilter(double ripple, double attenuation) {
+int CppXover::designFilter() {
+	xoverDesignKey key;
+	int error;
+
+	key.fs = fs;
+	key.freq = freq;
+	key.ripple = ripple;
+	key.attenuation = attenuation;
+	key.ord = ord;
+	key.charac = (int) charac;
+	key.type = (int) type;
+
+	// the old coefficient set fades out while the new one fades in
+	if (smoothing) {
+		fadeCoeffs = (topology == STATE_VARIABLE) ? svfCoeffs : coeffs;
+		fadeStates = states;
+		fadeCnt = fadeLen;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(xoverDesignMutex);
+		auto it = xoverDesignCache.find(key);
+		if (it != xoverDesignCache.end()) {
+			coeffs = it->second;
+			nSOS = (uint32_t) coeffs.size();
+			states.resize(nSOS);
+			for (uint32_t i=0; i<nSOS; i++) {
+				states.at(i).resize(NUM_STATES_PER_BIQUAD, 0.0);
+			}
+			updateSvf();
+			updateKernel();
+			return 0;
+		}
+	}
+
+	error = computeDesign();
+	if (error == 0 && charac != FLAT_THRU) {
+		std::lock_guard<std::mutex> lock(xoverDesignMutex);
+		if (xoverDesignCache.size() >= XOVER_DESIGN_CACHE_SIZE) {
+			xoverDesignCache.clear();
+		}
+		xoverDesignCache[key] = coeffs;
+	}
+	updateSvf();
+	updateKernel();
+	return error;
+}
+
+void CppXover::updateSvf() {
+	if (topology != STATE_VARIABLE) {
+		return;
+	}
+	svfCoeffs.resize(coeffs.size());
+	for (uint32_t i=0; i<((uint32_t)coeffs.size()); i++) {
+		svfCoeffs.at(i).resize(NUM_COEFFS_PER_SVF);
+		biquadToSvf(coeffs[i].data(), svfCoeffs[i].data());
+	}
+}
+
+void CppXover::biquadToSvf(const double *biquad, double *svf) {
+	double den0, den1, den2, g, k, m0, m1, m2;
+
+	// inverse bilinear transform, s = (1-z^-1)/(1+z^-1) = g*s', H(s') = m0 + (m1*s' + m2)/(s'^2 + k*s' + 1)
+	den0 = 1.0 + biquad[3] + biquad[4];
+	den1 = 2.0*(1.0 - biquad[4]);
+	den2 = 1.0 - biquad[3] + biquad[4];
+	if (den0 <= 0.0 || den2 <= 0.0) {
+		g = 1.0;
+		k = 2.0;
+		m0 = 1.0;
+		m1 = m2 = 0.0;
+	} else {
+		g = sqrt(den0/den2);
+		k = den1/(den2*g);
+		m0 = (biquad[0] - biquad[1] + biquad[2])/den2;
+		m1 = 2.0*(biquad[0] - biquad[2])/(den2*g) - k*m0;
+		m2 = (biquad[0] + biquad[1] + biquad[2])/den0 - m0;
+	}
+
+	svf[0] = 1.0/(1.0 + g*(g + k));
+	svf[1] = g*svf[0];
+	svf[2] = g*svf[1];
+	svf[3] = m0;
+	svf[4] = m1;
+	svf[5] = m2;
+}
+
+int CppXover::computeDesign() {
 
 	std::vector<complex_float64> poles(ord), zeros(ord);
 	complex_float64 one, tmpCmplx;
@@ -275,21 +495,245 @@ std::string CppXover::getCharName(filterChar charac)  {
 	return tmp;
 }
 
+// trapezoidal SVF, states are the two integrator equivalent currents
+static inline void processSvf(const double *c, double *states, double *data, uint32_t len) {
+	double v0, v1, v2, v3;
+	double ic1eq = states[0], ic2eq = states[1];
+	for (uint32_t j = 0; j < len; j++) {
+		v0 = data[j];
+		v3 = v0 - ic2eq;
+		v1 = c[0]*ic1eq + c[1]*v3;
+		v2 = ic2eq + c[1]*ic1eq + c[2]*v3;
+		ic1eq = 2.0*v1 - ic1eq;
+		ic2eq = 2.0*v2 - ic2eq;
+		data[j] = c[3]*v0 + c[4]*v1 + c[5]*v2;
+	}
+	states[0] = ic1eq;
+	states[1] = ic2eq;
+}
+
+// transposed direct form II, the two states of a section stay in registers for the whole block
+static inline void processTdf2(const double *c, double *states, double *data, uint32_t len) {
+	const double b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+	double s1 = states[0], s2 = states[1], x, y;
+	for (uint32_t j = 0; j < len; j++) {
+		x = data[j];
+		y = b0*x + s1;
+		s1 = b1*x - a1*y + s2;
+		s2 = b2*x - a2*y;
+		data[j] = y;
+	}
+	states[0] = s1;
+	states[1] = s2;
+}
+
+static inline void processCascade(const std::vector< std::vector<double> > &coeffs,
+		std::vector< std::vector<double> > &states, double *data, uint32_t len, filterTopology topology) {
+	if (topology == STATE_VARIABLE) {
+		for (unsigned int i = 0; i < coeffs.size(); i++) {
+			processSvf(coeffs[i].data(), states[i].data(), data, len);
+		}
+		return;
+	}
+	for (unsigned int i = 0; i < coeffs.size(); i++) {
+		processTdf2(coeffs[i].data(), states[i].data(), data, len);
+	}
+}
+
+#define XOVER_MAX_SOS 32
+
+/*
+ * Section pipelined TDF-II cascade. At step t section i works on sample t-i, so all
+ * sections of one step are independent and the inner loop over sections vectorises.
+ * Every section does exactly the operations of processTdf2(), so the output is bit
+ * identical, the ramp up / down at the block edges just narrows the section range.
+ */
+void CppXover::processPipelined(std::vector<double> &data) {
+	double b0[XOVER_MAX_SOS], b1[XOVER_MAX_SOS], b2[XOVER_MAX_SOS], a1[XOVER_MAX_SOS], a2[XOVER_MAX_SOS];
+	double s1[XOVER_MAX_SOS], s2[XOVER_MAX_SOS], x[XOVER_MAX_SOS], y[XOVER_MAX_SOS];
+	uint32_t numSOS = (uint32_t) coeffs.size(), len = (uint32_t) data.size(), lo, hi, i;
+	double yy;
+
+	for (i = 0; i < numSOS; i++) {
+		b0[i] = coeffs[i][0];
+		b1[i] = coeffs[i][1];
+		b2[i] = coeffs[i][2];
+		a1[i] = coeffs[i][3];
+		a2[i] = coeffs[i][4];
+		s1[i] = states[i][0];
+		s2[i] = states[i][1];
+		y[i] = 0.0;
+	}
+
+	for (uint32_t t = 0; t+1 < len+numSOS; t++) {
+		lo = (t >= len) ? t-len+1 : 0;
+		hi = std::min(numSOS-1, t);
+
+		// every section takes the output its predecessor produced one step earlier
+		for (i = hi; i > lo; i--) {
+			x[i] = y[i-1];
+		}
+		if (lo == 0) {
+			x[0] = data[t];
+		} else {
+			x[lo] = y[lo-1];
+		}
+
+		for (i = lo; i <= hi; i++) {
+			yy = b0[i]*x[i] + s1[i];
+			s1[i] = b1[i]*x[i] - a1[i]*yy + s2[i];
+			s2[i] = b2[i]*x[i] - a2[i]*yy;
+			y[i] = yy;
+		}
+
+		if (hi == numSOS-1) {
+			data[t-hi] = y[hi];
+		}
+	}
+
+	for (i = 0; i < numSOS; i++) {
+		states[i][0] = s1[i];
+		states[i][1] = s2[i];
+	}
+}
+
+/*
+ * Cascades specialised at compile time for the common crossover orders. N is the number
+ * of sections, bit i of FIRST_ORDER marks section i as first order section (b2 = a2 = 0,
+ * its second state stays zero). The section recursion unrolls completely, all states
+ * stay in registers and the sample loop carries no per-section branch.
+ */
+template <uint32_t I, uint32_t N, uint32_t FIRST_ORDER>
+struct xoverSection {
+	static inline void run(const double (&c)[N][NUM_COEFFS_PER_BIQUAD], double (&s)[N][NUM_STATES_PER_BIQUAD],
+			double &x) {
+		double y = c[I][0]*x + s[I][0];
+		if (FIRST_ORDER & (1u << I)) {
+			s[I][0] = c[I][1]*x - c[I][3]*y;
+		} else {
+			s[I][0] = c[I][1]*x - c[I][3]*y + s[I][1];
+			s[I][1] = c[I][2]*x - c[I][4]*y;
+		}
+		x = y;
+		xoverSection<I+1, N, FIRST_ORDER>::run(c, s, x);
+	}
+};
+
+template <uint32_t N, uint32_t FIRST_ORDER>
+struct xoverSection<N, N, FIRST_ORDER> {
+	static inline void run(const double (&)[N][NUM_COEFFS_PER_BIQUAD], double (&)[N][NUM_STATES_PER_BIQUAD],
+			double &) {
+	}
+};
+
+template <uint32_t N, uint32_t FIRST_ORDER>
+static void processUnrolled(const std::vector< std::vector<double> > &coeffs,
+		std::vector< std::vector<double> > &states, double *data, uint32_t len) {
+	double c[N][NUM_COEFFS_PER_BIQUAD], s[N][NUM_STATES_PER_BIQUAD], x;
+
+	for (uint32_t i = 0; i < N; i++) {
+		for (uint32_t j = 0; j < NUM_COEFFS_PER_BIQUAD; j++) {
+			c[i][j] = coeffs[i][j];
+		}
+		s[i][0] = states[i][0];
+		s[i][1] = (FIRST_ORDER & (1u << i)) ? 0.0 : states[i][1];
+	}
+
+	for (uint32_t j = 0; j < len; j++) {
+		x = data[j];
+		xoverSection<0, N, FIRST_ORDER>::run(c, s, x);
+		data[j] = x;
+	}
+
+	for (uint32_t i = 0; i < N; i++) {
+		states[i][0] = s[i][0];
+		states[i][1] = s[i][1];
+	}
+}
+
+struct unrolledKernel {
+	uint32_t numSOS, firstOrder;
+	CppXover::cascadeKernel kernel;
+};
+
+// odd orders end on a first order section, Linkwitz-Riley repeats the half order cascade
+static const unrolledKernel unrolledKernels[] = {
+	{1, 0x1, processUnrolled<1, 0x1>},	// 1st order
+	{1, 0x0, processUnrolled<1, 0x0>},	// 2nd order
+	{2, 0x2, processUnrolled<2, 0x2>},	// 3rd order
+	{2, 0x0, processUnrolled<2, 0x0>},	// 4th order, LR4
+	{3, 0x4, processUnrolled<3, 0x4>},	// 5th order
+	{3, 0x0, processUnrolled<3, 0x0>},	// 6th order
+	{4, 0x8, processUnrolled<4, 0x8>},	// 7th order
+	{4, 0x0, processUnrolled<4, 0x0>},	// 8th order, LR8
+	{2, 0x3, processUnrolled<2, 0x3>},	// LR2
+	{4, 0xA, processUnrolled<4, 0xA>},	// LR6
+};
+
+void CppXover::updateKernel() {
+	uint32_t numSOS = (uint32_t) coeffs.size(), firstOrder = 0;
+
+	kernel = nullptr;
+	if (numSOS < 1 || numSOS > 4) {
+		return;
+	}
+	for (uint32_t i = 0; i < numSOS; i++) {
+		if (coeffs[i][2] == 0.0 && coeffs[i][4] == 0.0) {
+			firstOrder |= 1u << i;
+		}
+	}
+	for (uint32_t k = 0; k < sizeof(unrolledKernels)/sizeof(unrolledKernels[0]); k++) {
+		if (unrolledKernels[k].numSOS == numSOS && unrolledKernels[k].firstOrder == firstOrder) {
+			kernel = unrolledKernels[k].kernel;
+			return;
+		}
+	}
+}
+
+#define XOVER_FADE_CHUNK 64
+
+void CppXover::processCrossfade(std::vector<double> &data) {
+	double old[XOVER_FADE_CHUNK], gainOld;
+	uint32_t len;
+
+	// both cascades run on chunks, an empty cascade (flat) passes the input through
+	for (uint32_t start = 0; start < data.size(); start += XOVER_FADE_CHUNK) {
+		len = std::min((uint32_t) data.size()-start, (uint32_t) XOVER_FADE_CHUNK);
+		std::copy(data.begin()+start, data.begin()+start+len, old);
+		processCascade(fadeCoeffs, fadeStates, old, len, topology);
+		processCascade((topology == STATE_VARIABLE) ? svfCoeffs : coeffs, states, &data[start], len, topology);
+		for (uint32_t i = 0; i < len && fadeCnt > 0; i++, fadeCnt--) {
+			gainOld = (double) fadeCnt/fadeLen;
+			data[start+i] = gainOld*old[i] + (1.0-gainOld)*data[start+i];
+		}
+		if (fadeCnt == 0) {
+			processCascade((topology == STATE_VARIABLE) ? svfCoeffs : coeffs, states, &data[start+len],
+					(uint32_t) data.size()-start-len, topology);
+			return;
+		}
+	}
+}
+
 void CppXover::process(std::vector<double> &data) {
-	  double tmp;
-	  for (unsigned int i = 0; i < coeffs.size(); i++) {
-		  for (unsigned int j = 0; j < data.size(); j++) {
-				tmp = data[j]-states[i][0]*coeffs[i][3]-states[i][1]*coeffs[i][4];
-				data[j] = tmp*coeffs[i][0]+states[i][0]*coeffs[i][1]+states[i][1]*coeffs[i][2];
-				states[i][1] = states[i][0];
-				states[i][0] = tmp;
-		  }
+	  if (fadeCnt > 0) {
+		  processCrossfade(data);
+	  } else if (topology == STATE_VARIABLE) {
+		  processCascade(svfCoeffs, states, data.data(), (uint32_t) data.size(), topology);
+	  } else if (pipelined && coeffs.size() > 1 && coeffs.size() <= XOVER_MAX_SOS && !data.empty()) {
+		  processPipelined(data);
+	  } else if (kernel != nullptr) {
+		  kernel(coeffs, states, data.data(), (uint32_t) data.size());
+	  } else {
+		  processCascade(coeffs, states, data.data(), (uint32_t) data.size(), topology);
 	  }
 }
 
 int CppXover::addTransferFunction(std::vector<double> &tf, uint32_t nfft) {
-    if (ilog2(nfft) == 0){
+	CppFFT plan;
+    if (nfft < 4) {
         return -1;
+    } else if (ilog2(nfft) == 0) {
+    	plan.setSize(nfft);
     }
 
     if (charac == FLAT_THRU) {
@@ -310,8 +754,8 @@ int CppXover::addTransferFunction(std::vector<double> &tf, uint32_t nfft) {
 		ap[1] = coeffs[i][3];
 		ap[2] = coeffs[i][4];
 
-		fft_double(bp, bFreq, nfft);
-		fft_double(ap, aFreq, nfft);
+		realFFT(plan, bp, nfft);
+		realFFT(plan, ap, nfft);
 
 		for (uint32_t i=0; i<nfft/2+1; i++) {
 			tf[i]+= 20*log10(complex_abs(complex_div(bFreq[i], aFreq[i])));
@@ -321,8 +765,27 @@ int CppXover::addTransferFunction(std::vector<double> &tf, uint32_t nfft) {
 	return 0;
 }
 
+int CppXover::addTransferFunction(std::vector<float> &tf, uint32_t nfft) {
+	if (nfft < 4) {
+		return -1;
+	}
+
+	if (charac == FLAT_THRU) {
+		return 0;
+	}
+
+	const binSinCosSquared bins(nfft);
+	for (uint32_t i = 0; i < (uint32_t) coeffs.size(); i++) {
+		addBiquadMagnitude(tf, bins, coeffs[i].data());
+	}
+
+	return 0;
+}
+
 CppEQ::CppEQ(void)
-    : fs(44100.), gain(0.0), freq(1000.0), Q(0.71), type(PEAKEQ) {
+    : fs(44100.), gain(0.0), freq(1000.0), Q(0.71), curGain(0.0), curFreq(1000.0), curQ(0.71),
+      secRamp(0.02), rampCoeff(1.0-exp(-EQ_RAMP_LEN/(0.02*44100.))), type(PEAKEQ),
+      topology(DIRECT_FORM), smoothing(false), rampPending(false), bypassed(false) {
 	int error;
     coeffs.resize(5, 0.0);
     states.resize(2, 0.0);
@@ -336,7 +799,9 @@ CppEQ::CppEQ(void)
 
 
 CppEQ::CppEQ(double sampleRate, double gain, double freq, double Q, eqType type)
-    : fs(sampleRate), gain(gain), freq(freq), Q(Q), type(type) {
+    : fs(sampleRate), gain(gain), freq(freq), Q(Q), curGain(gain), curFreq(freq), curQ(Q),
+      secRamp(0.02), rampCoeff(1.0-exp(-EQ_RAMP_LEN/(0.02*sampleRate))), type(type),
+      topology(DIRECT_FORM), smoothing(false), rampPending(false), bypassed(false) {
 	int error;
     coeffs.resize(5, 0.0);
     states.resize(2, 0.0);
@@ -353,7 +818,7 @@ CppEQ::~CppEQ(void) {
 }
 
 
-int CppEQ::designBiquad() {
+int CppEQ::designBiquad(double gain, double freq, double Q, double *coeffs) {
     if (freq < 0) {
 		return -1;
     }
@@ -437,6 +902,59 @@ int CppEQ::designBiquad() {
 	return 0;
 }
 
+void CppEQ::designSvf(double gain, double freq, double Q) {
+	double A, g, k, m0, m1, m2;
+
+	A = pow(10, gain*0.025);
+	g = tan(M_PI*freq/fs);
+	k = 1.0/Q;
+	m0 = m1 = m2 = 0.0;
+
+	// invalid parameters pass the signal through
+	if (freq <= 0 || freq >= fs/2 || Q <= 0) {
+		g = 1.0;
+		k = 2.0;
+		m0 = 1.0;
+	} else if(type == LOWPASSEQ) {
+		m2 = 1.0;
+	} else if(type == HIGHPASSEQ) {
+		m0 = 1.0;
+		m1 = -k;
+		m2 = -1.0;
+	} else if(type == ALLPASS) {
+		m0 = 1.0;
+		m1 = -2.0*k;
+	} else if(type == BANDPASS) {
+		m1 = 1.0;
+	} else if(type == NOTCH) {
+		m0 = 1.0;
+		m1 = -k;
+	} else if(type == PEAKEQ) {
+		k = 1.0/(Q*A);
+		m0 = 1.0;
+		m1 = k*(A*A-1.0);
+	} else if(type == LOWSHELV) {
+		g /= sqrt(A);
+		m0 = 1.0;
+		m1 = k*(A-1.0);
+		m2 = A*A-1.0;
+	} else if(type == HIGHSHELV) {
+		g *= sqrt(A);
+		m0 = A*A;
+		m1 = k*(1.0-A)*A;
+		m2 = 1.0-A*A;
+	} else {
+		m0 = 1.0;
+	}
+
+	svfCoeffs[0] = 1.0/(1.0 + g*(g + k));
+	svfCoeffs[1] = g*svfCoeffs[0];
+	svfCoeffs[2] = g*svfCoeffs[1];
+	svfCoeffs[3] = m0;
+	svfCoeffs[4] = m1;
+	svfCoeffs[5] = m2;
+}
+
 std::string CppEQ::getTypeName(eqType type) {
 	std::string tmp;
 	if(type == LOWPASSEQ) { //LoPass
@@ -461,34 +979,73 @@ std::string CppEQ::getTypeName(eqType type) {
 	return tmp;
 }
 
+void CppEQ::processRamp(std::vector<double> &data) {
+	double ratio;
+	uint32_t len;
+
+	// one redesign per sub-block, gain glides in dB, frequency and Q in log scale
+	for (uint32_t start = 0; start < data.size(); start += EQ_RAMP_LEN) {
+		len = std::min((uint32_t) data.size()-start, (uint32_t) EQ_RAMP_LEN);
+		if (rampPending) {
+			curGain += rampCoeff*(gain-curGain);
+			curFreq *= exp(rampCoeff*log(freq/curFreq));
+			curQ *= exp(rampCoeff*log(Q/curQ));
+			ratio = fabs(log(freq/curFreq)) + fabs(log(Q/curQ));
+			if (fabs(gain-curGain) < 0.01 && ratio < 1e-3) {
+				designBiquad();
+			} else if (topology == STATE_VARIABLE) {
+				designSvf(curGain, curFreq, curQ);
+			} else {
+				designBiquad(curGain, curFreq, curQ, coeffs.data());
+			}
+		}
+		if (topology == STATE_VARIABLE) {
+			processSvf(svfCoeffs, states.data(), &data[start], len);
+		} else {
+			processTdf2(coeffs.data(), states.data(), &data[start], len);
+		}
+	}
+}
+
 void CppEQ::process(std::vector<double> &data) {
-	  double tmp;
-	  for (unsigned int i = 0; i < data.size(); i++) {
-	        tmp = data[i]-states[0]*coeffs[3]-states[1]*coeffs[4];
-	        data[i] = tmp*coeffs[0]+states[0]*coeffs[1]+states[1]*coeffs[2];
-	        states[1] = states[0];
-	        states[0] = tmp;
+	  if (rampPending) {
+		  processRamp(data);
+	  } else if (topology == STATE_VARIABLE) {
+		  processSvf(svfCoeffs, states.data(), data.data(), (uint32_t) data.size());
+	  } else {
+		  processTdf2(coeffs.data(), states.data(), data.data(), (uint32_t) data.size());
 	  }
 }
 
 int CppEQ::addTransferFunction(std::vector<double> &tf, uint32_t nfft) {
-    if (ilog2(nfft) == 0){
+	CppFFT plan;
+    if (nfft < 4) {
         return -1;
+    } else if (ilog2(nfft) == 0) {
+    	plan.setSize(nfft);
     }
 
 	std::vector<double> bVec(nfft+2, 0.0), aVec(nfft+2, 0.0);
     double *bp = bVec.data(), *ap = aVec.data();
     complex_float64 *bFreq = (complex_float64*) bp, *aFreq = (complex_float64*) ap;
+    double target[NUM_COEFFS_PER_BIQUAD];
+    const double *c = coeffs.data();
+
+    // show where a pending ramp ends, not where it currently is
+    if (rampPending) {
+    	designBiquad(gain, freq, Q, target);
+    	c = target;
+    }
 
-    bp[0] = coeffs[0];
-    bp[1] = coeffs[1];
-    bp[2] = coeffs[2];
+    bp[0] = c[0];
+    bp[1] = c[1];
+    bp[2] = c[2];
     ap[0] = 1.0;
-    ap[1] = coeffs[3];
-    ap[2] = coeffs[4];
+    ap[1] = c[3];
+    ap[2] = c[4];
 
-    fft_double(bp, bFreq, nfft);
-    fft_double(ap, aFreq, nfft);
+    realFFT(plan, bp, nfft);
+    realFFT(plan, ap, nfft);
 
     for (uint32_t i=0; i<nfft/2+1; i++) {
         tf[i]+= 20*log10(complex_abs(complex_div(bFreq[i], aFreq[i])));
@@ -497,6 +1054,24 @@ int CppEQ::addTransferFunction(std::vector<double> &tf, uint32_t nfft) {
 	return 0;
 }
 
+int CppEQ::addTransferFunction(std::vector<float> &tf, uint32_t nfft) {
+	double target[NUM_COEFFS_PER_BIQUAD];
+	const double *c = coeffs.data();
+
+	if (nfft < 4) {
+		return -1;
+	}
+
+	if (rampPending) {
+		designBiquad(gain, freq, Q, target);
+		c = target;
+	}
+
+	addBiquadMagnitude(tf, binSinCosSquared(nfft), c);
+
+	return 0;
+}
+
 CppLimiter::CppLimiter(void)
     : fs(44100.0), thres(0.0), makeup(1.0), aRel(1.0-1.0/88200.0),
       lookaheadSamps(96), holdSamps(480), memCnt(0), holdCnt(576),
@@ -518,15 +1093,37 @@ CppLimiter::~CppLimiter(void) {
 
 }
 
-void CppLimiter::process(std::vector<double> &data)
+template <typename sampleType>
+void CppLimiter::processBlock(const double *in, sampleType *out, uint32_t len, uint32_t stride)
 {
-    double tmp, aRelHold, logAbsSig;
+    double x, aRelHold, logAbsSig, peak = 0.0;
 
-    for (uint32_t i = 0; i < data.size(); i++)
+    // Below the threshold and without gain reduction left the limiter is a plain delay,
+    // the gain computer would produce exactly unity gain for the whole block.
+    if (logAbsSigRel == 0.0 && compGainLog == 0.0) {
+        for (uint32_t i = 0; i < len; i++) {
+            peak = fmax(peak, fabs(in[i]));
+        }
+        if (20*log10(peak*makeup)-thres <= 0.0) {
+            for (uint32_t i = 0; i < len; i++) {
+                x = in[i]*makeup;
+                out[i*stride] = (sampleType) mem[memCnt];
+                mem[memCnt] = x;
+                memCnt++;
+                if (memCnt >= lookaheadSamps) {
+                    memCnt = 0;
+                }
+            }
+            holdCnt = holdSamps+lookaheadSamps;
+            return;
+        }
+    }
+
+    for (uint32_t i = 0; i < len; i++)
     {
-        data[i] *= makeup;
+        x = in[i]*makeup;
 
-        logAbsSig = fmax(0., 20*log10(fabs(data[i]))-thres);
+        logAbsSig = fmax(0., 20*log10(fabs(x))-thres);
 
         if (holdCnt > 0) {
             aRelHold = 1;
@@ -544,9 +1141,8 @@ void CppLimiter::process(std::vector<double> &data)
 
         compGainLog = fmin(logAbsSigRel, compGainLog+logAbsSigRel/lookaheadSamps);
 
-        tmp = data[i];
-        data[i] = mem[memCnt]*pow(10, -compGainLog*0.05);
-        mem[memCnt] = tmp;
+        out[i*stride] = (sampleType) (mem[memCnt]*pow(10, -compGainLog*0.05));
+        mem[memCnt] = x;
 
         memCnt++;
 
@@ -554,4 +1150,163 @@ void CppLimiter::process(std::vector<double> &data)
             memCnt = 0;
         }
     }
+
+    // the release recursion decays geometrically in silence, end it before it turns denormal
+    if (logAbsSigRel < LIMITER_STATE_FLOOR) {
+        logAbsSigRel = 0.0;
+    }
+    if (compGainLog < LIMITER_STATE_FLOOR) {
+        compGainLog = 0.0;
+    }
+}
+
+void CppLimiter::process(std::vector<double> &data)
+{
+    processBlock(data.data(), data.data(), (uint32_t) data.size(), 1);
+}
+
+void CppLimiter::process(const std::vector<double> &data, float *out, uint32_t stride)
+{
+    processBlock(data.data(), out, (uint32_t) data.size(), stride);
+}
+
+CppFusedCascade::CppFusedCascade(void)
+    : numSOS(0), numStages(0) {
+
+}
+
+bool CppFusedCascade::append(const CppEQ &eq) {
+	if (eq.topology != DIRECT_FORM || eq.rampPending || numSOS+1 > FUSED_MAX_SOS) {
+		return false;
+	}
+	for (uint32_t j = 0; j < NUM_COEFFS_PER_BIQUAD; j++) {
+		coeffs[numSOS][j] = eq.coeffs[j];
+	}
+	states[numSOS][0] = eq.states[0];
+	states[numSOS][1] = eq.states[1];
+	stageFirst[numStages] = numSOS;
+	stageLen[numStages] = 1;
+	numStages++;
+	numSOS++;
+	return true;
+}
+
+bool CppFusedCascade::append(const CppXover &cut) {
+	uint32_t len = (uint32_t) cut.coeffs.size();
+
+	if (cut.topology != DIRECT_FORM || cut.fadeCnt > 0 || numSOS+len > FUSED_MAX_SOS) {
+		return false;
+	}
+	for (uint32_t i = 0; i < len; i++) {
+		for (uint32_t j = 0; j < NUM_COEFFS_PER_BIQUAD; j++) {
+			coeffs[numSOS+i][j] = cut.coeffs[i][j];
+		}
+		states[numSOS+i][0] = cut.states[i][0];
+		states[numSOS+i][1] = cut.states[i][1];
+	}
+	stageFirst[numStages] = numSOS;
+	stageLen[numStages] = len;
+	numStages++;
+	numSOS += len;
+	return true;
+}
+
+void CppFusedCascade::scatter(uint32_t stage, CppEQ &eq) const {
+	if (stage >= numStages || stageLen[stage] != 1) {
+		return;
+	}
+	eq.states[0] = states[stageFirst[stage]][0];
+	eq.states[1] = states[stageFirst[stage]][1];
+}
+
+void CppFusedCascade::scatter(uint32_t stage, CppXover &cut) const {
+	if (stage >= numStages) {
+		return;
+	}
+	const double (*s)[NUM_STATES_PER_BIQUAD] = &states[stageFirst[stage]];
+
+	// a redesign while fused snapshotted the stale stage states for its crossfade
+	if (cut.fadeCnt > 0 && stageLen[stage] == cut.fadeStates.size()) {
+		for (uint32_t i = 0; i < stageLen[stage]; i++) {
+			cut.fadeStates[i][0] = s[i][0];
+			cut.fadeStates[i][1] = s[i][1];
+		}
+	}
+	if (stageLen[stage] == cut.states.size()) {
+		for (uint32_t i = 0; i < stageLen[stage]; i++) {
+			cut.states[i][0] = s[i][0];
+			cut.states[i][1] = s[i][1];
+		}
+	}
+}
+
+// sample by sample through all sections, the states of short cascades stay in registers
+template <uint32_t N>
+static void processFused(const double (&c)[FUSED_MAX_SOS][NUM_COEFFS_PER_BIQUAD],
+		double (&s)[FUSED_MAX_SOS][NUM_STATES_PER_BIQUAD], double *data, uint32_t len) {
+	double cl[N][NUM_COEFFS_PER_BIQUAD], sl[N][NUM_STATES_PER_BIQUAD], x;
+
+	for (uint32_t i = 0; i < N; i++) {
+		for (uint32_t j = 0; j < NUM_COEFFS_PER_BIQUAD; j++) {
+			cl[i][j] = c[i][j];
+		}
+		sl[i][0] = s[i][0];
+		sl[i][1] = s[i][1];
+	}
+
+	for (uint32_t j = 0; j < len; j++) {
+		x = data[j];
+		xoverSection<0, N, 0>::run(cl, sl, x);
+		data[j] = x;
+	}
+
+	for (uint32_t i = 0; i < N; i++) {
+		s[i][0] = sl[i][0];
+		s[i][1] = sl[i][1];
+	}
+}
+
+void CppFusedCascade::process(std::vector<double> &data) {
+	uint32_t len = (uint32_t) data.size();
+	double *d = data.data(), x, y;
+
+#if defined(DSP_ANTI_DENORMAL)
+	// without flush-to-zero every section gets the offset again, a highpass section
+	// removes it and the sections behind would decay into the denormal range
+	for (uint32_t j = 0; j < len; j++) {
+		x = d[j];
+		for (uint32_t i = 0; i < numSOS; i++) {
+			y = coeffs[i][0]*x + states[i][0];
+			states[i][0] = coeffs[i][1]*x - coeffs[i][3]*y + states[i][1];
+			states[i][1] = coeffs[i][2]*x - coeffs[i][4]*y;
+			x = y + DSP_DENORMAL_OFFSET;
+		}
+		d[j] = x;
+	}
+	return;
+#endif
+
+	switch (numSOS) {
+	case 0: return;
+	case 1: processFused<1>(coeffs, states, d, len); return;
+	case 2: processFused<2>(coeffs, states, d, len); return;
+	case 3: processFused<3>(coeffs, states, d, len); return;
+	case 4: processFused<4>(coeffs, states, d, len); return;
+	case 5: processFused<5>(coeffs, states, d, len); return;
+	case 6: processFused<6>(coeffs, states, d, len); return;
+	case 7: processFused<7>(coeffs, states, d, len); return;
+	case 8: processFused<8>(coeffs, states, d, len); return;
+	default: break;
+	}
+
+	for (uint32_t j = 0; j < len; j++) {
+		x = d[j];
+		for (uint32_t i = 0; i < numSOS; i++) {
+			y = coeffs[i][0]*x + states[i][0];
+			states[i][0] = coeffs[i][1]*x - coeffs[i][3]*y + states[i][1];
+			states[i][1] = coeffs[i][2]*x - coeffs[i][4]*y;
+			x = y;
+		}
+		d[j] = x;
+	}
 }
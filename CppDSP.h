@@ -5,6 +5,11 @@ is performed via matched z-transform / analogue design with bilinear
 transformation of poles/zeros. Cutoffs are calculated in second order
 sections.
 
+Every stage runs either as transposed direct form II biquad or as trapezoidal
+(topology preserving) state variable filter. The SVF realises the same
+transfer function but keeps its states well conditioned at low
+frequencies / high sample rates and tolerates fast retuning.
+
 public domain 
 
 Version 0.1.0 (debugged and tested, 05.07.2019).
@@ -15,11 +20,16 @@ Version 0.1.0 (debugged and tested, 05.07.2019).
 
 #define NUM_COEFFS_PER_BIQUAD 5
 #define NUM_STATES_PER_BIQUAD 2
+#define NUM_COEFFS_PER_SVF 6
+#define EQ_RAMP_LEN 32
+#define LIMITER_STATE_FLOOR 1e-12 // dB
+#define FUSED_MAX_SOS 64
 
 #include <vector>
 #include <string>
 #include <cmath>
 #include <cstdint>
+#include <algorithm>
 
 typedef enum {
 	FLAT_THRU = 0x0,
@@ -36,6 +46,12 @@ typedef enum {
 	UNKNOWN_FILTERTYPE
 } filterType;
 
+typedef enum {
+	DIRECT_FORM = 0x30,
+	STATE_VARIABLE,
+	UNKNOWN_TOPOLOGY
+} filterTopology;
+
 typedef enum {
     LOWPASSEQ = 0x20,
     HIGHPASSEQ,
@@ -48,18 +64,34 @@ typedef enum {
 	UNKNOWN_EQTYPE
 } eqType;
 
+class CppFusedCascade;
+
 class CppXover {
+    friend class CppFusedCascade;
 
 public:
+    // Direct form kernel running a whole cascade over one block.
+    typedef void (*cascadeKernel)(const std::vector< std::vector<double> > &coeffs,
+    		std::vector< std::vector<double> > &states, double *data, uint32_t len);
+
     CppXover(void);
 
     CppXover(double sampleRate, double freq, filterChar charac, filterType type, uint32_t order);
 
+    CppXover(const CppXover &other) = default;
+
+    CppXover(CppXover &&other) = default;
+
+    CppXover &operator=(const CppXover &other) = default;
+
+    CppXover &operator=(CppXover &&other) = default;
+
     ~CppXover(void);
 
     inline int setSampleRate(double fs) {
     	int error;
     	this->fs = fs;
+    	fadeLen = std::max(1u, (uint32_t) (secFade*fs));
         error = designFilter();
         if (error <0) {
         	for (uint32_t i=0; i<((uint32_t)coeffs.size()); i++) {
@@ -102,8 +134,10 @@ public:
     inline int setChar(filterChar charac, double ripple = 1.0, double attenuation = 40.0) {
     	int error = 0;
     	this->charac = charac;
+    	this->ripple = ripple;
+    	this->attenuation = attenuation;
 
-		error = designFilter(ripple, attenuation);
+		error = designFilter();
 		if (error <0) {
 			for (uint32_t i=0; i<((uint32_t)coeffs.size()); i++) {
 				setCoeffsOfSOS(i,1.,0.,0.,0.,0.);
@@ -117,7 +151,30 @@ public:
     	int error;
     	this->type = type;
 
-        error = designFilter(this->ord);
+        error = designFilter();
+        if (error <0) {
+        	for (uint32_t i=0; i<((uint32_t)coeffs.size()); i++) {
+        		setCoeffsOfSOS(i,1.,0.,0.,0.,0.);
+        	}
+        	return -1;
+		}
+		return 0;
+    }
+
+    // Sets all design parameters at once and designs the filter a single time.
+    inline int setParams(double sampleRate, double freq, filterChar charac, filterType type, uint32_t ord,
+    		double ripple = 1.0, double attenuation = 40.0) {
+    	int error;
+    	this->fs = sampleRate;
+    	this->freq = freq;
+    	this->charac = charac;
+    	this->type = type;
+    	this->ord = ord;
+    	this->nSOS = (ord+1)/2;
+    	this->ripple = ripple;
+    	this->attenuation = attenuation;
+
+        error = designFilter();
         if (error <0) {
         	for (uint32_t i=0; i<((uint32_t)coeffs.size()); i++) {
         		setCoeffsOfSOS(i,1.,0.,0.,0.,0.);
@@ -127,10 +184,93 @@ public:
 		return 0;
     }
 
+    // Copies the filter states of the sections both filters have in common. Does not
+    // allocate, so a design prepared off-thread can take over a running filter.
+    inline void copyStates(const CppXover &other) {
+    	for (uint32_t i = 0; i < states.size() && i < other.states.size(); i++) {
+    		for (uint32_t j = 0; j < NUM_STATES_PER_BIQUAD; j++) {
+    			states[i][j] = other.states[i][j];
+    		}
+    	}
+    }
+
+    // With smoothing on, every redesign crossfades from the old to the new coefficient
+    // set over secFade seconds. Both cascades only run while a crossfade is pending.
+    inline void setSmoothing(bool smoothing, double secFade = 0.01) {
+    	this->smoothing = smoothing;
+    	this->secFade = secFade;
+    	fadeLen = std::max(1u, (uint32_t) (secFade*fs));
+    	if (!smoothing) {
+    		fadeCnt = 0;
+    	}
+    }
+
+    bool getSmoothing() const { return smoothing; }
+
+    // Sizes the buffers takeOver() fills, off-thread and without touching the states
+    // the audio thread writes.
+    inline void prepareTakeOver(const CppXover &old) {
+    	fadeCoeffs = (topology == STATE_VARIABLE) ? old.svfCoeffs : old.coeffs;
+    	fadeStates.resize(old.states.size());
+    	for (uint32_t i = 0; i < fadeStates.size(); i++) {
+    		fadeStates[i].resize(old.states[i].size());
+    	}
+    }
+
+    // Copies states and smoothing mode of the running filter old and starts a crossfade
+    // from its response. Does not allocate after prepareTakeOver(), so it can run on the
+    // audio thread. Both need the same topology.
+    inline void takeOver(const CppXover &old) {
+    	fadeCnt = 0;
+    	if (topology != old.topology) {
+    		return;
+    	}
+    	copyStates(old);
+    	smoothing = old.smoothing;
+    	secFade = old.secFade;
+    	fadeLen = old.fadeLen;
+    	if (smoothing) {
+    		fadeCoeffs = (topology == STATE_VARIABLE) ? old.svfCoeffs : old.coeffs;
+    		fadeStates = old.states;
+    		fadeCnt = fadeLen;
+    	}
+    }
+
+    // Switching the topology resets the filter states.
+    inline int setTopology(filterTopology topology) {
+    	if (topology != DIRECT_FORM && topology != STATE_VARIABLE) {
+    		return -1;
+    	}
+    	this->topology = topology;
+    	fadeCnt = 0;
+    	reset();
+    	updateSvf();
+    	return 0;
+    }
+
+    filterTopology getTopology() const { return this->topology; }
+
+    // Optional section pipelined direct form kernel for long cascades, see processPipelined().
+    inline void setPipelined(bool pipelined) {
+    	this->pipelined = pipelined;
+    }
+
+    bool getPipelined() const { return this->pipelined; }
+
+    bool isFading() const { return fadeCnt > 0; }
+
+    // A flat cutoff without pending crossfade leaves the signal untouched.
+    bool isIdentity() const { return coeffs.empty() && fadeCnt == 0; }
+
+    const std::vector< std::vector<double> > &getCoeffs() const { return this->coeffs; }
+
     uint32_t getOrd() const { return this->ord; }
     double getFreq() const { return this->freq; }
     filterType getType() const { return this->type; }
     filterChar getChar() const { return this->charac; }
+    double getSampleRate() const { return this->fs; }
+    double getRipple() const { return this->ripple; }
+    double getAttenuation() const { return this->attenuation; }
 
     static std::string getTypeName(filterType type);
     static std::string getCharName(filterChar charac);
@@ -139,8 +279,26 @@ public:
 
     int addTransferFunction(std::vector<double> &tf, uint32_t nfft);
 
+    // Single precision closed form evaluation (no FFT), vectorisable. Stays within
+    // 0.001 dB of the double precision version wherever the response is above -140 dB,
+    // notch floors included (checked by CppDSPbench tf).
+    int addTransferFunction(std::vector<float> &tf, uint32_t nfft);
+
 protected:
-    int designFilter(double ripple = 1.0, double attenuation = 40.0);
+    // Looks the design up in a cache shared by all instances, designs it on a miss.
+    int designFilter();
+
+    void processCrossfade(std::vector<double> &data);
+
+    void processPipelined(std::vector<double> &data);
+
+    void updateSvf();
+
+    // Selects the unrolled cascade matching the sections and their orders, if there is one.
+    void updateKernel();
+
+    // Maps a bilinear biquad [b0,b1,b2,a1,a2] to TPT SVF coefficients [a1,a2,a3,m0,m1,m2].
+    static void biquadToSvf(const double *biquad, double *svf);
 
     inline void reset() {
     	for (uint32_t i = 0 ; i < states.size(); i++) {
@@ -159,21 +317,32 @@ protected:
 			coeffs[sosID][2] = b2;
 			coeffs[sosID][3] = a1;
 			coeffs[sosID][4] = a2;
+			if (topology == STATE_VARIABLE && (size_t) sosID < svfCoeffs.size()) {
+				biquadToSvf(coeffs[sosID].data(), svfCoeffs[sosID].data());
+			}
+			updateKernel();
     	}
     	return 0;
     }
 
 private:
+    int computeDesign();
+
     std::vector< std::vector<double> > states;
-    std::vector< std::vector<double> > coeffs;
-    double freq, fs;
-    uint32_t ord, nSOS;
+    std::vector< std::vector<double> > coeffs, svfCoeffs;
+    std::vector< std::vector<double> > fadeStates, fadeCoeffs;
+    double freq, fs, ripple, attenuation, secFade;
+    uint32_t ord, nSOS, fadeLen, fadeCnt;
     filterChar charac;
     filterType type ;
+    filterTopology topology;
+    bool smoothing, pipelined;
+    cascadeKernel kernel;
 
 };
 
 class CppEQ {
+    friend class CppFusedCascade;
 
 public:
     CppEQ(void);
@@ -185,6 +354,7 @@ public:
     inline int setSampleRate(double fs) {
     	int error;
     	this->fs = fs;
+    	setSmoothing(smoothing, secRamp);
         error = designBiquad();
         if (error <0) {
             setCoeffs(1.,0.,0.,0.,0.);
@@ -196,6 +366,9 @@ public:
     inline int setGain(double gain) {
     	int error;
         this->gain = gain;
+        if (startRamp()) {
+        	return 0;
+        }
         error = designBiquad();
         if (error <0) {
             setCoeffs(1.,0.,0.,0.,0.);
@@ -207,6 +380,9 @@ public:
     inline int setFreq(double freq) {
     	int error;
         this->freq = freq;
+        if (startRamp()) {
+        	return 0;
+        }
         error = designBiquad();
         if (error <0) {
             setCoeffs(1.,0.,0.,0.,0.);
@@ -218,6 +394,9 @@ public:
     inline int setQFactor(double Q) {
     	int error;
         this->Q = Q;
+        if (startRamp()) {
+        	return 0;
+        }
         error = designBiquad();
         if (error <0) {
             setCoeffs(1.,0.,0.,0.,0.);
@@ -237,19 +416,129 @@ public:
 		return 0;
     }
 
+    // Sets all design parameters at once and designs the biquad a single time.
+    inline int setParams(double sampleRate, double gain, double freq, double Q, eqType type) {
+    	int error;
+    	this->fs = sampleRate;
+        this->gain = gain;
+        this->freq = freq;
+        this->Q = Q;
+        this->type = type;
+        error = designBiquad();
+        if (error <0) {
+            setCoeffs(1.,0.,0.,0.,0.);
+        	return -1;
+		}
+		return 0;
+    }
+
+    inline void copyStates(const CppEQ &other) {
+        for (int32_t i = 0 ; i < NUM_STATES_PER_BIQUAD ; i++) {
+            states[i] = other.states[i];
+        }
+    }
+
+    // With smoothing on, gain, frequency and Q glide to new values with a time constant
+    // of secRamp seconds, the biquad is redesigned every EQ_RAMP_LEN samples. Only
+    // runs while a ramp is pending. Type changes always take effect immediately.
+    inline void setSmoothing(bool smoothing, double secRamp = 0.02) {
+    	this->smoothing = smoothing;
+    	this->secRamp = secRamp;
+    	rampCoeff = 1.0-exp(-EQ_RAMP_LEN/(secRamp*fs));
+    	if (!smoothing && rampPending) {
+    		designBiquad();
+    	}
+    }
+
+    bool getSmoothing() const { return smoothing; }
+
+    // Switching the topology resets the filter states.
+    inline int setTopology(filterTopology topology) {
+    	if (topology != DIRECT_FORM && topology != STATE_VARIABLE) {
+    		return -1;
+    	}
+    	this->topology = topology;
+    	reset();
+    	designSvf(curGain, curFreq, curQ);
+    	return 0;
+    }
+
+    filterTopology getTopology() const { return this->topology; }
+
+    const std::vector<double> &getCoeffs() const { return this->coeffs; }
+
+    // Copies states, smoothing mode and current (smoothed) parameters of the running
+    // filter old, so this one glides from there to its own parameters. Does not allocate.
+    // Both need the same topology.
+    inline void takeOver(const CppEQ &old) {
+    	if (topology != old.topology) {
+    		return;
+    	}
+    	copyStates(old);
+    	smoothing = old.smoothing;
+    	secRamp = old.secRamp;
+    	rampCoeff = old.rampCoeff;
+    	if (smoothing && type == old.type) {
+    		curGain = old.curGain;
+    		curFreq = old.curFreq;
+    		curQ = old.curQ;
+    		startRamp();
+    	}
+    }
+
     double getGain() const { return this->gain; }
     double getFreq() const { return this->freq; }
     double getQFact() const { return this->Q; }
     eqType getType() const { return this->type; }
 
+    bool isRamping() const { return rampPending; }
+
+    bool isBypassed() const { return bypassed; }
+
+    // Peak and shelving EQs at 0 dB cancel their poles and zeros, such a stage can be skipped.
+    // Returns true if it is skipped from now on, a stage coming back starts from zero states.
+    inline bool updateBypass() {
+    	bool identity = !rampPending && gain == 0.0 && (type == PEAKEQ || type == LOWSHELV || type == HIGHSHELV);
+    	if (bypassed && !identity) {
+    		reset();
+    	}
+    	bypassed = identity;
+    	return bypassed;
+    }
+
     static std::string getTypeName(eqType type);
 
     void process(std::vector<double> &data);
 
     int addTransferFunction(std::vector<double> &tf, uint32_t nfft);
 
+    int addTransferFunction(std::vector<float> &tf, uint32_t nfft);
+
 protected:
-    int designBiquad();
+    inline int designBiquad() {
+    	curGain = gain;
+    	curFreq = freq;
+    	curQ = Q;
+    	rampPending = false;
+    	designSvf(gain, freq, Q);
+    	return designBiquad(gain, freq, Q, coeffs.data());
+    }
+
+    int designBiquad(double gain, double freq, double Q, double *coeffs);
+
+    // SVF coefficients straight from the parameters, one tan() per retune
+    void designSvf(double gain, double freq, double Q);
+
+    // true if the change is left to the ramp in process()
+    inline bool startRamp() {
+    	if (smoothing && freq > 0 && freq < fs/2 && Q > 0 && type >= LOWPASSEQ && type < UNKNOWN_EQTYPE) {
+    		rampPending = true;
+    		return true;
+    	}
+    	return false;
+    }
+
+    void processRamp(std::vector<double> &data);
 
     inline void reset() {
         for (int32_t i = 0 ; i < NUM_STATES_PER_BIQUAD ; i++) {
@@ -269,8 +558,12 @@ protected:
 private:
     std::vector<double> states;
     std::vector<double> coeffs;
+    double svfCoeffs[NUM_COEFFS_PER_SVF];
     double gain, freq, fs, Q;
+    double curGain, curFreq, curQ, secRamp, rampCoeff;
     eqType type;
+    filterTopology topology;
+    bool smoothing, rampPending, bypassed;
 };
 
 class CppLimiter {
@@ -327,14 +620,77 @@ public:
     double getThres() const { return thres; }
     double getMakeup() const { return 20.0*log10(makeup); }
     double getReleaseTime() const { return 1.0/((1.0-aRel)*fs); }
+    // current gain reduction in dB, 0 below the threshold
+    double getGainReduction() const { return compGainLog; }
+
+    // Copies the look-ahead delay line and the gain computer states, both limiters
+    // need the same sample rate.
+    inline void copyStates(const CppLimiter &other) {
+    	if (mem.size() != other.mem.size()) {
+    		return;
+    	}
+    	std::copy(other.mem.begin(), other.mem.end(), mem.begin());
+    	memCnt = other.memCnt;
+    	holdCnt = other.holdCnt;
+    	logAbsSigRel = other.logAbsSigRel;
+    	logAbsSigSmooth = other.logAbsSigSmooth;
+    	compGainLog = other.compGainLog;
+    }
 
     void process(std::vector<double> &data);
 
+    // Limits data and writes the result as float to out, every stride-th element
+    // (one channel of an interleaved buffer). data keeps the unlimited signal.
+    void process(const std::vector<double> &data, float *out, uint32_t stride);
+
 private:
+    template <typename sampleType>
+    void processBlock(const double *in, sampleType *out, uint32_t len, uint32_t stride);
+
     std::vector<double> mem;
     double fs, thres, makeup, aRel, logAbsSigRel, logAbsSigSmooth, compGainLog;
 	uint32_t lookaheadSamps, holdSamps, memCnt;
 	int32_t holdCnt;
 };
 
+/*
+ * Direct form sections of several EQ and cutoff stages merged into one cascade, which
+ * runs all of them in a single pass over the block. The stages keep their coefficients,
+ * append() copies coefficients and states in, scatter() hands the states back before
+ * the stages are changed or run on their own again.
+ */
+class CppFusedCascade {
+
+public:
+    CppFusedCascade(void);
+
+    inline void clear() {
+    	numSOS = 0;
+    	numStages = 0;
+    }
+
+    // Appends all sections of a direct form stage, false (and nothing appended) if
+    // the stage runs as SVF, is still gliding to new parameters or does not fit.
+    bool append(const CppEQ &eq);
+
+    bool append(const CppXover &cut);
+
+    // Writes the states of the stage-th appended stage back. A stage whose number of
+    // sections changed meanwhile keeps its own states.
+    void scatter(uint32_t stage, CppEQ &eq) const;
+
+    void scatter(uint32_t stage, CppXover &cut) const;
+
+    uint32_t getNumStages() const { return numStages; }
+    uint32_t getNumSOS() const { return numSOS; }
+
+    void process(std::vector<double> &data);
+
+private:
+    double coeffs[FUSED_MAX_SOS][NUM_COEFFS_PER_BIQUAD];
+    double states[FUSED_MAX_SOS][NUM_STATES_PER_BIQUAD];
+    uint32_t stageFirst[FUSED_MAX_SOS], stageLen[FUSED_MAX_SOS];
+    uint32_t numSOS, numStages;
+};
+
 #endif // end of include guard
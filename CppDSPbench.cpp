@@ -0,0 +1,386 @@
+/*------------------------------------------------------------------*\
+Benchmark of the direct form and state variable (TPT) filter kernels of
+CppEQ and CppXover. Reports the processing time per sample and the
+error of both kernels against a long double direct form reference
+running the same designed coefficients, for a set of designs at 48 kHz
+and 192 kHz including low corner frequencies. Cutoffs additionally run
+the section pipelined direct form kernel (bit identical to direct form,
+only its time is reported), including long cascades.
+
+The last test feeds an EQ / cutoff / limiter chain in the order of
+CppRTA (peak, shelf, highpass, lowpass, limiter) with silence after a
+loud burst: as is, with flush-to-zero (CppScopedFtz), with the DC offset
+added once in front of the chain and with the offset added again behind
+every stage, as the fallback of CppRTA does. It reports the cost per
+sample, the slowest block and the denormal samples the stages put out
+during the last seconds of silence, when the states of the low
+frequency sections have decayed. The highpass removes an offset added
+only in front, so the lowpass behind it still decays into denormals.
+
+A check of the single precision transfer functions (addTransferFunction
+with float) runs first: every EQ type and cutoff design, including deep
+notches and low corner frequencies at 96 kHz, against a long double
+evaluation of the designed coefficients. It reports the largest error
+in dB over the bins where the response lies above TF_CHECK_FLOOR_DB,
+for the double precision version as well, and the program exits with
+1 if the float error exceeds TF_CHECK_BOUND_DB, the bound CppDSP.h
+documents.
+
+Usage: CppDSPbench [number of seconds per design | tf (check only)]
+\*------------------------------------------------------------------*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstring>
+#include "CppDSP.h"
+#include "CppDenormal.h"
+
+#define BENCH_BLOCK_LEN 256
+// documented accuracy of the float transfer functions, above the floor
+#define TF_CHECK_BOUND_DB 0.001
+#define TF_CHECK_FLOOR_DB -140.0
+
+struct benchResult {
+	double nsPerSample, snr;
+};
+
+static std::vector<double> makeSignal(uint32_t len, double fs) {
+	std::vector<double> sig(len);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<double> dist(-0.5, 0.5);
+
+	// white noise plus a low frequency tone, the hard case for direct form
+	for (uint32_t i=0; i<len; i++) {
+		sig[i] = dist(rng) + 0.4*sin(2.0*M_PI*25.0*i/fs);
+	}
+	return sig;
+}
+
+static void referenceCascade(const std::vector< std::vector<double> > &coeffs, const std::vector<double> &in,
+		std::vector<long double> &out) {
+	std::vector<long double> states(2*coeffs.size(), 0.0L);
+	long double y, x;
+
+	out.resize(in.size());
+	for (uint32_t j=0; j<in.size(); j++) {
+		x = in[j];
+		for (uint32_t i=0; i<coeffs.size(); i++) {
+			y = coeffs[i][0]*x + states[2*i];
+			states[2*i] = coeffs[i][1]*x - coeffs[i][3]*y + states[2*i+1];
+			states[2*i+1] = coeffs[i][2]*x - coeffs[i][4]*y;
+			x = y;
+		}
+		out[j] = x;
+	}
+}
+
+template <typename filterClass>
+static benchResult runKernel(filterClass &filt, const std::vector<double> &sig, const std::vector<long double> &ref) {
+	std::vector<double> block(BENCH_BLOCK_LEN), out(sig.size());
+	long double errPow = 0.0L, refPow = 0.0L, diff;
+	benchResult result;
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t pos=0; pos+BENCH_BLOCK_LEN<=sig.size(); pos+=BENCH_BLOCK_LEN) {
+		std::copy(sig.begin()+pos, sig.begin()+pos+BENCH_BLOCK_LEN, block.begin());
+		filt.process(block);
+		std::copy(block.begin(), block.end(), out.begin()+pos);
+	}
+	auto stop = std::chrono::steady_clock::now();
+
+	for (uint32_t i=0; i<(sig.size()/BENCH_BLOCK_LEN)*BENCH_BLOCK_LEN; i++) {
+		diff = out[i] - ref[i];
+		errPow += diff*diff;
+		refPow += ref[i]*ref[i];
+	}
+
+	result.nsPerSample = std::chrono::duration<double, std::nano>(stop-start).count()/sig.size();
+	result.snr = 10.0*log10((double) (refPow/std::max(errPow, 1e-300L)));
+	return result;
+}
+
+static void printResult(const char *name, double fs, const benchResult &df, const benchResult &svf,
+		const benchResult *pipe = nullptr) {
+	printf("%-36s %7.0f | %8.2f %8.1f | %8.2f %8.1f", name, fs, df.nsPerSample, df.snr, svf.nsPerSample, svf.snr);
+	if (pipe != nullptr) {
+		printf(" | %8.2f", pipe->nsPerSample);
+	}
+	printf("\n");
+}
+
+static void benchXover(const char *name, double fs, double freq, filterChar charac, filterType type,
+		uint32_t ord, uint32_t len) {
+	CppXover df(fs, freq, charac, type, ord), svf(fs, freq, charac, type, ord), pipe(fs, freq, charac, type, ord);
+	std::vector<double> sig = makeSignal(len, fs);
+	std::vector<long double> ref;
+
+	svf.setTopology(STATE_VARIABLE);
+	pipe.setPipelined(true);
+	referenceCascade(df.getCoeffs(), sig, ref);
+	benchResult dfResult = runKernel(df, sig, ref);
+	benchResult svfResult = runKernel(svf, sig, ref);
+	benchResult pipeResult = runKernel(pipe, sig, ref);
+	printResult(name, fs, dfResult, svfResult, &pipeResult);
+}
+
+static void benchEQ(const char *name, double fs, double gain, double freq, double Q, eqType type, uint32_t len) {
+	CppEQ df(fs, gain, freq, Q, type), svf(fs, gain, freq, Q, type);
+	std::vector<double> sig = makeSignal(len, fs);
+	std::vector< std::vector<double> > coeffs(1, df.getCoeffs());
+	std::vector<long double> ref;
+
+	svf.setTopology(STATE_VARIABLE);
+	referenceCascade(coeffs, sig, ref);
+	benchResult dfResult = runKernel(df, sig, ref);
+	benchResult svfResult = runKernel(svf, sig, ref);
+	printResult(name, fs, dfResult, svfResult);
+}
+
+struct tfResult {
+	double floatErr, doubleErr;
+};
+
+// |H| in dB of a cascade, evaluated in long double straight from the coefficients
+static void referenceTransferFunction(const std::vector< std::vector<double> > &coeffs, uint32_t nfft,
+		std::vector<long double> &tf) {
+	long double w, c1, s1, c2, s2, bRe, bIm, aRe, aIm;
+
+	tf.assign(nfft/2+1, 0.0L);
+	for (uint32_t k=0; k<nfft/2+1; k++) {
+		w = 2.0L*3.14159265358979323846264338327950288L*k/nfft;
+		c1 = cosl(w);
+		s1 = sinl(w);
+		c2 = cosl(2.0L*w);
+		s2 = sinl(2.0L*w);
+		for (uint32_t i=0; i<coeffs.size(); i++) {
+			bRe = coeffs[i][0] + coeffs[i][1]*c1 + coeffs[i][2]*c2;
+			bIm = -coeffs[i][1]*s1 - coeffs[i][2]*s2;
+			aRe = 1.0L + coeffs[i][3]*c1 + coeffs[i][4]*c2;
+			aIm = -coeffs[i][3]*s1 - coeffs[i][4]*s2;
+			tf[k] += 10.0L*log10l((bRe*bRe+bIm*bIm)/(aRe*aRe+aIm*aIm));
+		}
+	}
+}
+
+template <typename filterClass>
+static tfResult checkTransferFunction(filterClass &filt, const std::vector< std::vector<double> > &coeffs,
+		uint32_t nfft) {
+	std::vector<float> tfFloat(nfft/2+1, 0.0f);
+	std::vector<double> tfDouble(nfft/2+1, 0.0);
+	std::vector<long double> ref;
+	tfResult result = {0.0, 0.0};
+
+	filt.addTransferFunction(tfFloat, nfft);
+	filt.addTransferFunction(tfDouble, nfft);
+	referenceTransferFunction(coeffs, nfft, ref);
+	for (uint32_t k=0; k<nfft/2+1; k++) {
+		if (ref[k] < TF_CHECK_FLOOR_DB) {
+			continue;
+		}
+		result.floatErr = std::max(result.floatErr, (double) fabsl(tfFloat[k]-ref[k]));
+		result.doubleErr = std::max(result.doubleErr, (double) fabsl(tfDouble[k]-ref[k]));
+	}
+	return result;
+}
+
+static bool printTfResult(const char *name, double fs, uint32_t nfft, const tfResult &result) {
+	bool pass = result.floatErr <= TF_CHECK_BOUND_DB;
+
+	printf("%-36s %7.0f %6u | %10.2e %10.2e %s\n", name, fs, nfft, result.floatErr, result.doubleErr,
+			pass ? "" : "FAIL");
+	return pass;
+}
+
+static bool checkXover(const char *name, double fs, double freq, filterChar charac, filterType type,
+		uint32_t ord) {
+	CppXover filt(fs, freq, charac, type, ord);
+	bool pass = true;
+
+	for (uint32_t nfft=4096; nfft<=65536; nfft*=4) {
+		pass &= printTfResult(name, fs, nfft, checkTransferFunction(filt, filt.getCoeffs(), nfft));
+	}
+	return pass;
+}
+
+static bool checkEQ(const char *name, double fs, double gain, double freq, double Q, eqType type) {
+	CppEQ filt(fs, gain, freq, Q, type);
+	std::vector< std::vector<double> > coeffs(1, filt.getCoeffs());
+	bool pass = true;
+
+	for (uint32_t nfft=4096; nfft<=65536; nfft*=4) {
+		pass &= printTfResult(name, fs, nfft, checkTransferFunction(filt, coeffs, nfft));
+	}
+	return pass;
+}
+
+// true if every float transfer function stays within the documented bound
+static bool checkTransferFunctions() {
+	bool pass = true;
+
+	printf("%-36s %7s %6s | %10s %10s   (max error in dB above %.0f dB)\n", "transfer function", "fs", "nfft",
+			"float", "double", TF_CHECK_FLOOR_DB);
+	pass &= checkEQ("Peak EQ +6 dB 1 kHz Q 1", 48000, 6, 1000, 1, PEAKEQ);
+	pass &= checkEQ("Peak EQ -30 dB 30 Hz Q 10", 96000, -30, 30, 10, PEAKEQ);
+	pass &= checkEQ("Peak EQ +12 dB 20 kHz Q 4", 96000, 12, 20000, 4, PEAKEQ);
+	pass &= checkEQ("Low shelf +6 dB 20 Hz", 96000, 6, 20, 0.71, LOWSHELV);
+	pass &= checkEQ("High shelf -9 dB 12 kHz", 48000, -9, 12000, 0.71, HIGHSHELV);
+	pass &= checkEQ("Lowpass 10 Hz", 96000, 0, 10, 0.71, LOWPASSEQ);
+	pass &= checkEQ("Highpass 10 Hz", 96000, 0, 10, 0.71, HIGHPASSEQ);
+	pass &= checkEQ("Bandpass 40 Hz Q 8", 96000, 0, 40, 8, BANDPASS);
+	pass &= checkEQ("Allpass 100 Hz Q 0.5", 96000, 0, 100, 0.5, ALLPASS);
+	pass &= checkEQ("Notch 50 Hz Q 10", 96000, 0, 50, 10, NOTCH);
+	pass &= checkEQ("Notch 15 Hz Q 30", 96000, 0, 15, 30, NOTCH);
+	pass &= checkEQ("Notch 1 kHz Q 0.5", 48000, 0, 1000, 0.5, NOTCH);
+	pass &= checkEQ("Notch on a bin 14.65 Hz Q 30", 96000, 0, 96000.0*10/65536, 30, NOTCH);
+	pass &= checkXover("Butterworth HP 4th 10 Hz", 96000, 10, BUTTERWORTH, HIGHPASS, 4);
+	pass &= checkXover("Butterworth LP 8th 20 Hz", 96000, 20, BUTTERWORTH, LOWPASS, 8);
+	pass &= checkXover("Linkwitz HP 8th 20 Hz", 96000, 20, LINKWITZ, HIGHPASS, 8);
+	pass &= checkXover("Linkwitz LP 4th 2 kHz", 48000, 2000, LINKWITZ, LOWPASS, 4);
+	pass &= checkXover("Chebyshev I LP 6th 15 Hz", 96000, 15, CHEBYSHEV1, LOWPASS, 6);
+	pass &= checkXover("Chebyshev II HP 5th 30 Hz", 96000, 30, CHEBYSHEV2, HIGHPASS, 5);
+	pass &= checkXover("Chebyshev II LP 8th 10 kHz", 96000, 10000, CHEBYSHEV2, LOWPASS, 8);
+	pass &= checkXover("Butterworth LP 16th 1 kHz", 48000, 1000, BUTTERWORTH, LOWPASS, 16);
+	printf("float transfer functions %s the %.3f dB bound\n\n", pass ? "within" : "EXCEED", TF_CHECK_BOUND_DB);
+	return pass;
+}
+
+typedef enum {
+	SILENCE_PLAIN = 0x0,
+	SILENCE_FTZ,
+	SILENCE_OFFSET_INPUT,
+	SILENCE_OFFSET_STAGES
+} silenceMode;
+
+struct silenceResult {
+	double nsPerSample, maxBlockUs;
+	uint64_t denormals;
+};
+
+static uint64_t countDenormals(const std::vector<double> &block) {
+	uint64_t count = 0;
+
+	for (uint32_t i=0; i<block.size(); i++) {
+		count += (std::fpclassify(block[i]) == FP_SUBNORMAL) ? 1 : 0;
+	}
+	return count;
+}
+
+static void addOffset(std::vector<double> &block) {
+	for (uint32_t i=0; i<block.size(); i++) {
+		block[i] += DSP_DENORMAL_OFFSET;
+	}
+}
+
+// Runs one stage and returns its time in ns, the denormal count is not timed.
+template <typename filterClass>
+static double runStage(filterClass &stage, std::vector<double> &block, silenceMode mode, bool measure,
+		uint64_t &denormals) {
+	auto start = std::chrono::steady_clock::now();
+	stage.process(block);
+	if (mode == SILENCE_OFFSET_STAGES) {
+		addOffset(block);
+	}
+	auto stop = std::chrono::steady_clock::now();
+
+	if (measure) {
+		denormals += countDenormals(block);
+	}
+	return std::chrono::duration<double, std::nano>(stop-start).count();
+}
+
+static silenceResult runSilence(double fs, uint32_t burstLen, uint32_t silenceLen, uint32_t measureLen,
+		silenceMode mode) {
+	CppXover hiPass(fs, 20, LINKWITZ, HIGHPASS, 8), loPass(fs, 5000, BUTTERWORTH, LOWPASS, 4);
+	CppEQ peak(fs, 6, 40, 4, PEAKEQ), shelf(fs, -4, 80, 0.71, LOWSHELV);
+	CppLimiter limiter(fs, -6, 0, 0.5);
+	std::vector<double> sig = makeSignal(burstLen, fs), block(BENCH_BLOCK_LEN);
+	double total = 0.0, maxBlock = 0.0, blockNs;
+	uint64_t denormals = 0;
+	bool measure;
+	silenceResult result;
+
+	for (uint32_t pos=0; pos<burstLen+silenceLen; pos+=BENCH_BLOCK_LEN) {
+		for (uint32_t i=0; i<BENCH_BLOCK_LEN; i++) {
+			block[i] = (pos+i < burstLen) ? 2.0*sig[pos+i] : 0.0;
+		}
+		if (mode == SILENCE_OFFSET_INPUT || mode == SILENCE_OFFSET_STAGES) {
+			addOffset(block);
+		}
+		measure = pos >= burstLen+silenceLen-measureLen;
+
+		{
+			CppScopedFtz *guard = (mode == SILENCE_FTZ) ? new CppScopedFtz() : nullptr;
+			blockNs = runStage(peak, block, mode, measure, denormals);
+			blockNs += runStage(shelf, block, mode, measure, denormals);
+			blockNs += runStage(hiPass, block, mode, measure, denormals);
+			blockNs += runStage(loPass, block, mode, measure, denormals);
+			blockNs += runStage(limiter, block, SILENCE_PLAIN, false, denormals);
+			delete guard;
+		}
+
+		if (measure) {
+			total += blockNs;
+			maxBlock = std::max(maxBlock, blockNs);
+		}
+	}
+
+	result.nsPerSample = total/measureLen;
+	result.maxBlockUs = maxBlock*1e-3;
+	result.denormals = denormals;
+	return result;
+}
+
+static void benchSilence(double fs, double seconds, double secMeasure) {
+	uint32_t burstLen = (uint32_t) (0.1*fs), silenceLen = (uint32_t) (seconds*fs);
+	uint32_t measureLen = (uint32_t) (secMeasure*fs)/BENCH_BLOCK_LEN*BENCH_BLOCK_LEN;
+	const char *names[] = {"no protection", "flush-to-zero", "DC offset in front", "DC offset behind every stage"};
+
+	printf("\nlast %.0f s of %.0f s silence after burst at %.0f Hz (ns per sample / slowest block in us / "
+			"denormal stage outputs)\n", secMeasure, seconds, fs);
+	for (uint32_t m=SILENCE_PLAIN; m<=SILENCE_OFFSET_STAGES; m++) {
+		silenceResult result = runSilence(fs, burstLen, silenceLen, measureLen, (silenceMode) m);
+		printf("%-36s %8.2f %8.1f %10llu\n", names[m], result.nsPerSample, result.maxBlockUs,
+				(unsigned long long) result.denormals);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	double seconds = 4.0;
+	uint32_t len48, len192;
+	bool pass;
+
+	pass = checkTransferFunctions();
+	if (argc > 1 && strcmp(argv[1], "tf") == 0) {
+		return pass ? 0 : 1;
+	} else if (argc > 1) {
+		seconds = atof(argv[1]);
+	}
+	len48 = (uint32_t) (seconds*48000);
+	len192 = (uint32_t) (seconds*192000);
+
+	printf("%-36s %7s | %8s %8s | %8s %8s | %8s\n", "design", "fs", "DF ns", "DF SNR", "SVF ns", "SVF SNR", "pipe ns");
+	benchXover("Butterworth HP 4th 20 Hz", 48000, 20, BUTTERWORTH, HIGHPASS, 4, len48);
+	benchXover("Butterworth HP 4th 20 Hz", 192000, 20, BUTTERWORTH, HIGHPASS, 4, len192);
+	benchXover("Linkwitz LP 8th 80 Hz", 192000, 80, LINKWITZ, LOWPASS, 8, len192);
+	benchXover("Linkwitz HP 8th 2 kHz", 48000, 2000, LINKWITZ, HIGHPASS, 8, len48);
+	benchXover("Chebyshev I LP 6th 10 Hz", 192000, 10, CHEBYSHEV1, LOWPASS, 6, len192);
+	benchXover("Chebyshev II HP 5th 30 Hz", 96000, 30, CHEBYSHEV2, HIGHPASS, 5, len192/2);
+	benchXover("Butterworth LP 16th 1 kHz", 48000, 1000, BUTTERWORTH, LOWPASS, 16, len48);
+	benchXover("Butterworth LP 32nd 1 kHz", 48000, 1000, BUTTERWORTH, LOWPASS, 32, len48);
+	benchEQ("Peak EQ +6 dB 30 Hz Q 4", 192000, 6, 30, 4, PEAKEQ, len192);
+	benchEQ("Peak EQ -9 dB 1 kHz Q 1", 48000, -9, 1000, 1, PEAKEQ, len48);
+	benchEQ("Low shelf +6 dB 40 Hz", 192000, 6, 40, 0.71, LOWSHELV, len192);
+	benchEQ("High shelf -4 dB 8 kHz", 48000, -4, 8000, 0.71, HIGHSHELV, len48);
+	benchEQ("Lowpass 15 Hz", 192000, 0, 15, 0.71, LOWPASSEQ, len192);
+	benchEQ("Notch 50 Hz Q 10", 192000, 0, 50, 10, NOTCH, len192);
+
+	// the states of the low frequency sections need about 30 s of silence to decay into the
+	// denormal range
+	benchSilence(48000, 40.0, 6.0);
+
+	return pass ? 0 : 1;
+}
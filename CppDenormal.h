@@ -0,0 +1,99 @@
+/*------------------------------------------------------------------*\
+Denormal protection for the audio threads. After a signal stops, the
+recursive filter and limiter states decay towards zero and end up as
+denormal numbers, which many CPUs process up to 100 times slower.
+
+CppScopedFtz switches the floating point unit of the calling thread to
+flush-to-zero / denormals-are-zero for its lifetime and restores the
+previous mode afterwards:
+
+    x86 / x64 (SSE)   MXCSR FTZ (bit 15) and DAZ (bit 6)
+    AArch64           FPCR FZ (bit 24)
+    ARMv7 VFP         FPSCR FZ (bit 24)
+
+Where none of these is available, or DSP_NO_FTZ is defined,
+DSP_ANTI_DENORMAL is defined instead and antiDenormal() adds a DC
+offset far below the noise floor, which keeps the states normalised.
+A highpass removes the offset, so it is added again behind every stage
+(and every section of a fused cascade).
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPDENORMAL_H // include guard
+#define _CPPDENORMAL_H
+
+#include <vector>
+#include <cstdint>
+
+// -360 dBFS, still a normal number after any gain the processing chain applies
+#define DSP_DENORMAL_OFFSET 1e-18
+
+#if !defined(DSP_NO_FTZ) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#include <xmmintrin.h>
+#define DSP_FTZ_SSE
+#elif !defined(DSP_NO_FTZ) && defined(__aarch64__) && defined(__GNUC__)
+#define DSP_FTZ_AARCH64
+#elif !defined(DSP_NO_FTZ) && defined(__arm__) && defined(__ARM_FP) && defined(__GNUC__)
+#define DSP_FTZ_ARM
+#else
+#define DSP_ANTI_DENORMAL
+#endif
+
+class CppScopedFtz {
+
+public:
+    CppScopedFtz(void) : saved(0) {
+#if defined(DSP_FTZ_SSE)
+        saved = _mm_getcsr();
+        _mm_setcsr((uint32_t) saved | 0x8040);
+#elif defined(DSP_FTZ_AARCH64)
+        uint64_t fpcr;
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+        saved = fpcr;
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1ull << 24)));
+#elif defined(DSP_FTZ_ARM)
+        uint32_t fpscr;
+        __asm__ __volatile__("vmrs %0, fpscr" : "=r"(fpscr));
+        saved = fpscr;
+        __asm__ __volatile__("vmsr fpscr, %0" : : "r"(fpscr | (1u << 24)));
+#endif
+    }
+
+    ~CppScopedFtz(void) {
+#if defined(DSP_FTZ_SSE)
+        _mm_setcsr((uint32_t) saved);
+#elif defined(DSP_FTZ_AARCH64)
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(saved));
+#elif defined(DSP_FTZ_ARM)
+        __asm__ __volatile__("vmsr fpscr, %0" : : "r"((uint32_t) saved));
+#endif
+    }
+
+    CppScopedFtz(const CppScopedFtz &other) = delete;
+
+    CppScopedFtz &operator=(const CppScopedFtz &other) = delete;
+
+    // true if the hardware flushes denormals, false if the offset fallback is compiled in
+    static bool isSupported() {
+#if defined(DSP_ANTI_DENORMAL)
+        return false;
+#else
+        return true;
+#endif
+    }
+
+private:
+    uint64_t saved;
+};
+
+// Adds the anti-denormal offset to a block, a no-op where the hardware flushes denormals.
+inline void antiDenormal(std::vector<double> &data) {
+#if defined(DSP_ANTI_DENORMAL)
+    for (uint32_t i = 0; i < data.size(); i++) {
+        data[i] += DSP_DENORMAL_OFFSET;
+    }
+#else
+    (void) data;
+#endif
+}
+
+#endif // end of include guard
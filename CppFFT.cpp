@@ -0,0 +1,390 @@
+/*------------------------------------------------------------------*\
+Implementation of an arbitrary length FFT. Mixed radix Stockham
+autosort FFT for lengths with prime factors 2, 3 and 5, Bluestein's
+chirp z-transform for all other lengths. Instantiated for float and
+double, twiddles are always computed in double precision.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include "CppFFT.h"
+
+#ifndef M_PI
+#define M_PI 3.141592653589793
+#endif
+
+template <typename C>
+static inline C expj(double phi) {
+    C z;
+    z.re = cos(phi);
+    z.im = sin(phi);
+    return z;
+}
+
+template <typename T>
+CppFFTComplexPlan<T>::CppFFTComplexPlan(void)
+    : n(0) {
+
+}
+
+template <typename T>
+CppFFTComplexPlan<T>::CppFFTComplexPlan(uint32_t n)
+    : n(0) {
+    setSize(n);
+}
+
+template <typename T>
+CppFFTComplexPlan<T>::~CppFFTComplexPlan(void) {
+
+}
+
+template <typename T>
+int CppFFTComplexPlan<T>::setSize(uint32_t n) {
+    uint32_t rest, span, m;
+
+    if (n < 1) {
+        return -1;
+    }
+
+    this->n = n;
+    stages.clear();
+    convPlan.reset();
+    chirp.clear();
+    chirpSpec.clear();
+
+    if (CppFFTPlan<T>::isSmooth(n)) {
+        // radix 4 first, then 2, 3 and 5. The stage order is arbitrary for Stockham
+        rest = n;
+        span = 1;
+        while (rest > 1) {
+            fftStage st;
+            if (rest%4 == 0) {
+                st.radix = 4;
+            } else if (rest%2 == 0) {
+                st.radix = 2;
+            } else if (rest%3 == 0) {
+                st.radix = 3;
+            } else {
+                st.radix = 5;
+            }
+            st.span = span;
+            st.twiddles.resize(span*(st.radix-1));
+            for (uint32_t k=0; k<span; k++) {
+                for (uint32_t q=1; q<st.radix; q++) {
+                    st.twiddles[k*(st.radix-1)+q-1] = expj<complexType>(-2.0*M_PI*q*k/(span*st.radix));
+                }
+            }
+            stages.push_back(st);
+            span *= st.radix;
+            rest /= st.radix;
+        }
+        work0.resize(n);
+        work1.resize(n);
+    } else {
+        // Bluestein: circular convolution with a chirp of smooth length m >= 2n-1
+        m = CppFFTPlan<T>::nextSmooth(2*n-1);
+        convPlan.reset(new CppFFTComplexPlan<T>(m));
+        chirp.resize(n);
+        chirpSpec.resize(m);
+        work0.resize(m);
+        work1.resize(m);
+
+        for (uint32_t k=0; k<n; k++) {
+            // k^2 mod 2n keeps the phase argument small and exact
+            chirp[k] = expj<complexType>(-M_PI*(double)(((uint64_t)k*k)%(2*(uint64_t)n))/n);
+        }
+
+        std::fill(work0.begin(), work0.end(), complex(T(0), T(0)));
+        work0[0] = complex_conj(chirp[0]);
+        for (uint32_t k=1; k<n; k++) {
+            work0[k] = complex_conj(chirp[k]);
+            work0[m-k] = complex_conj(chirp[k]);
+        }
+        convPlan->transform(work0.data(), chirpSpec.data());
+        for (uint32_t k=0; k<m; k++) {
+            chirpSpec[k] = complex_mul(chirpSpec[k], T(1.0/m));
+        }
+    }
+
+    return 0;
+}
+
+template <typename T>
+void CppFFTComplexPlan<T>::stockham(complexType *data) {
+    complexType *x = data, *y = work1.data(), *tmp;
+    complexType a[5], b[5], t1, t2, t3, t4;
+    const complexType *tw;
+    const T half = T(0.5);
+    const T s3 = T(sin(2.0*M_PI/3.0));
+    const T c51 = T(cos(2.0*M_PI/5.0)), c52 = T(cos(4.0*M_PI/5.0));
+    const T s51 = T(sin(2.0*M_PI/5.0)), s52 = T(sin(4.0*M_PI/5.0));
+    uint32_t p, span, stride, k, base;
+
+    for (uint32_t s=0; s<stages.size(); s++) {
+        p = stages[s].radix;
+        span = stages[s].span;
+        stride = n/p;
+
+        for (uint32_t j=0; j<stride; j++) {
+            k = j%span;
+            tw = &stages[s].twiddles[k*(p-1)];
+
+            a[0] = x[j];
+            for (uint32_t q=1; q<p; q++) {
+                a[q] = complex_mul(x[j+q*stride], tw[q-1]);
+            }
+
+            if (p == 2) {
+                b[0] = complex_add(a[0], a[1]);
+                b[1] = complex_sub(a[0], a[1]);
+            } else if (p == 4) {
+                t1 = complex_add(a[0], a[2]);
+                t2 = complex_sub(a[0], a[2]);
+                t3 = complex_add(a[1], a[3]);
+                t4 = complex_sub(a[1], a[3]);
+                b[0] = complex_add(t1, t3);
+                b[2] = complex_sub(t1, t3);
+                b[1] = complex(t2.re + t4.im, t2.im - t4.re);
+                b[3] = complex(t2.re - t4.im, t2.im + t4.re);
+            } else if (p == 3) {
+                t1 = complex_add(a[1], a[2]);
+                t2 = complex_sub(a[0], complex_mul(t1, half));
+                t3 = complex_mul(complex_sub(a[1], a[2]), s3);
+                b[0] = complex_add(a[0], t1);
+                b[1] = complex(t2.re + t3.im, t2.im - t3.re);
+                b[2] = complex(t2.re - t3.im, t2.im + t3.re);
+            } else {
+                t1 = complex_add(a[1], a[4]);
+                t2 = complex_add(a[2], a[3]);
+                t3 = complex_sub(a[1], a[4]);
+                t4 = complex_sub(a[2], a[3]);
+                b[0] = complex_add(a[0], complex_add(t1, t2));
+                a[1] = complex_add(a[0], complex_add(complex_mul(t1, c51), complex_mul(t2, c52)));
+                a[2] = complex_add(complex_mul(t3, s51), complex_mul(t4, s52));
+                a[3] = complex_add(a[0], complex_add(complex_mul(t1, c52), complex_mul(t2, c51)));
+                a[4] = complex_sub(complex_mul(t3, s52), complex_mul(t4, s51));
+                b[1] = complex(a[1].re + a[2].im, a[1].im - a[2].re);
+                b[4] = complex(a[1].re - a[2].im, a[1].im + a[2].re);
+                b[2] = complex(a[3].re + a[4].im, a[3].im - a[4].re);
+                b[3] = complex(a[3].re - a[4].im, a[3].im + a[4].re);
+            }
+
+            base = (j-k)*p + k;
+            for (uint32_t r=0; r<p; r++) {
+                y[base+r*span] = b[r];
+            }
+        }
+
+        tmp = x;
+        x = y;
+        y = tmp;
+    }
+
+    if (x != data) {
+        std::copy(x, x+n, data);
+    }
+}
+
+template <typename T>
+int CppFFTComplexPlan<T>::transform(const complexType *input, complexType *output, bool inverse) {
+    uint32_t m;
+
+    if (n < 1 || input == nullptr || output == nullptr) {
+        return -1;
+    }
+
+    // the inverse transform is computed as conj(fft(conj(x))), unnormalised
+    if (!stages.empty() || n == 1) {
+        for (uint32_t k=0; k<n; k++) {
+            work0[k] = inverse ? complex_conj(input[k]) : input[k];
+        }
+        stockham(work0.data());
+        for (uint32_t k=0; k<n; k++) {
+            output[k] = inverse ? complex_conj(work0[k]) : work0[k];
+        }
+        return 0;
+    }
+
+    m = convPlan->getSize();
+    for (uint32_t k=0; k<n; k++) {
+        work0[k] = complex_mul(inverse ? complex_conj(input[k]) : input[k], chirp[k]);
+    }
+    std::fill(work0.begin()+n, work0.end(), complex(T(0), T(0)));
+
+    convPlan->transform(work0.data(), work1.data());
+    for (uint32_t k=0; k<m; k++) {
+        work1[k] = complex_mul(work1[k], chirpSpec[k]);
+    }
+    convPlan->transform(work1.data(), work0.data(), true);
+
+    for (uint32_t k=0; k<n; k++) {
+        output[k] = complex_mul(work0[k], chirp[k]);
+        if (inverse) {
+            output[k] = complex_conj(output[k]);
+        }
+    }
+
+    return 0;
+}
+
+template <typename T>
+CppFFTPlan<T>::CppFFTPlan(void)
+    : nfft(0) {
+
+}
+
+template <typename T>
+CppFFTPlan<T>::CppFFTPlan(uint32_t nfft)
+    : nfft(0) {
+    setSize(nfft);
+}
+
+template <typename T>
+CppFFTPlan<T>::~CppFFTPlan(void) {
+
+}
+
+template <typename T>
+int CppFFTPlan<T>::setSize(uint32_t nfft) {
+    uint32_t h;
+
+    if (nfft < 2) {
+        return -1;
+    }
+
+    this->nfft = nfft;
+
+    if (nfft%2 == 0) {
+        // real FFT by half-length complex FFT
+        h = nfft/2;
+        cplx.setSize(h);
+        bufIn.resize(h);
+        bufOut.resize(h);
+        rotation.resize(h+1);
+        for (uint32_t k=0; k<=h; k++) {
+            rotation[k] = expj<complexType>(-2.0*M_PI*k/nfft);
+        }
+    } else {
+        cplx.setSize(nfft);
+        bufIn.resize(nfft);
+        bufOut.resize(nfft);
+        rotation.clear();
+    }
+
+    return 0;
+}
+
+template <typename T>
+int CppFFTPlan<T>::forward(const T *input, complexType *spectrum) {
+    complexType zk, zc, even, odd;
+    const T half = T(0.5);
+    uint32_t h;
+
+    if (nfft < 2 || input == nullptr || spectrum == nullptr) {
+        return -1;
+    }
+
+    if (nfft%2 != 0) {
+        for (uint32_t i=0; i<nfft; i++) {
+            bufIn[i] = complex(input[i], T(0));
+        }
+        cplx.transform(bufIn.data(), bufOut.data());
+        for (uint32_t k=0; k<=nfft/2; k++) {
+            spectrum[k] = bufOut[k];
+        }
+        return 0;
+    }
+
+    h = nfft/2;
+    for (uint32_t i=0; i<h; i++) {
+        bufIn[i] = complex(input[2*i], input[2*i+1]);
+    }
+    cplx.transform(bufIn.data(), bufOut.data());
+
+    for (uint32_t k=0; k<=h; k++) {
+        zk = bufOut[k%h];
+        zc = complex_conj(bufOut[(h-k)%h]);
+        even = complex_mul(complex_add(zk, zc), half);
+        odd = complex_mul(complex_sub(zk, zc), half);
+        // X[k] = E[k] + W^k O[k], with O[k] = -j*odd
+        odd = complex_mul(complex(odd.im, -odd.re), rotation[k]);
+        spectrum[k] = complex_add(even, odd);
+    }
+
+    return 0;
+}
+
+template <typename T>
+int CppFFTPlan<T>::inverse(const complexType *spectrum, T *output) {
+    complexType xk, xc, even, odd;
+    const T half = T(0.5);
+    T norm;
+    uint32_t h;
+
+    if (nfft < 2 || spectrum == nullptr || output == nullptr) {
+        return -1;
+    }
+
+    if (nfft%2 != 0) {
+        for (uint32_t k=0; k<=nfft/2; k++) {
+            bufIn[k] = spectrum[k];
+            if (k > 0) {
+                bufIn[nfft-k] = complex_conj(spectrum[k]);
+            }
+        }
+        cplx.transform(bufIn.data(), bufOut.data(), true);
+        norm = T(1.0/nfft);
+        for (uint32_t i=0; i<nfft; i++) {
+            output[i] = bufOut[i].re*norm;
+        }
+        return 0;
+    }
+
+    h = nfft/2;
+    for (uint32_t k=0; k<h; k++) {
+        xk = spectrum[k];
+        xc = complex_conj(spectrum[h-k]);
+        even = complex_mul(complex_add(xk, xc), half);
+        odd = complex_mul(complex_mul(complex_sub(xk, xc), half), complex_conj(rotation[k]));
+        // Z[k] = E[k] + j*O[k]
+        bufIn[k] = complex(even.re - odd.im, even.im + odd.re);
+    }
+    cplx.transform(bufIn.data(), bufOut.data(), true);
+
+    norm = T(1.0/h);
+    for (uint32_t i=0; i<h; i++) {
+        output[2*i] = bufOut[i].re*norm;
+        output[2*i+1] = bufOut[i].im*norm;
+    }
+
+    return 0;
+}
+
+template <typename T>
+bool CppFFTPlan<T>::isSmooth(uint32_t n) {
+    if (n < 1) {
+        return false;
+    }
+    while (n%2 == 0) {
+        n /= 2;
+    }
+    while (n%3 == 0) {
+        n /= 3;
+    }
+    while (n%5 == 0) {
+        n /= 5;
+    }
+    return n == 1;
+}
+
+template <typename T>
+uint32_t CppFFTPlan<T>::nextSmooth(uint32_t n) {
+    while (!isSmooth(n)) {
+        n++;
+    }
+    return n;
+}
+
+template class CppFFTComplexPlan<float>;
+template class CppFFTComplexPlan<double>;
+template class CppFFTPlan<float>;
+template class CppFFTPlan<double>;
@@ -0,0 +1,102 @@
+/*------------------------------------------------------------------*\
+Interface to an arbitrary length FFT. Lengths whose only prime factors
+are 2, 3 and 5 are computed with a mixed radix (2, 3, 4, 5) Stockham
+autosort FFT, all other lengths via Bluestein's chirp z-transform on
+top of a mixed radix plan. All tables and buffers are allocated when
+the plan is created, so transforms do not allocate and may run on the
+audio thread.
+
+The plans are available in double (CppFFT, CppFFTComplex) and single
+precision (CppFFTf, CppFFTComplexf). Single precision halves the memory
+traffic and doubles the SIMD width for analysis and convolution; the
+round trip error stays around 1e-6 relative to full scale for the
+block sizes used here.
+
+The real transform uses the same data layout as fft_double() in fft.h:
+nfft real input samples yield nfft/2+1 complex bins, the inverse
+transform is normalised by 1/nfft. In-place operation is supported if
+the buffer holds nfft+2 samples.
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPFFT_H // include guard
+#define _CPPFFT_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "complex_float32.h"
+#include "complex_float64.h"
+
+template <typename T> struct fftComplexType;
+template <> struct fftComplexType<float> { typedef complex_float32 type; };
+template <> struct fftComplexType<double> { typedef complex_float64 type; };
+
+template <typename T>
+class CppFFTComplexPlan {
+
+public:
+    typedef typename fftComplexType<T>::type complexType;
+
+    CppFFTComplexPlan(void);
+
+    CppFFTComplexPlan(uint32_t n);
+
+    ~CppFFTComplexPlan(void);
+
+    int setSize(uint32_t n);
+
+    uint32_t getSize() const { return n; }
+
+    int transform(const complexType *input, complexType *output, bool inverse = false);
+
+private:
+    struct fftStage {
+        uint32_t radix, span;
+        std::vector<complexType> twiddles;
+    };
+
+    void stockham(complexType *data);
+
+    std::vector<fftStage> stages;
+    std::vector<complexType> work0, work1;
+    std::unique_ptr< CppFFTComplexPlan<T> > convPlan;
+    std::vector<complexType> chirp, chirpSpec;
+    uint32_t n;
+};
+
+template <typename T>
+class CppFFTPlan {
+
+public:
+    typedef typename fftComplexType<T>::type complexType;
+
+    CppFFTPlan(void);
+
+    CppFFTPlan(uint32_t nfft);
+
+    ~CppFFTPlan(void);
+
+    int setSize(uint32_t nfft);
+
+    uint32_t getSize() const { return nfft; }
+
+    int forward(const T *input, complexType *spectrum);
+
+    int inverse(const complexType *spectrum, T *output);
+
+    static bool isSmooth(uint32_t n);
+
+    static uint32_t nextSmooth(uint32_t n);
+
+private:
+    CppFFTComplexPlan<T> cplx;
+    std::vector<complexType> bufIn, bufOut, rotation;
+    uint32_t nfft;
+};
+
+typedef CppFFTComplexPlan<double> CppFFTComplex;
+typedef CppFFTComplexPlan<float> CppFFTComplexf;
+typedef CppFFTPlan<double> CppFFT;
+typedef CppFFTPlan<float> CppFFTf;
+
+#endif // end of include guard
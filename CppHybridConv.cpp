@@ -0,0 +1,477 @@
+/*------------------------------------------------------------------*\
+Implementation of a zero latency hybrid (time domain head, non-uniform
+partitioned FFT tail) single channel convolver.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "CppHybridConv.h"
+#include "CppDenormal.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <cerrno>
+#include <semaphore.h>
+#endif
+
+// growth of the partition length from one level to the next
+#define HYBRID_GROWTH 4
+// most worker threads of the pool, one core is left to the audio callback
+#define HYBRID_MAX_WORKERS 4
+
+// Counting semaphore, posting it neither locks nor allocates, so the callback can.
+class hybridSemaphore {
+
+public:
+#ifdef _WIN32
+    hybridSemaphore(void) { handle = CreateSemaphore(NULL, 0, 0x7fffffff, NULL); }
+    ~hybridSemaphore(void) { CloseHandle(handle); }
+    void post() { ReleaseSemaphore(handle, 1, NULL); }
+    void wait() { WaitForSingleObject(handle, INFINITE); }
+
+private:
+    HANDLE handle;
+#elif defined(__APPLE__)
+    hybridSemaphore(void) { sem = dispatch_semaphore_create(0); }
+    ~hybridSemaphore(void) { dispatch_release(sem); }
+    void post() { dispatch_semaphore_signal(sem); }
+    void wait() { dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER); }
+
+private:
+    dispatch_semaphore_t sem;
+#else
+    hybridSemaphore(void) { sem_init(&sem, 0, 0); }
+    ~hybridSemaphore(void) { sem_destroy(&sem); }
+    void post() { sem_post(&sem); }
+    void wait() { while (sem_wait(&sem) != 0 && errno == EINTR) {} }
+
+private:
+    sem_t sem;
+#endif
+};
+
+// Worker threads shared by the levels of all convolvers in the process, started with the
+// first level. A thread claims a level under the mutex and computes everything it has
+// queued, so the partitions of a level stay in order.
+class CppHybridPool {
+
+public:
+    static CppHybridPool &get() {
+        static CppHybridPool pool;
+        return pool;
+    }
+
+    void add(CppHybridConv::convLevel *level);
+
+    // Returns once no thread works on the level any more.
+    void remove(CppHybridConv::convLevel *level);
+
+    // One partition was queued, callback side.
+    inline void post() {
+        sem.post();
+    }
+
+private:
+    CppHybridPool(void) : running(true) {}
+
+    ~CppHybridPool(void);
+
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::vector<CppHybridConv::convLevel*> levels;
+    std::mutex mutex;
+    std::condition_variable released;
+    hybridSemaphore sem;
+    bool running;
+};
+
+CppHybridPool::~CppHybridPool(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    for (uint32_t i=0; i<workers.size(); i++) {
+        sem.post();
+    }
+    for (uint32_t i=0; i<workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+void CppHybridPool::add(CppHybridConv::convLevel *level) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t numWorkers;
+
+    if (workers.empty()) {
+        numWorkers = std::min((uint32_t) HYBRID_MAX_WORKERS, std::max(2u, std::thread::hardware_concurrency())-1);
+        for (uint32_t i=0; i<numWorkers; i++) {
+            workers.push_back(std::thread(&CppHybridPool::workerLoop, this));
+        }
+    }
+
+    // shortest partition first, it has the closest deadline
+    level->claimed = false;
+    std::vector<CppHybridConv::convLevel*>::iterator it = levels.begin();
+    while (it != levels.end() && (*it)->partLen <= level->partLen) {
+        it++;
+    }
+    levels.insert(it, level);
+}
+
+void CppHybridPool::remove(CppHybridConv::convLevel *level) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    levels.erase(std::remove(levels.begin(), levels.end(), level), levels.end());
+    released.wait(lock, [level] { return !level->claimed; });
+}
+
+void CppHybridPool::workerLoop() {
+    CppScopedFtz ftz;
+    CppHybridConv::convLevel *level;
+
+    while (true) {
+        sem.wait();
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+
+        // a post whose level another thread holds is covered by that thread, which
+        // checks for more partitions before it releases the claim
+        level = nullptr;
+        for (uint32_t i=0; i<levels.size(); i++) {
+            if (!levels[i]->claimed && levels[i]->handed.load(std::memory_order_acquire) !=
+                    levels[i]->finished.load(std::memory_order_relaxed)) {
+                level = levels[i];
+                break;
+            }
+        }
+        if (level == nullptr) {
+            continue;
+        }
+
+        level->claimed = true;
+        do {
+            lock.unlock();
+            CppHybridConv::runQueued(*level);
+            lock.lock();
+        } while (level->handed.load(std::memory_order_acquire) != level->finished.load(std::memory_order_relaxed));
+        level->claimed = false;
+        released.notify_all();
+    }
+}
+
+CppHybridConv::CppHybridConv(void)
+    : lateCount(0), attached(false), blockLen(0), threaded(true) {
+
+}
+
+CppHybridConv::CppHybridConv(uint32_t blockLen)
+    : lateCount(0), attached(false), blockLen(blockLen), threaded(true) {
+
+}
+
+CppHybridConv::~CppHybridConv(void) {
+    detachWorkers();
+}
+
+int CppHybridConv::setBlockLen(uint32_t blockLen) {
+    if (blockLen < 1) {
+        return -1;
+    }
+
+    clearFilter();
+    this->blockLen = blockLen;
+    return 0;
+}
+
+int CppHybridConv::setFilter(const std::vector<double> &ir) {
+    uint32_t len, headLen, offset, partLen, maxParts, numParts;
+
+    if (blockLen < 1) {
+        return -1;
+    }
+
+    clearFilter();
+    if (ir.empty()) {
+        return 0;
+    }
+
+    // direct form head, taps reversed so the inner loop runs forward over the history
+    len = (uint32_t) ir.size();
+    headLen = std::min(len, blockLen);
+    head.resize(headLen);
+    for (uint32_t k=0; k<headLen; k++) {
+        head[k] = ir[headLen-1-k];
+    }
+    headHist.assign(headLen-1+blockLen, 0.0);
+
+    // first level runs in the callback one block behind, all later ones two periods behind
+    offset = blockLen;
+    partLen = blockLen;
+    maxParts = 7;
+    while (offset < len) {
+        numParts = std::min((len-offset+partLen-1)/partLen, maxParts);
+
+        std::unique_ptr<convLevel> level(new convLevel);
+        level->partLen = partLen;
+        level->numParts = numParts;
+        level->numBins = partLen+1;
+        level->delay = (levels.empty()) ? 1 : 2;
+        level->fill = 0;
+        level->chunk = 0;
+        level->warm = 0;
+        level->pos = 0;
+        level->live = false;
+        level->dropping = false;
+        level->fft.setSize(2*partLen);
+        level->parts.resize(numParts*level->numBins);
+        level->fdl.assign(numParts*level->numBins, complex(0.0f, 0.0f));
+        level->accu.resize(level->numBins);
+        level->collect.assign(partLen, 0.0f);
+        level->queue.assign(HYBRID_QUEUE*partLen, 0.0f);
+        level->timeBuf.assign(2*partLen, 0.0f);
+        level->work.assign(2*partLen+2, 0.0f);
+        level->outBuf[0].assign(partLen, 0.0f);
+        level->outBuf[1].assign(partLen, 0.0f);
+        level->handed.store(0);
+        level->finished.store(0);
+        level->ready.store(0);
+        level->claimed = false;
+
+        for (uint32_t p=0; p<numParts; p++) {
+            std::fill(level->work.begin(), level->work.end(), 0.0f);
+            for (uint32_t j=0; j<partLen && offset+p*partLen+j<len; j++) {
+                level->work[j] = (float) ir[offset+p*partLen+j];
+            }
+            level->fft.forward(level->work.data(), &level->parts[p*level->numBins]);
+        }
+        levels.push_back(std::move(level));
+
+        offset += numParts*partLen;
+        partLen *= HYBRID_GROWTH;
+        maxParts = 2*HYBRID_GROWTH-2;
+    }
+
+    if (threaded) {
+        attachWorkers();
+    }
+    return 0;
+}
+
+void CppHybridConv::clearFilter() {
+    detachWorkers();
+    levels.clear();
+    head.clear();
+    headHist.clear();
+}
+
+void CppHybridConv::setThreaded(bool threaded) {
+    detachWorkers();
+    this->threaded = threaded;
+    if (threaded) {
+        attachWorkers();
+    } else {
+        // what the workers left is computed here, the delay lines stay consistent
+        for (uint32_t i=1; i<levels.size(); i++) {
+            runQueued(*levels[i]);
+        }
+    }
+}
+
+void CppHybridConv::reset() {
+    detachWorkers();
+    std::fill(headHist.begin(), headHist.end(), 0.0);
+    for (uint32_t i=0; i<levels.size(); i++) {
+        convLevel &level = *levels[i];
+        level.fill = 0;
+        level.chunk = 0;
+        level.warm = 0;
+        level.pos = 0;
+        level.live = false;
+        level.dropping = false;
+        level.handed.store(0);
+        level.finished.store(0);
+        level.ready.store(0);
+        std::fill(level.fdl.begin(), level.fdl.end(), complex(0.0f, 0.0f));
+        std::fill(level.timeBuf.begin(), level.timeBuf.end(), 0.0f);
+        std::fill(level.outBuf[0].begin(), level.outBuf[0].end(), 0.0f);
+        std::fill(level.outBuf[1].begin(), level.outBuf[1].end(), 0.0f);
+    }
+    if (threaded) {
+        attachWorkers();
+    }
+}
+
+void CppHybridConv::computeLevel(convLevel &level, const float *input, uint32_t chunk, bool restart) {
+    const complex_float32 *x, *h;
+    std::vector<float> &out = level.outBuf[chunk&1];
+
+    // the partitions before were dropped, the level starts from silence
+    if (restart) {
+        std::fill(level.fdl.begin(), level.fdl.end(), complex(0.0f, 0.0f));
+        std::fill(level.timeBuf.begin(), level.timeBuf.end(), 0.0f);
+        level.pos = 0;
+    }
+
+    std::copy(level.timeBuf.begin()+level.partLen, level.timeBuf.end(), level.timeBuf.begin());
+    std::copy(input, input+level.partLen, level.timeBuf.begin()+level.partLen);
+
+    level.pos = (level.pos+level.numParts-1)%level.numParts;
+    std::copy(level.timeBuf.begin(), level.timeBuf.end(), level.work.begin());
+    level.fft.forward(level.work.data(), &level.fdl[level.pos*level.numBins]);
+
+    std::fill(level.accu.begin(), level.accu.end(), complex(0.0f, 0.0f));
+    for (uint32_t p=0; p<level.numParts; p++) {
+        x = &level.fdl[((level.pos+p)%level.numParts)*level.numBins];
+        h = &level.parts[p*level.numBins];
+        for (uint32_t k=0; k<level.numBins; k++) {
+            level.accu[k].re += x[k].re*h[k].re - x[k].im*h[k].im;
+            level.accu[k].im += x[k].re*h[k].im + x[k].im*h[k].re;
+        }
+    }
+
+    // overlap-save: the second half of the inverse transform is valid
+    level.fft.inverse(level.accu.data(), level.work.data());
+    std::copy(level.work.begin()+level.partLen, level.work.begin()+2*level.partLen, out.begin());
+}
+
+void CppHybridConv::runQueued(convLevel &level) {
+    uint32_t done = level.finished.load(std::memory_order_relaxed), slot;
+
+    while (done != level.handed.load(std::memory_order_acquire)) {
+        slot = done%HYBRID_QUEUE;
+        computeLevel(level, &level.queue[slot*level.partLen], level.queueChunk[slot], level.queueRestart[slot]);
+        level.ready.store(level.queueChunk[slot]+1, std::memory_order_release);
+        level.finished.store(++done, std::memory_order_release);
+    }
+}
+
+void CppHybridConv::handOver(convLevel &level) {
+    uint32_t handed = level.handed.load(std::memory_order_relaxed), slot;
+    uint32_t finished = level.finished.load(std::memory_order_acquire);
+    bool restart = false;
+
+    // a full queue drops partitions until the worker has caught up with the rest
+    if (level.dropping && handed == finished) {
+        level.dropping = false;
+        restart = true;
+    } else if (handed-finished >= HYBRID_QUEUE) {
+        level.dropping = true;
+    }
+    if (level.dropping) {
+        return;
+    }
+
+    slot = handed%HYBRID_QUEUE;
+    std::copy(level.collect.begin(), level.collect.end(), level.queue.begin()+slot*level.partLen);
+    level.queueChunk[slot] = level.chunk;
+    level.queueRestart[slot] = restart;
+    level.handed.store(handed+1, std::memory_order_release);
+    CppHybridPool::get().post();
+
+    // the output of the chunks before the restart is lost
+    if (restart) {
+        level.warm = 0;
+    }
+}
+
+void CppHybridConv::process(std::vector<double> &data) {
+    const double *x, *h;
+    double acc0, acc1, acc2, acc3;
+    uint32_t headLen = (uint32_t) head.size(), k;
+
+    if (headLen == 0 || data.size() != blockLen) {
+        return;
+    }
+
+    // dry input goes behind the last headLen-1 samples, the levels read it from there
+    std::copy(data.begin(), data.end(), headHist.begin()+headLen-1);
+    const double *dry = &headHist[headLen-1];
+
+    // direct form head, four partial sums so the compiler can vectorise the dot product
+    h = head.data();
+    for (uint32_t n=0; n<blockLen; n++) {
+        x = &headHist[n];
+        acc0 = acc1 = acc2 = acc3 = 0.0;
+        for (k=0; k+4<=headLen; k+=4) {
+            acc0 += h[k]*x[k];
+            acc1 += h[k+1]*x[k+1];
+            acc2 += h[k+2]*x[k+2];
+            acc3 += h[k+3]*x[k+3];
+        }
+        for (; k<headLen; k++) {
+            acc0 += h[k]*x[k];
+        }
+        data[n] = (acc0+acc1)+(acc2+acc3);
+    }
+
+    for (uint32_t i=0; i<levels.size(); i++) {
+        convLevel &level = *levels[i];
+
+        // a period plays the chunk delay periods back, if it was computed in time
+        if (level.fill == 0) {
+            level.live = level.warm >= level.delay && (int32_t) (level.ready.load(std::memory_order_acquire)-
+                    (level.chunk-level.delay+1)) >= 0;
+            if (!level.live && level.warm >= level.delay) {
+                lateCount.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        if (level.live) {
+            const std::vector<float> &out = level.outBuf[(level.chunk+level.delay)&1];
+            for (uint32_t j=0; j<blockLen; j++) {
+                data[j] += out[level.fill+j];
+            }
+        }
+        for (uint32_t j=0; j<blockLen; j++) {
+            level.collect[level.fill+j] = (float) dry[j];
+        }
+        level.fill += blockLen;
+        if (level.fill < level.partLen) {
+            continue;
+        }
+
+        // a full partition of input is collected
+        if (i == 0 || !threaded) {
+            computeLevel(level, level.collect.data(), level.chunk, false);
+            level.ready.store(level.chunk+1, std::memory_order_relaxed);
+        } else {
+            handOver(level);
+        }
+        level.chunk++;
+        level.fill = 0;
+        if (level.warm < level.delay) {
+            level.warm++;
+        }
+    }
+
+    std::copy(headHist.begin()+blockLen, headHist.end(), headHist.begin());
+}
+
+void CppHybridConv::attachWorkers() {
+    if (attached || levels.size() < 2) {
+        return;
+    }
+    for (uint32_t i=1; i<levels.size(); i++) {
+        CppHybridPool::get().add(levels[i].get());
+    }
+    attached = true;
+}
+
+void CppHybridConv::detachWorkers() {
+    if (!attached) {
+        return;
+    }
+    for (uint32_t i=1; i<levels.size(); i++) {
+        CppHybridPool::get().remove(levels[i].get());
+    }
+    attached = false;
+}
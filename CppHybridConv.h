@@ -0,0 +1,112 @@
+/*------------------------------------------------------------------*\
+Interface to a zero latency single channel FIR convolver. The impulse
+response is split into segments of growing length:
+
+    [0, B)            direct form FIR in the time domain
+    [B, 8B)           partitions of B, FFT, computed in the callback
+    [2P, 8P)          partitions of P = 4B, 16B, ... , FFT, computed on
+                      a worker thread
+
+B is the audio block length. A segment starting at 2P leaves the worker
+one full period of P samples to finish, so its result is ready before
+it is needed and the output stays sample aligned with the dry path.
+The last level takes as many partitions as the response needs.
+
+The worker levels of all convolvers in the process share a small pool
+of threads at normal priority, i.e. below the audio callback, which
+wakes them through a semaphore. Every level queues its partitions, so
+a worker that falls behind catches up in order and the delay line stays
+consistent. A level whose result is not ready when its period starts is
+muted for that period and getLateCount() increases. If the queue runs
+full, the level drops its input until the worker has caught up and then
+restarts from silence. Without workers (setThreaded(false)) all levels
+are computed in the callback, which is deterministic but concentrates
+the cost in the blocks that complete a long partition.
+
+Everything but process() and getLateCount() runs on the control thread
+and not while process() does.
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPHYBRIDCONV_H // include guard
+#define _CPPHYBRIDCONV_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "CppFFT.h"
+
+// partitions a worker level can queue before it drops input
+#define HYBRID_QUEUE 4
+
+class CppHybridPool;
+
+class CppHybridConv {
+
+public:
+    CppHybridConv(void);
+
+    CppHybridConv(uint32_t blockLen);
+
+    ~CppHybridConv(void);
+
+    int setBlockLen(uint32_t blockLen);
+
+    int setFilter(const std::vector<double> &ir);
+
+    void clearFilter();
+
+    void setThreaded(bool threaded);
+
+    inline bool isActive() const {
+        return !head.empty();
+    }
+
+    inline uint32_t getLateCount() const {
+        return lateCount.load(std::memory_order_relaxed);
+    }
+
+    void process(std::vector<double> &data);
+
+    void reset();
+
+private:
+    friend class CppHybridPool;
+
+    // The callback owns fill to dropping, the worker the delay line (fdl, timeBuf, pos)
+    // and the output buffer it writes. handed counts the partitions queued, finished
+    // those computed, ready is one past the chunk computed last.
+    struct convLevel {
+        uint32_t partLen, numParts, numBins, delay;
+        uint32_t fill, chunk, warm, pos;
+        bool live, dropping;
+        CppFFTf fft;
+        std::vector<complex_float32> parts, fdl, accu;
+        std::vector<float> collect, queue, timeBuf, work;
+        std::vector<float> outBuf[2];
+        uint32_t queueChunk[HYBRID_QUEUE];
+        bool queueRestart[HYBRID_QUEUE];
+        std::atomic<uint32_t> handed, finished, ready;
+        bool claimed;
+    };
+
+    static void computeLevel(convLevel &level, const float *input, uint32_t chunk, bool restart);
+
+    // Computes the queued partitions of a level, on a worker or the control thread.
+    static void runQueued(convLevel &level);
+
+    void handOver(convLevel &level);
+
+    void attachWorkers();
+
+    void detachWorkers();
+
+    std::vector<double> head, headHist;
+    std::vector< std::unique_ptr<convLevel> > levels;
+    std::atomic<uint32_t> lateCount;
+    bool attached;
+    uint32_t blockLen;
+    bool threaded;
+};
+
+#endif // end of include guard
@@ -0,0 +1,179 @@
+/*------------------------------------------------------------------*\
+Implementation of the native JACK client backend.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <stdexcept>
+#include "CppJackIO.h"
+#include "CppRTA.h"
+
+CppJackIO::CppJackIO(void)
+    : client(nullptr), rta(nullptr), xruns(0), mismatches(0), rolling(true), followTransport(false),
+      serverLost(false), autoConnect(true) {
+
+}
+
+CppJackIO::~CppJackIO(void) {
+    stop();
+}
+
+bool CppJackIO::isJackHostAPI(const std::string &hostAPI) {
+    return hostAPI == "JACK Audio Connection Kit";
+}
+
+int CppJackIO::getServerConfig(uint32_t &periodSize, uint32_t &sampleRate) {
+    jack_status_t status;
+    jack_client_t *probe = jack_client_open("virtualDSP-probe", JackNoStartServer, &status);
+
+    if (probe == nullptr) {
+        return -1;
+    }
+    periodSize = jack_get_buffer_size(probe);
+    sampleRate = jack_get_sample_rate(probe);
+    jack_client_close(probe);
+    return 0;
+}
+
+void CppJackIO::start(CppRTA *rta, const std::string &clientName) {
+    jack_status_t status;
+    jack_port_t *port;
+    std::string name;
+
+    stop();
+    this->rta = rta;
+
+    client = jack_client_open(clientName.c_str(), JackNoStartServer, &status);
+    if (client == nullptr) {
+        throw std::invalid_argument(std::string("JACK: could not connect to the server"));
+    }
+
+    if (jack_get_sample_rate(client) != rta->getSampleRate()) {
+        stop();
+        throw std::invalid_argument(std::string("JACK: the server runs at another sample rate"));
+    }
+    if (jack_get_buffer_size(client) % rta->getBlockLen() != 0) {
+        stop();
+        throw std::invalid_argument(std::string("JACK: the period is no multiple of the block size"));
+    }
+
+    for (uint32_t j=0; j<rta->getNumIns(); j++) {
+        name = "in_" + std::to_string(j+1);
+        port = jack_port_register(client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+        if (port == nullptr) {
+            stop();
+            throw std::invalid_argument(std::string("JACK: could not register ") + name);
+        }
+        inPorts.push_back(port);
+    }
+    for (uint32_t i=0; i<rta->getNumOuts(); i++) {
+        name = "out_" + std::to_string(i+1);
+        port = jack_port_register(client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+        if (port == nullptr) {
+            stop();
+            throw std::invalid_argument(std::string("JACK: could not register ") + name);
+        }
+        outPorts.push_back(port);
+    }
+    inBufs.assign(inPorts.size(), nullptr);
+    outBufs.assign(outPorts.size(), nullptr);
+
+    xruns.store(0);
+    mismatches.store(0);
+    serverLost.store(false);
+    jack_set_process_callback(client, processCallback, this);
+    jack_set_buffer_size_callback(client, bufferSizeCallback, this);
+    jack_set_xrun_callback(client, xrunCallback, this);
+    jack_on_shutdown(client, shutdownCallback, this);
+
+    if (jack_activate(client) != 0) {
+        stop();
+        throw std::invalid_argument(std::string("JACK: could not activate the client"));
+    }
+    if (autoConnect) {
+        connectPhysical();
+    }
+}
+
+void CppJackIO::stop() {
+    if (client != nullptr) {
+        if (!serverLost.load()) {
+            jack_deactivate(client);
+        }
+        jack_client_close(client);
+        client = nullptr;
+    }
+    inPorts.clear();
+    outPorts.clear();
+}
+
+void CppJackIO::connectPhysical() {
+    const char **ports;
+
+    // capture ports are outputs of the server, playback ports its inputs
+    ports = jack_get_ports(client, nullptr, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical|JackPortIsOutput);
+    for (uint32_t j=0; ports != nullptr && ports[j] != nullptr && j<inPorts.size(); j++) {
+        jack_connect(client, ports[j], jack_port_name(inPorts[j]));
+    }
+    jack_free(ports);
+
+    ports = jack_get_ports(client, nullptr, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical|JackPortIsInput);
+    for (uint32_t i=0; ports != nullptr && ports[i] != nullptr && i<outPorts.size(); i++) {
+        jack_connect(client, jack_port_name(outPorts[i]), ports[i]);
+    }
+    jack_free(ports);
+}
+
+int CppJackIO::processCallback(jack_nframes_t numFrames, void *arg) {
+    CppJackIO *obj = (CppJackIO*) arg;
+    uint32_t blockLen = obj->rta->getBlockLen();
+    bool rolling = jack_transport_query(obj->client, nullptr) == JackTransportRolling;
+
+    obj->rolling.store(rolling, std::memory_order_relaxed);
+    for (uint32_t j=0; j<obj->inPorts.size(); j++) {
+        obj->inBufs[j] = (const float*) jack_port_get_buffer(obj->inPorts[j], numFrames);
+    }
+    for (uint32_t i=0; i<obj->outPorts.size(); i++) {
+        obj->outBufs[i] = (float*) jack_port_get_buffer(obj->outPorts[i], numFrames);
+    }
+
+    if (numFrames % blockLen != 0 || (obj->followTransport.load(std::memory_order_relaxed) && !rolling)) {
+        for (uint32_t i=0; i<obj->outBufs.size(); i++) {
+            std::fill(obj->outBufs[i], obj->outBufs[i]+numFrames, 0.0f);
+        }
+        return 0;
+    }
+
+    // the port buffers are planar already, a period of several blocks runs block by block
+    for (uint32_t offset=0; offset<numFrames; offset+=blockLen) {
+        obj->rta->processBlock(obj->inBufs.data(), obj->outBufs.data());
+        for (uint32_t j=0; j<obj->inBufs.size(); j++) {
+            obj->inBufs[j] += blockLen;
+        }
+        for (uint32_t i=0; i<obj->outBufs.size(); i++) {
+            obj->outBufs[i] += blockLen;
+        }
+    }
+    return 0;
+}
+
+int CppJackIO::bufferSizeCallback(jack_nframes_t numFrames, void *arg) {
+    CppJackIO *obj = (CppJackIO*) arg;
+
+    if (numFrames % obj->rta->getBlockLen() != 0) {
+        obj->mismatches.fetch_add(1, std::memory_order_relaxed);
+    }
+    return 0;
+}
+
+int CppJackIO::xrunCallback(void *arg) {
+    CppJackIO *obj = (CppJackIO*) arg;
+
+    obj->xruns.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+void CppJackIO::shutdownCallback(void *arg) {
+    CppJackIO *obj = (CppJackIO*) arg;
+
+    obj->serverLost.store(true, std::memory_order_release);
+}
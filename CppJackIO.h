@@ -0,0 +1,97 @@
+/*------------------------------------------------------------------*\
+Interface to a native JACK client backend for CppRTA, compiled with
+VDSP_USE_JACK. It bypasses PortAudio: the client registers one port
+per input and output channel, hands the non-interleaved port buffers
+straight to CppRTA::processBlock() and runs in the JACK process thread
+at the period and sample rate of the server.
+
+The CppRTA block length has to divide the JACK period, periods of a
+multiple of it are processed in several blocks without extra latency.
+getServerConfig() tells the period and rate to construct CppRTA with.
+If the server changes its period to an incompatible size, the outputs
+are silent until it matches again and getPeriodMismatchCount() grows.
+
+With setFollowTransport(true) the outputs are muted while the JACK
+transport is stopped. Ports are connected to the physical ports of the
+server in order unless setAutoConnect(false) is called before start().
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPJACKIO_H // include guard
+#define _CPPJACKIO_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <jack/jack.h>
+#include "CppAudioBackend.h"
+
+class CppJackIO : public CppAudioBackend {
+
+public:
+    CppJackIO(void);
+
+    ~CppJackIO(void) override;
+
+    // true for the name PortAudio lists the JACK host API under
+    static bool isJackHostAPI(const std::string &hostAPI);
+
+    // Period size and sample rate of the running server, -1 if there is none.
+    static int getServerConfig(uint32_t &periodSize, uint32_t &sampleRate);
+
+    // Opens and activates the client for rta, throws std::invalid_argument on failure.
+    void start(CppRTA *rta, const std::string &clientName);
+
+    inline void start(CppRTA *rta) override {
+        start(rta, "virtualDSP");
+    }
+
+    void stop() override;
+
+    inline void setAutoConnect(bool autoConnect) {
+        this->autoConnect = autoConnect;
+    }
+
+    inline void setFollowTransport(bool follow) {
+        followTransport.store(follow, std::memory_order_relaxed);
+    }
+
+    inline bool isRolling() const {
+        return rolling.load(std::memory_order_relaxed);
+    }
+
+    inline uint32_t getXrunCount() const override {
+        return xruns.load(std::memory_order_relaxed);
+    }
+
+    inline uint32_t getPeriodMismatchCount() const {
+        return mismatches.load(std::memory_order_relaxed);
+    }
+
+    // false after the server shut the client down
+    inline bool isConnected() const {
+        return client != nullptr && !serverLost.load(std::memory_order_acquire);
+    }
+
+private:
+    static int processCallback(jack_nframes_t numFrames, void *arg);
+
+    static int bufferSizeCallback(jack_nframes_t numFrames, void *arg);
+
+    static int xrunCallback(void *arg);
+
+    static void shutdownCallback(void *arg);
+
+    void connectPhysical();
+
+    jack_client_t *client;
+    CppRTA *rta;
+    std::vector<jack_port_t*> inPorts, outPorts;
+    std::vector<const float*> inBufs;
+    std::vector<float*> outBufs;
+    std::atomic<uint32_t> xruns, mismatches;
+    std::atomic<bool> rolling, followTransport, serverLost;
+    bool autoConnect;
+};
+
+#endif // end of include guard
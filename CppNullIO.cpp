@@ -0,0 +1,278 @@
+/*------------------------------------------------------------------*\
+Implementation of the null/loopback backend.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include "CppNullIO.h"
+#include "CppRTA.h"
+
+CppNullIO::CppNullIO(void)
+    : rta(nullptr), inSource(NULLIO_SILENCE), outSink(NULLIO_DISCARD), outType(AUDIOFILE_RAW),
+      outFormat(SAMPLE_FLOAT32), running(false), finished(false), xruns(0),
+      blocks(0), totalNanos(0), maxNanos(0), maxBlocks(0), inPos(0), outLimit(0), blockLen(0), numIns(0), numOuts(0),
+      realtime(true), loopInput(false), inPlace(false) {
+
+}
+
+CppNullIO::~CppNullIO(void) {
+    stop();
+}
+
+void CppNullIO::setInput(const std::vector< std::vector<float> > &input, bool loop) {
+    size_t length = 0;
+
+    // channels of equal length, shorter ones padded with silence
+    for (uint32_t j=0; j<input.size(); j++) {
+        length = std::max(length, input[j].size());
+    }
+    inMemory = input;
+    for (uint32_t j=0; j<inMemory.size(); j++) {
+        inMemory[j].resize(length, 0.0f);
+    }
+    inSource = NULLIO_MEMORY;
+    loopInput = loop;
+}
+
+void CppNullIO::setInputFile(const std::string &path, bool loop) {
+    inPath = path;
+    inSource = NULLIO_FILE;
+    loopInput = loop;
+}
+
+void CppNullIO::setOutput(uint32_t maxFrames) {
+    outLimit = maxFrames;
+    outSink = NULLIO_MEMORY;
+}
+
+void CppNullIO::setOutputFile(const std::string &path, audioFileType type, sampleFormat format) {
+    outPath = path;
+    outType = type;
+    outFormat = format;
+    outSink = NULLIO_FILE;
+}
+
+void CppNullIO::open(CppRTA *rta) {
+    close();
+    this->rta = rta;
+    blockLen = rta->getBlockLen();
+    numIns = rta->getNumIns();
+    numOuts = rta->getNumOuts();
+
+    if (inSource == NULLIO_FILE && reader.open(inPath) != 0 &&
+        reader.openRaw(inPath, std::max(numIns, 1u), rta->getSampleRate()) != 0) {
+        throw std::invalid_argument("null backend: cannot read " + inPath);
+    }
+    if (outSink == NULLIO_FILE && writer.open(outPath, outType, numOuts, rta->getSampleRate(), outFormat) != 0) {
+        reader.close();
+        throw std::invalid_argument("null backend: cannot write " + outPath);
+    }
+
+    // channels the file holds planar float32 go to the processing straight from the mapping
+    inPlace = inSource == NULLIO_FILE && numIns > 0;
+    for (uint32_t j=0; j<std::min(numIns, reader.getNumChans()); j++) {
+        inPlace = inPlace && reader.getPlanar(j) != nullptr;
+    }
+
+    // everything the blocks need is allocated here, processing does not allocate
+    inScratch.assign(numIns, std::vector<float>(blockLen, 0.0f));
+    outScratch.assign(numOuts, std::vector<float>(blockLen, 0.0f));
+    inPtrs.resize(numIns);
+    filePtrs.resize(numIns);
+    for (uint32_t j=0; j<numIns; j++) {
+        inPtrs[j] = inScratch[j].data();
+    }
+    outPtrs.resize(numOuts);
+    for (uint32_t i=0; i<numOuts; i++) {
+        outPtrs[i] = outScratch[i].data();
+    }
+    outMemory.assign((outSink == NULLIO_MEMORY) ? numOuts : 0, std::vector<float>());
+    for (uint32_t i=0; i<outMemory.size(); i++) {
+        outMemory[i].reserve(outLimit);
+    }
+
+    inPos = 0;
+    blocks.store(0);
+    xruns.store(0);
+    totalNanos.store(0);
+    maxNanos.store(0);
+    finished.store(false);
+}
+
+void CppNullIO::close() {
+    reader.close();
+    writer.close();
+}
+
+void CppNullIO::start(CppRTA *rta) {
+    stop();
+    open(rta);
+    running.store(true);
+    thread = std::thread(&CppNullIO::threadLoop, this);
+}
+
+void CppNullIO::stop() {
+    running.store(false);
+    if (thread.joinable()) {
+        thread.join();
+    }
+    close();
+}
+
+uint64_t CppNullIO::run(CppRTA *rta, uint64_t numBlocks) {
+    uint64_t n = 0;
+
+    stop();
+    open(rta);
+    while (n < numBlocks && processNext()) {
+        n++;
+    }
+    close();
+    return n;
+}
+
+void CppNullIO::threadLoop() {
+    std::chrono::steady_clock::duration period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::nanoseconds((uint64_t) blockLen*1000000000/rta->getSampleRate()));
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now(), now;
+
+    while (running.load(std::memory_order_relaxed) && processNext()) {
+        if (!realtime) {
+            continue;
+        }
+        // a device would have needed the block by the end of its period
+        deadline += period;
+        now = std::chrono::steady_clock::now();
+        if (now > deadline) {
+            xruns.fetch_add(1, std::memory_order_relaxed);
+            deadline = now;
+        } else {
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+}
+
+bool CppNullIO::processNext() {
+    std::chrono::steady_clock::time_point t0;
+    uint64_t nanos;
+
+    if ((maxBlocks > 0 && blocks.load(std::memory_order_relaxed) >= maxBlocks) || !readInput()) {
+        finished.store(true, std::memory_order_release);
+        return false;
+    }
+
+    t0 = std::chrono::steady_clock::now();
+    rta->processBlock(inPtrs.data(), outPtrs.data());
+    nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-t0).count();
+
+    totalNanos.fetch_add(nanos, std::memory_order_relaxed);
+    if (nanos > maxNanos.load(std::memory_order_relaxed)) {
+        maxNanos.store(nanos, std::memory_order_relaxed);
+    }
+    blocks.fetch_add(1, std::memory_order_relaxed);
+
+    writeOutput();
+    return true;
+}
+
+bool CppNullIO::readInput() {
+    uint64_t length;
+    uint32_t got = 0, frames;
+
+    switch (inSource) {
+    case NULLIO_MEMORY:
+        length = inMemory.empty() ? 0 : inMemory[0].size();
+        if (length == 0 || (inPos >= length && !loopInput)) {
+            return false;
+        }
+        // the last block is padded with silence
+        for (uint32_t k=0; k<blockLen; k++) {
+            if (inPos == length && loopInput) {
+                inPos = 0;
+            }
+            for (uint32_t j=0; j<numIns; j++) {
+                inScratch[j][k] = (j < inMemory.size() && inPos < length) ? inMemory[j][inPos] : 0.0f;
+            }
+            if (inPos < length) {
+                inPos++;
+            }
+        }
+        return true;
+
+    case NULLIO_FILE:
+        length = reader.getNumFrames();
+        if (length == 0 || (inPos >= length && !loopInput)) {
+            return false;
+        }
+        if (inPos >= length) {
+            inPos = 0;
+        }
+        if (inPlace && inPos+blockLen <= length) {
+            for (uint32_t j=0; j<numIns; j++) {
+                inPtrs[j] = (j < reader.getNumChans()) ? reader.getPlanar(j)+inPos : inScratch[j].data();
+            }
+            inPos += blockLen;
+            reader.release(inPos);
+            return true;
+        }
+
+        // converted block, wrapped around or padded with silence at the end of the file
+        for (uint32_t j=0; j<numIns; j++) {
+            inPtrs[j] = inScratch[j].data();
+            std::fill(inScratch[j].begin(), inScratch[j].end(), 0.0f);
+        }
+        while (got < blockLen) {
+            for (uint32_t j=0; j<numIns; j++) {
+                filePtrs[j] = inScratch[j].data()+got;
+            }
+            frames = reader.read(inPos, blockLen-got, filePtrs.data(), numIns);
+            inPos += frames;
+            got += frames;
+            if (got < blockLen) {
+                if (!loopInput) {
+                    break;
+                }
+                inPos = 0;
+            }
+        }
+        reader.release(inPos);
+        return true;
+
+    case NULLIO_LOOPBACK:
+        for (uint32_t j=0; j<numIns; j++) {
+            if (j < numOuts) {
+                std::copy(outScratch[j].begin(), outScratch[j].end(), inScratch[j].begin());
+            } else {
+                std::fill(inScratch[j].begin(), inScratch[j].end(), 0.0f);
+            }
+        }
+        return true;
+
+    default:
+        return true;
+    }
+}
+
+void CppNullIO::writeOutput() {
+    uint32_t frames;
+
+    switch (outSink) {
+    case NULLIO_MEMORY:
+        if (numOuts == 0) {
+            return;
+        }
+        frames = (uint32_t) std::min((size_t) blockLen, outLimit-outMemory[0].size());
+        for (uint32_t i=0; i<numOuts; i++) {
+            outMemory[i].insert(outMemory[i].end(), outScratch[i].begin(), outScratch[i].begin()+frames);
+        }
+        return;
+
+    case NULLIO_FILE:
+        writer.write(outPtrs.data(), blockLen);
+        return;
+
+    default:
+        return;
+    }
+}
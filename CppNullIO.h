@@ -0,0 +1,153 @@
+/*------------------------------------------------------------------*\
+Interface to a null/loopback backend for CppRTA that needs no sound
+card, for soak tests, benchmarks and offline renders. Its thread calls
+CppRTA::processBlock() either paced by a steady clock at the block rate
+of the sample rate, like a device would, or as fast as possible
+(freewheel). run() processes blocks synchronously on the calling
+thread instead, which makes a run fully deterministic.
+
+The input is silence, planar float buffers in memory, an audio file
+(see CppAudioFile.h), or the output of the previous block (loopback,
+output i feeds input i). The output is discarded, kept in memory up to
+a given length or written to an audio file. Memory and file inputs end
+the run at their end unless they loop. Files are mapped, float32 files
+with planar channels are processed in place without any copy.
+
+Paced runs count the blocks that missed their deadline as xruns. The
+mean and peak time of processBlock() are measured for every block.
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPNULLIO_H // include guard
+#define _CPPNULLIO_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include "CppAudioBackend.h"
+#include "CppAudioFile.h"
+
+typedef enum {
+    NULLIO_SILENCE = 0x0,
+    NULLIO_MEMORY,
+    NULLIO_FILE,
+    NULLIO_LOOPBACK,
+    NULLIO_DISCARD
+} nullIOPort;
+
+class CppNullIO : public CppAudioBackend {
+
+public:
+    CppNullIO(void);
+
+    ~CppNullIO(void) override;
+
+    // true: one block per block period of the sample rate, false: as fast as possible
+    inline void setRealtime(bool realtime) {
+        this->realtime = realtime;
+    }
+
+    // Stops after numBlocks blocks, 0 runs until the input ends or stop() is called.
+    inline void setMaxBlocks(uint64_t numBlocks) {
+        maxBlocks = numBlocks;
+    }
+
+    inline void setSilentInput() {
+        inSource = NULLIO_SILENCE;
+    }
+
+    inline void setLoopbackInput() {
+        inSource = NULLIO_LOOPBACK;
+    }
+
+    // Planar input, one vector per input channel (missing channels are silent).
+    void setInput(const std::vector< std::vector<float> > &input, bool loop = false);
+
+    // WAV, RF64 or CAF input, any other file is read as raw interleaved float32 with
+    // one value per input channel and frame.
+    void setInputFile(const std::string &path, bool loop = false);
+
+    inline void discardOutput() {
+        outSink = NULLIO_DISCARD;
+    }
+
+    // Keeps up to maxFrames frames of the output, see getOutput().
+    void setOutput(uint32_t maxFrames);
+
+    // Writes the output to a file, raw interleaved float32 by default.
+    void setOutputFile(const std::string &path, audioFileType type = AUDIOFILE_RAW,
+                       sampleFormat format = SAMPLE_FLOAT32);
+
+    // Output kept by setOutput(), complete once the run has ended.
+    inline const std::vector< std::vector<float> > &getOutput() const {
+        return outMemory;
+    }
+
+    // Starts a thread running rta, throws std::invalid_argument if a file cannot be opened.
+    void start(CppRTA *rta) override;
+
+    void stop() override;
+
+    // Processes up to numBlocks blocks on the calling thread without pacing, returns the
+    // number processed. Throws std::invalid_argument if a file cannot be opened.
+    uint64_t run(CppRTA *rta, uint64_t numBlocks);
+
+    inline uint32_t getXrunCount() const override {
+        return xruns.load(std::memory_order_relaxed);
+    }
+
+    inline uint64_t getBlockCount() const {
+        return blocks.load(std::memory_order_relaxed);
+    }
+
+    // true once the input has ended or the block limit is reached
+    inline bool isFinished() const {
+        return finished.load(std::memory_order_acquire);
+    }
+
+    // mean time of processBlock() in seconds
+    inline double getMeanProcessTime() const {
+        uint64_t n = blocks.load(std::memory_order_relaxed);
+        return (n > 0) ? 1e-9*totalNanos.load(std::memory_order_relaxed)/n : 0.0;
+    }
+
+    inline double getMaxProcessTime() const {
+        return 1e-9*maxNanos.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Opens the files and sizes the scratch blocks for rta.
+    void open(CppRTA *rta);
+
+    void close();
+
+    void threadLoop();
+
+    // One block through rta, false if the input has ended.
+    bool processNext();
+
+    bool readInput();
+
+    void writeOutput();
+
+    CppRTA *rta;
+    nullIOPort inSource, outSink;
+    std::string inPath, outPath;
+    audioFileType outType;
+    sampleFormat outFormat;
+    CppAudioFileReader reader;
+    CppAudioFileWriter writer;
+    std::thread thread;
+    std::vector< std::vector<float> > inMemory, outMemory, inScratch, outScratch;
+    std::vector<const float*> inPtrs;
+    std::vector<float*> outPtrs, filePtrs;
+    std::atomic<bool> running, finished;
+    std::atomic<uint32_t> xruns;
+    std::atomic<uint64_t> blocks, totalNanos, maxNanos;
+    uint64_t maxBlocks, inPos;
+    uint32_t outLimit, blockLen, numIns, numOuts;
+    bool realtime, loopInput, inPlace;
+};
+
+#endif // end of include guard
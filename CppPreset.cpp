@@ -0,0 +1,120 @@
+/*------------------------------------------------------------------*\
+Implementation of the preset file I/O.
+\*------------------------------------------------------------------*/
+
+#include <fstream>
+#include <vector>
+#include "CppPreset.h"
+#include "CppRTA.h"
+
+int CppPreset::store(CppRTA *rta, const std::string &path, uint32_t sampleRate) {
+    std::ofstream fStr(path, std::ios::binary | std::ios::trunc);
+    uint32_t numChans, numEQsPerChan, tmpInt;
+    double tmpDouble;
+
+    if (!fStr.good() || rta == nullptr) {
+        return -1;
+    }
+
+    numChans = rta->getNumOuts();
+    fStr.write((char*)&sampleRate, sizeof(uint32_t));
+    fStr.write((char*)&numChans, sizeof(uint32_t));
+    for (uint32_t i=0; i<numChans; i++) {
+        numEQsPerChan = rta->getNumEQs(i);
+        fStr.write((char*)&numEQsPerChan, sizeof(uint32_t));
+        for (uint32_t j=0; j<numEQsPerChan; j++) {
+            tmpDouble = rta->getEqGain(i, j);
+            fStr.write((char*)&tmpDouble, sizeof(double));
+            tmpDouble = rta->getEqFrequency(i, j);
+            fStr.write((char*)&tmpDouble, sizeof(double));
+            tmpDouble = rta->getEqQFactor(i, j);
+            fStr.write((char*)&tmpDouble, sizeof(double));
+            tmpInt = rta->getEqType(i, j);
+            fStr.write((char*)&tmpInt, sizeof(uint32_t));
+        }
+        tmpInt = rta->getCutOrder(HIGHPASS, i);
+        fStr.write((char*)&tmpInt, sizeof(uint32_t));
+        tmpInt = (uint32_t) rta->getCutCharacteristic(HIGHPASS, i);
+        fStr.write((char*)&tmpInt, sizeof(uint32_t));
+        tmpDouble = rta->getCutFrequency(HIGHPASS, i);
+        fStr.write((char*)&tmpDouble, sizeof(double));
+        tmpInt = rta->getCutOrder(LOWPASS, i);
+        fStr.write((char*)&tmpInt, sizeof(uint32_t));
+        tmpInt = (uint32_t) rta->getCutCharacteristic(LOWPASS, i);
+        fStr.write((char*)&tmpInt, sizeof(uint32_t));
+        tmpDouble = rta->getCutFrequency(LOWPASS, i);
+        fStr.write((char*)&tmpDouble, sizeof(double));
+
+        tmpDouble = rta->getThreshold(i);
+        fStr.write((char*)&tmpDouble, sizeof(double));
+        tmpDouble = rta->getMakeupGain(i);
+        fStr.write((char*)&tmpDouble, sizeof(double));
+        tmpDouble = rta->getReleaseTime(i);
+        fStr.write((char*)&tmpDouble, sizeof(double));
+    }
+    return fStr.good() ? 0 : -1;
+}
+
+int CppPreset::load(CppRTA *rta, const std::string &path, uint32_t &sampleRate) {
+    std::ifstream fStr(path, std::ios::binary);
+    uint32_t tmpInt, numChansFile, numEQsPerChan, hiOrd, loOrd, hiChar, loChar;
+    double hiFreq, loFreq, thres, makeup, release;
+    std::vector<eqSettingsRTA> eqs;
+
+    if (!fStr.good() || rta == nullptr) {
+        return -1;
+    }
+
+    CppRTAChangeSet changes = rta->beginChanges();
+    fStr.read((char*)&sampleRate, sizeof(uint32_t));
+    fStr.read((char*)&numChansFile, sizeof(uint32_t));
+    for (uint32_t i=0; fStr.good() && i<rta->getNumOuts() && i<numChansFile; i++) {
+        fStr.read((char*)&numEQsPerChan, sizeof(uint32_t));
+        if (numEQsPerChan > PRESET_MAX_EQS) {
+            fStr.setstate(std::ios::failbit);
+        }
+        if (!fStr.good()) {
+            break;
+        }
+        // a channel is applied only once it has been read completely
+        eqs.resize(numEQsPerChan);
+        for (uint32_t j=0; j<numEQsPerChan; j++) {
+            fStr.read((char*)&eqs[j].gain, sizeof(double));
+            fStr.read((char*)&eqs[j].freq, sizeof(double));
+            fStr.read((char*)&eqs[j].Q, sizeof(double));
+            fStr.read((char*)&tmpInt, sizeof(uint32_t));
+            eqs[j].type = (eqType) tmpInt;
+        }
+        fStr.read((char*)&hiOrd, sizeof(uint32_t));
+        fStr.read((char*)&hiChar, sizeof(uint32_t));
+        fStr.read((char*)&hiFreq, sizeof(double));
+        fStr.read((char*)&loOrd, sizeof(uint32_t));
+        fStr.read((char*)&loChar, sizeof(uint32_t));
+        fStr.read((char*)&loFreq, sizeof(double));
+        fStr.read((char*)&thres, sizeof(double));
+        fStr.read((char*)&makeup, sizeof(double));
+        fStr.read((char*)&release, sizeof(double));
+        if (!fStr.good()) {
+            break;
+        }
+        changes.setNumEQs(i, numEQsPerChan);
+        for (uint32_t j=0; j<numEQsPerChan; j++) {
+            changes.setEq(i, j, eqs[j].type, eqs[j].freq, eqs[j].gain, eqs[j].Q);
+        }
+        changes.setCutParams(HIGHPASS, i, (filterChar) hiChar, hiFreq, hiOrd);
+        changes.setCutParams(LOWPASS, i, (filterChar) loChar, loFreq, loOrd);
+        changes.setThreshold(i, thres);
+        changes.setMakeupGain(i, makeup);
+        changes.setReleaseTime(i, release);
+    }
+    rta->commitChanges(changes);
+    return fStr.good() ? 0 : -1;
+}
+
+int CppPreset::peek(const std::string &path, uint32_t &sampleRate, uint32_t &numChans) {
+    std::ifstream fStr(path, std::ios::binary);
+
+    fStr.read((char*)&sampleRate, sizeof(uint32_t));
+    fStr.read((char*)&numChans, sizeof(uint32_t));
+    return fStr.good() ? 0 : -1;
+}
@@ -0,0 +1,39 @@
+/*------------------------------------------------------------------*\
+Preset files (.vdsp) of virtualDSP, without any Qt dependency, so the
+GUI and virtualDSP-cli share them. A preset holds the sample rate it
+was stored at, the number of output channels and for every channel
+its EQs (gain, frequency, Q, type), both crossovers (order,
+characteristic, frequency) and its limiter (threshold, makeup gain,
+release time) as native binary values.
+
+Loading applies all parameters as one change set. Channels beyond the
+file or beyond the CppRTA instance are left alone.
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPPRESET_H // include guard
+#define _CPPPRESET_H
+
+#include <string>
+#include <cstdint>
+
+// most EQs per channel a preset may hold, more mark a corrupt file
+#define PRESET_MAX_EQS 0x100
+
+class CppRTA;
+
+class CppPreset {
+
+public:
+    // Writes the parameters of rta, -1 if the file cannot be written.
+    static int store(CppRTA *rta, const std::string &path, uint32_t sampleRate);
+
+    // Applies a preset to rta and tells the sample rate it was stored at, -1 if the
+    // file cannot be read, ends early or is corrupt (the complete channels before are
+    // applied anyway).
+    static int load(CppRTA *rta, const std::string &path, uint32_t &sampleRate);
+
+    // Sample rate and number of output channels of a preset, without applying it.
+    static int peek(const std::string &path, uint32_t &sampleRate, uint32_t &numChans);
+};
+
+#endif // end of include guard
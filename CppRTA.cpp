@@ -6,22 +6,47 @@ Author: (c) Hagen Jaeger    January 2017 - Now
 
 #include <stdexcept>
 #include <sstream>
+#include <thread>
+#include <chrono>
 #include "CppRTA.h"
 #include <iostream>
 
 CppRTA::CppRTA(deviceContainerRTA inDev, deviceContainerRTA outDev, uint32_t blockLen, uint32_t fs)
-    : paInStream(nullptr), paOutStream(nullptr), paDuplexStream(nullptr), blockLen(blockLen), fs(fs),
-	  inDev(inDev), outDev(outDev) {
+    : pendingUpdate(nullptr), appliedUpdate(nullptr), blockGuard(false), streamActive(false), chainDirty(true), driftRatio(1.0),
+	  paXruns(0), blockCount(0), dspLoad(0.0f),
+	  paInStream(nullptr), paOutStream(nullptr), paDuplexStream(nullptr), blockLen(blockLen), fs(fs),
+	  inDev(inDev), outDev(outDev), driftCompensation(true), userBackend(false), paAcquired(false) {
+
+#ifdef VDSP_USE_ALSA
+    alsaPeriods = 2;
+    directAlsa = true;
+#endif
 
     if (this->blockLen < 0x20) {
         this->blockLen = 0x20;
     }
 
-    hiPass.resize(outDev.numChans);
-    loPass.resize(outDev.numChans);
-    limiter.resize(outDev.numChans);
-    EQ.resize(outDev.numChans);
-    for (uint32_t i=0; i<outDev.numChans; i++) {
+    resizeOutputs(outDev.numChans);
+    router.setSize(inDev.numChans, outDev.numChans, fs);
+    resizeBuffers(this->blockLen);
+}
+
+void CppRTA::resizeOutputs(uint32_t numOuts) {
+    uint32_t oldOuts = (uint32_t) EQ.size();
+
+    hiPass.resize(numOuts);
+    loPass.resize(numOuts);
+    limiter.resize(numOuts);
+    EQ.resize(numOuts);
+    fir.resize(numOuts);
+    chains.resize(numOuts);
+    smoothing.resize(numOuts, true);
+    channelIrs.resize(numOuts);
+    for (uint32_t i=oldOuts; i<numOuts; i++) {
+        fir.at(i).reset(new CppHybridConv(blockLen));
+        chains.at(i).source = i;
+        chains.at(i).hiPass = chains.at(i).loPass = true;
+        chains.at(i).fused = false;
     	hiPass.at(i).setSampleRate(fs);
     	hiPass.at(i).setType(HIGHPASS);
     	loPass.at(i).setSampleRate(fs);
@@ -29,26 +54,109 @@ CppRTA::CppRTA(deviceContainerRTA inDev, deviceContainerRTA outDev, uint32_t blo
         limiter.at(i).setSampleRate(fs);
         EQ.at(i).resize(1);
         EQ.at(i).at(0).setSampleRate(fs);
+        setSmoothing(i, true);
     }
+}
+
+CppConvolver *CppRTA::newFirMatrix() const {
+    CppConvolver *matrix = new CppConvolver(blockLen, inDev.numChans, outDev.numChans);
 
+    for (uint32_t i=0; i<matrixIrs.size(); i++) {
+        for (uint32_t j=0; j<matrixIrs.at(i).size(); j++) {
+            if (!matrixIrs.at(i).at(j).empty()) {
+                matrix->setFilter(i, j, matrixIrs.at(i).at(j));
+            }
+        }
+    }
+    return matrix;
+}
+
+void CppRTA::resizeBuffers(uint32_t splitTarget) {
     inData.resize(inDev.numChans);
     for (uint32_t i=0; i<inDev.numChans; i++) {
-        inData.at(i).resize(blockLen, 0.0);
+        inData.at(i).assign(blockLen, 0.0);
     }
 
     outData.resize(outDev.numChans);
     for (uint32_t i=0; i<outDev.numChans; i++) {
-        outData.at(i).resize(blockLen, 0.0);
+        outData.at(i).assign(blockLen, 0.0);
+    }
+    outPtrs.assign(outDev.numChans, nullptr);
+
+    splitBuffer.setSize(inDev.numChans, blockLen, splitTarget);
+    asrc.setSize(inDev.numChans, blockLen, fs);
+    asrc.setSetpoint(splitTarget+2.0*blockLen);
+    asrcIn.resize(inDev.numChans);
+    for (uint32_t i=0; i<inDev.numChans; i++) {
+        asrcIn.at(i).assign(asrc.getMaxInput(), 0.0);
     }
+
+    matrixIrs.resize(outDev.numChans);
+    for (uint32_t i=0; i<outDev.numChans; i++) {
+        matrixIrs.at(i).resize(inDev.numChans);
+    }
+    firMatrix.reset(newFirMatrix());
+
+    inMeters.reset(new std::atomic<float>[inDev.numChans]());
+    outMeters.reset(new std::atomic<float>[outDev.numChans]());
+    grMeters.reset(new std::atomic<float>[outDev.numChans]());
+    firLate.reset(new std::atomic<uint32_t>[outDev.numChans]());
+    meterDecay = (float) pow(10.0, -METER_FALLOFF_DB/20.0*blockLen/fs);
 }
 
 void CppRTA::startStream() {
     PaStreamParameters inParams, outParams;
     PaError paErr = paNoError;
 
-    paErr = Pa_Initialize();
-    if (paErr != paNoError) {
-        throw std::invalid_argument(std::string(Pa_GetErrorText(paErr)));
+    // a backend set through setBackend(), or one matching the devices, drives the processing itself
+    if (!userBackend) {
+#ifdef VDSP_USE_JACK
+        // JACK devices run as native client on planar port buffers
+        if (CppJackIO::isJackHostAPI(outDev.hostAPI)) {
+            backend.reset(new CppJackIO());
+        }
+#endif
+#ifdef VDSP_USE_ALSA
+        // hardware devices on one card run directly on the mmap buffers, PortAudio is the fallback
+        std::string capName = CppAlsaIO::getPcmName(inDev), playName = CppAlsaIO::getPcmName(outDev);
+        if (!backend && directAlsa && !playName.empty() &&
+            capName.substr(0, capName.find(',')) == playName.substr(0, playName.find(','))) {
+            CppAlsaIO *alsaIO = new CppAlsaIO();
+            alsaIO->setPeriods(alsaPeriods);
+            alsaIO->setPcmNames(capName, playName);
+            backend.reset(alsaIO);
+        }
+#endif
+    }
+    if (backend) {
+        try {
+            backend->start(this);
+            streamActive.store(true);
+            return;
+        } catch (const std::invalid_argument &) {
+#ifdef VDSP_USE_ALSA
+            if (userBackend || dynamic_cast<CppAlsaIO*>(backend.get()) == nullptr) {
+                throw;
+            }
+            backend.reset();
+#else
+            throw;
+#endif
+        }
+    }
+
+    // PortAudio stays initialized, no device scan before the stream opens. The IDs may
+    // stem from an older scan, the devices are looked up again by name.
+    CppAudioSystem &audioSystem = CppAudioSystem::instance();
+    if (!paAcquired) {
+        paErr = audioSystem.acquire();
+        if (paErr != paNoError) {
+            throw std::invalid_argument(std::string(Pa_GetErrorText(paErr)));
+        }
+        paAcquired = true;
+    }
+    if (audioSystem.resolve(inDev) != 0 || audioSystem.resolve(outDev) != 0) {
+        throw std::invalid_argument("audio device not available anymore");
     }
 
     inParams.device = inDev.ID;
@@ -65,6 +173,11 @@ void CppRTA::startStream() {
 
     paErr = Pa_OpenStream(&paDuplexStream, &inParams, &outParams, fs, blockLen, paNoFlag, duplexCallback, this);
     if(paErr != paNoError) {
+        // separate streams run on their own threads, the input reaches the output through the ring buffer
+        splitBuffer.reset();
+        asrc.setRatio(1.0);
+        asrc.reset();
+        driftRatio.store(1.0);
     	paErr = Pa_OpenStream(&paInStream, &inParams, nullptr, fs, blockLen, paNoFlag, inCallback, this);
     	if(paErr != paNoError) {
     		throw std::invalid_argument(std::string(Pa_GetErrorText(paErr)));
@@ -86,14 +199,26 @@ void CppRTA::startStream() {
 			throw std::invalid_argument(std::string(Pa_GetErrorText(paErr)));
 		}
     }
+    streamActive.store(true);
 }
 
 void CppRTA::stopStream() {
+    streamActive.store(false);
+
+    if (backend) {
+        backend->stop();
+        if (!userBackend) {
+            backend.reset();
+        }
+        return;
+    }
+
     if (paDuplexStream != nullptr) {
         if (Pa_IsStreamActive(paDuplexStream)>0) {
             Pa_AbortStream(paDuplexStream);
         }
         Pa_CloseStream(paDuplexStream);
+        paDuplexStream = nullptr;
     }
 
     if (paInStream != nullptr) {
@@ -101,6 +226,7 @@ void CppRTA::stopStream() {
             Pa_AbortStream(paInStream);
         }
         Pa_CloseStream(paInStream);
+        paInStream = nullptr;
     }
 
     if (paOutStream != nullptr) {
@@ -108,9 +234,70 @@ void CppRTA::stopStream() {
             Pa_AbortStream(paOutStream);
         }
         Pa_CloseStream(paOutStream);
+        paOutStream = nullptr;
     }
 
-    Pa_Terminate();
+    if (paAcquired) {
+        CppAudioSystem::instance().release();
+        paAcquired = false;
+    }
+}
+
+int CppRTA::reconfigure(deviceContainerRTA inDev, deviceContainerRTA outDev, uint32_t blockLen, uint32_t fs) {
+    uint32_t oldIns = this->inDev.numChans, oldOuts = this->outDev.numChans, oldBlockLen = this->blockLen;
+    uint32_t splitTarget = splitBuffer.getTarget();
+    bool rateChanged = fs != this->fs;
+
+    if (streamActive.load()) {
+        return -1;
+    }
+
+    blockLen = std::max(blockLen, 0x20u);
+    // a target left at its default follows the block length
+    if (splitTarget == oldBlockLen) {
+        splitTarget = blockLen;
+    }
+
+    // the stages get their states back before outputs go away, the chains are built anew
+    releaseChains();
+    this->inDev = inDev;
+    this->outDev = outDev;
+    this->blockLen = blockLen;
+    this->fs = fs;
+
+    // only a new sampling rate needs new coefficients, the states are kept either way
+    if (rateChanged) {
+        for (uint32_t i=0; i<std::min(oldOuts, outDev.numChans); i++) {
+            for (uint32_t j=0; j<EQ.at(i).size(); j++) {
+                EQ.at(i).at(j).setSampleRate(fs);
+            }
+            hiPass.at(i).setSampleRate(fs);
+            loPass.at(i).setSampleRate(fs);
+            limiter.at(i).setSampleRate(fs);
+        }
+    }
+
+    // the partitions of the channel FIR filters depend on the block length
+    if (blockLen != oldBlockLen) {
+        for (uint32_t i=0; i<std::min(oldOuts, outDev.numChans); i++) {
+            fir.at(i)->setBlockLen(blockLen);
+            if (!channelIrs.at(i).empty()) {
+                fir.at(i)->setFilter(channelIrs.at(i));
+            }
+        }
+    }
+    resizeOutputs(outDev.numChans);
+
+    if (rateChanged || blockLen != oldBlockLen || inDev.numChans != oldIns || outDev.numChans != oldOuts) {
+        resizeBuffers(splitTarget);
+    }
+    if (rateChanged || inDev.numChans != oldIns || outDev.numChans != oldOuts) {
+        router.resize(inDev.numChans, outDev.numChans, fs);
+    }
+
+    dspLoad.store(0.0f, std::memory_order_relaxed);
+    invalidateChains();
+    return 0;
 }
 
 int CppRTA::duplexCallback(const void *inBuf, void *outBuf,
@@ -119,34 +306,286 @@ int CppRTA::duplexCallback(const void *inBuf, void *outBuf,
                            PaStreamCallbackFlags statusFlag,
                            void *userData)
 {
-    (void) timeInfo; (void) statusFlag;
+    (void) timeInfo;
 
     CppRTA* obj = (CppRTA*) userData;
     float *playData = (float*) outBuf;
     float *recData = (float*) inBuf;
 
+    if (statusFlag & (paInputOverflow | paOutputUnderflow)) {
+        obj->paXruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
     for (uint32_t i = 0; i<obj->blockLen; i++) {
         for (uint32_t j = 0; j<obj->inDev.numChans; j++) {
             obj->inData[j][i] = recData[i*obj->inDev.numChans+j];
         }
     }
 
-    for (uint32_t i = 0; i<obj->outDev.numChans; i++) {
-        obj->outData[i] = obj->inData[i%obj->inDev.numChans];
-        for (uint32_t j=0; j<obj->EQ[i].size(); j++) {
-            obj->EQ[i][j].process(obj->outData[i]);
+    obj->processInterleaved(playData);
+    return paContinue;
+}
+
+void CppRTA::processBlock(const float *const *in, float *const *out, uint32_t outStride) {
+    // planar buffers map onto the channels directly, only the sample type changes
+    for (uint32_t j = 0; j<inDev.numChans; j++) {
+        std::copy(in[j], in[j]+blockLen, inData[j].begin());
+    }
+    processOutputs(out, outStride);
+}
+
+void CppRTA::processInterleaved(float *interleaved) {
+    for (uint32_t i = 0; i<outDev.numChans; i++) {
+        outPtrs[i] = interleaved+i;
+    }
+    processOutputs(outPtrs.data(), outDev.numChans);
+}
+
+void CppRTA::processOutputs(float *const *dest, uint32_t stride) {
+    CppScopedFtz ftz; // decaying filter and limiter states must not turn denormal
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    parameterUpdate *update;
+    uint32_t numOuts = outDev.numChans;
+
+    // the control thread applying an update after a stall is never waited for, the block stays silent
+    if (blockGuard.exchange(true, std::memory_order_acquire)) {
+        for (uint32_t i = 0; i<numOuts; i++) {
+            if (dest != nullptr) {
+                for (uint32_t k = 0; k<blockLen; k++) {
+                    dest[i][k*stride] = 0.0f;
+                }
+            } else {
+                std::fill(outData[i].begin(), outData[i].end(), 0.0);
+            }
+        }
+        return;
+    }
+    update = pendingUpdate.exchange(nullptr, std::memory_order_acq_rel);
+
+    blockCount.fetch_add(1, std::memory_order_relaxed);
+    router.update(blockLen);
+
+    // parameter changes take effect at block boundaries only, the control thread frees them.
+    // The stages get their states back from the fused cascades before they are replaced.
+    if (chainDirty.exchange(false, std::memory_order_acq_rel) || update != nullptr) {
+        releaseChains();
+        if (update != nullptr) {
+            applyUpdate(update);
+            appliedUpdate.store(update, std::memory_order_release);
+            updateApplied.notify_one();
+        }
+        updateChains();
+    }
+
+    // outputs with FIR filters get the sum of their convolved inputs, all others
+    // the mix of the routing matrix
+    firMatrix->process(inData, outData);
+
+    for (uint32_t i = 0; i<outDev.numChans; i++) {
+        const channelChain &chain = chains[i];
+        if (chain.source != i) {
+            continue;
+        }
+        if (!firMatrix->isActive(i)) {
+            router.process(inData, outData[i], i);
+        }
+        fir[i]->process(outData[i]);
+        // the offset fallback adds its offset again behind every stage that may block DC,
+        // the fused cascade behind each of its sections
+        antiDenormal(outData[i]);
+        if (chain.fused) {
+            chains[i].cascade.process(outData[i]);
+        } else {
+            for (uint32_t j=0; j<EQ[i].size(); j++) {
+                if (!EQ[i][j].isBypassed()) {
+                    EQ[i][j].process(outData[i]);
+                    antiDenormal(outData[i]);
+                }
+            }
+            if (chain.hiPass) {
+                hiPass[i].process(outData[i]);
+                antiDenormal(outData[i]);
+            }
+            if (chain.loPass) {
+                loPass[i].process(outData[i]);
+            }
+        }
+        if (dest != nullptr) {
+            limiter[i].process(outData[i], dest[i], stride);
+        } else {
+            limiter[i].process(outData[i]);
         }
-        obj->hiPass[i].process(obj->outData[i]);
-        obj->loPass[i].process(obj->outData[i]);
-        obj->limiter[i].process(obj->outData[i]);
     }
 
-    for (uint32_t i = 0; i<obj->blockLen; i++) {
-        for (uint32_t j = 0; j<obj->outDev.numChans; j++) {
-            playData[i*obj->outDev.numChans+j] = (float) obj->outData[j][i];
+    for (uint32_t i = 0; i<numOuts; i++) {
+        uint32_t source = chains[i].source;
+        if (source == i) {
+            continue;
+        }
+        if (dest != nullptr) {
+            for (uint32_t k = 0; k<blockLen; k++) {
+                dest[i][k*stride] = dest[source][k*stride];
+            }
+        } else {
+            outData[i] = outData[source];
         }
     }
-    return paContinue;
+
+    updateMeters(dest, stride, std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count());
+    blockGuard.store(false, std::memory_order_release);
+}
+
+void CppRTA::updateMeters(float *const *dest, uint32_t stride, double seconds) {
+    float peak;
+
+    // single writer, so a plain load and store keeps the held peak
+    for (uint32_t j = 0; j<inDev.numChans; j++) {
+        peak = 0.0f;
+        for (uint32_t k = 0; k<blockLen; k++) {
+            peak = std::max(peak, (float) fabs(inData[j][k]));
+        }
+        inMeters[j].store(std::max(peak, inMeters[j].load(std::memory_order_relaxed)*meterDecay),
+                          std::memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i<outDev.numChans; i++) {
+        peak = 0.0f;
+        if (dest != nullptr) {
+            for (uint32_t k = 0; k<blockLen; k++) {
+                peak = std::max(peak, fabsf(dest[i][k*stride]));
+            }
+        } else {
+            for (uint32_t k = 0; k<blockLen; k++) {
+                peak = std::max(peak, (float) fabs(outData[i][k]));
+            }
+        }
+        outMeters[i].store(std::max(peak, outMeters[i].load(std::memory_order_relaxed)*meterDecay),
+                           std::memory_order_relaxed);
+        // a fanned out output shows the limiter of the chain it copies
+        grMeters[i].store((float) limiter[chains[i].source].getGainReduction(), std::memory_order_relaxed);
+        firLate[i].store(fir[i]->getLateCount(), std::memory_order_relaxed);
+    }
+    peak = (float) (seconds*fs/blockLen);
+    dspLoad.store(std::max(peak, dspLoad.load(std::memory_order_relaxed)*meterDecay), std::memory_order_relaxed);
+}
+
+static bool sameEQ(const CppEQ &a, const CppEQ &b) {
+    return a.getType() == b.getType() && a.getGain() == b.getGain() && a.getFreq() == b.getFreq()
+            && a.getQFact() == b.getQFact() && a.getTopology() == b.getTopology()
+            && !a.isRamping() && !b.isRamping();
+}
+
+static bool sameCut(const CppXover &a, const CppXover &b) {
+    return a.getChar() == b.getChar() && a.getType() == b.getType() && a.getFreq() == b.getFreq()
+            && a.getOrd() == b.getOrd() && a.getRipple() == b.getRipple()
+            && a.getAttenuation() == b.getAttenuation() && a.getTopology() == b.getTopology()
+            && !a.isFading() && !b.isFading();
+}
+
+bool CppRTA::sameChain(uint32_t chanA, uint32_t chanB) {
+    if (firMatrix->isActive(chanA) || firMatrix->isActive(chanB) || fir[chanA]->isActive() || fir[chanB]->isActive()) {
+        return false;
+    }
+    if (!router.sameRouting(chanA, chanB) || EQ[chanA].size() != EQ[chanB].size()) {
+        return false;
+    }
+    for (uint32_t j=0; j<EQ[chanA].size(); j++) {
+        if (!sameEQ(EQ[chanA][j], EQ[chanB][j])) {
+            return false;
+        }
+    }
+    return sameCut(hiPass[chanA], hiPass[chanB]) && sameCut(loPass[chanA], loPass[chanB])
+            && limiter[chanA].getThres() == limiter[chanB].getThres()
+            && limiter[chanA].getMakeup() == limiter[chanB].getMakeup()
+            && limiter[chanA].getReleaseTime() == limiter[chanB].getReleaseTime();
+}
+
+bool CppRTA::compileChain(uint32_t chanID) {
+    channelChain &chain = chains[chanID];
+
+    chain.cascade.clear();
+    for (uint32_t j=0; j<EQ[chanID].size(); j++) {
+        if (!EQ[chanID][j].isBypassed() && !chain.cascade.append(EQ[chanID][j])) {
+            return false;
+        }
+    }
+    if (chain.hiPass && !chain.cascade.append(hiPass[chanID])) {
+        return false;
+    }
+    if (chain.loPass && !chain.cascade.append(loPass[chanID])) {
+        return false;
+    }
+
+    // a single stage runs faster on its own kernels
+    return chain.cascade.getNumStages() > 1;
+}
+
+void CppRTA::releaseChains() {
+    uint32_t stage;
+
+    // same order and selection of stages as in compileChain()
+    for (uint32_t i = 0; i<outDev.numChans; i++) {
+        channelChain &chain = chains[i];
+        if (!chain.fused) {
+            continue;
+        }
+        stage = 0;
+        for (uint32_t j=0; j<EQ[i].size(); j++) {
+            if (!EQ[i][j].isBypassed()) {
+                chain.cascade.scatter(stage++, EQ[i][j]);
+            }
+        }
+        if (chain.hiPass) {
+            chain.cascade.scatter(stage++, hiPass[i]);
+        }
+        if (chain.loPass) {
+            chain.cascade.scatter(stage++, loPass[i]);
+        }
+        chain.fused = false;
+    }
+}
+
+void CppRTA::updateChains() {
+    uint32_t source, prev;
+    bool recheck = false;
+
+    for (uint32_t i = 0; i<outDev.numChans; i++) {
+        channelChain &chain = chains[i];
+
+        source = i;
+        for (uint32_t k = 0; k<i; k++) {
+            if (chains[k].source == k && sameChain(i, k)) {
+                source = k;
+                break;
+            }
+        }
+
+        // an output computing its own result again continues from the states of its former source
+        prev = chain.source;
+        if (source == i && prev != i) {
+            for (uint32_t j=0; j<EQ[i].size() && j<EQ[prev].size(); j++) {
+                EQ[i][j].copyStates(EQ[prev][j]);
+            }
+            hiPass[i].copyStates(hiPass[prev]);
+            loPass[i].copyStates(loPass[prev]);
+            limiter[i].copyStates(limiter[prev]);
+        }
+        chain.source = source;
+
+        // stages still gliding to their targets are checked again in the next block
+        for (uint32_t j=0; j<EQ[i].size(); j++) {
+            EQ[i][j].updateBypass();
+            recheck = recheck || EQ[i][j].isRamping();
+        }
+        chain.hiPass = !hiPass[i].isIdentity();
+        chain.loPass = !loPass[i].isIdentity();
+        recheck = recheck || hiPass[i].isFading() || loPass[i].isFading() || router.isRamping();
+
+        chain.fused = (source == i) && compileChain(i);
+    }
+
+    if (recheck) {
+        chainDirty.store(true, std::memory_order_release);
+    }
 }
 
 int CppRTA::inCallback(const void *inBuf, void *outBuf,
@@ -155,16 +594,16 @@ int CppRTA::inCallback(const void *inBuf, void *outBuf,
                            PaStreamCallbackFlags statusFlag,
                            void *userData)
 {
-    (void) timeInfo; (void) statusFlag; (void) outBuf;
+    (void) timeInfo; (void) outBuf;
 
     CppRTA* obj = (CppRTA*) userData;
     float *recData = (float*) inBuf;
 
-    for (uint32_t i = 0; i<obj->blockLen; i++) {
-        for (uint32_t j = 0; j<obj->inDev.numChans; j++) {
-            obj->inData[j][i] = recData[i*obj->inDev.numChans+j];
-        }
+    if (statusFlag & paInputOverflow) {
+        obj->paXruns.fetch_add(1, std::memory_order_relaxed);
     }
+
+    obj->splitBuffer.write(recData, obj->blockLen);
     return paContinue;
 }
 
@@ -174,104 +613,279 @@ int CppRTA::outCallback(const void *inBuf, void *outBuf,
                            PaStreamCallbackFlags statusFlag,
                            void *userData)
 {
-    (void) timeInfo; (void) statusFlag; (void) inBuf;
+    (void) timeInfo; (void) inBuf;
 
     CppRTA* obj = (CppRTA*) userData;
     float *playData = (float*) outBuf;
 
-    for (uint32_t i = 0; i<obj->outDev.numChans; i++) {
-        obj->outData[i] = obj->inData[i%obj->inDev.numChans];
-        for (uint32_t j=0; j<obj->EQ[i].size(); j++) {
-            obj->EQ[i][j].process(obj->outData[i]);
-        }
-        obj->hiPass[i].process(obj->outData[i]);
-        obj->loPass[i].process(obj->outData[i]);
-        obj->limiter[i].process(obj->outData[i]);
+    if (statusFlag & paOutputUnderflow) {
+        obj->paXruns.fetch_add(1, std::memory_order_relaxed);
     }
 
-    for (uint32_t i = 0; i<obj->blockLen; i++) {
-        for (uint32_t j = 0; j<obj->outDev.numChans; j++) {
-            playData[i*obj->outDev.numChans+j] = (float) obj->outData[j][i];
+    obj->readSplitInput();
+    obj->processInterleaved(playData);
+    return paContinue;
+}
+
+double CppRTA::getCpuLoad() {
+    double load = 0.0;
+
+    if (!streamActive.load() || backend) {
+        return 0.0;
+    }
+    if (paDuplexStream != nullptr && Pa_IsStreamActive(paDuplexStream) > 0) {
+        return Pa_GetStreamCpuLoad(paDuplexStream);
+    }
+    if (paInStream != nullptr && Pa_IsStreamActive(paInStream) > 0) {
+        load += Pa_GetStreamCpuLoad(paInStream);
+    }
+    if (paOutStream != nullptr && Pa_IsStreamActive(paOutStream) > 0) {
+        load += Pa_GetStreamCpuLoad(paOutStream);
+    }
+    return load;
+}
+
+void CppRTA::readSplitInput() {
+    if (!driftCompensation) {
+        splitBuffer.read(inData, blockLen);
+        return;
+    }
+
+    // both devices run on their own clocks, the converter takes as many input
+    // frames as the fill control loop asks for to produce one output block
+    if (!splitBuffer.isPriming()) {
+        asrc.updateRatio(splitBuffer.getFillEstimate(fs));
+    }
+    if (splitBuffer.read(asrcIn, asrc.inputNeeded(blockLen))) {
+        asrc.process(asrcIn, inData, blockLen);
+    } else {
+        asrc.reset();
+        for (uint32_t j=0; j<inData.size(); j++) {
+            std::fill(inData[j].begin(), inData[j].end(), 0.0);
         }
     }
-    return paContinue;
+    driftRatio.store(asrc.getRatio(), std::memory_order_relaxed);
 }
 
 int CppRTA::getHostAPIs(std::vector<std::string> &apis) {
-    PaError paErr;
-    PaDeviceIndex numDevices;
-    PaHostApiIndex numAPIs;
+    return CppAudioSystem::instance().getHostAPIs(apis);
+}
 
-    paErr = Pa_Initialize();
-    if (paErr != paNoError) {
-        return -1;
+int CppRTA::getDevices(std::vector<deviceContainerRTA> &inDevices,
+                           std::vector<deviceContainerRTA> &outDevices) {
+    return CppAudioSystem::instance().getDevices(inDevices, outDevices);
+}
+
+CppRTAChangeSet CppRTA::beginChanges() {
+    CppRTAChangeSet changes;
+
+    changes.chans.resize(outDev.numChans);
+    for (uint32_t i=0; i<outDev.numChans; i++) {
+        CppRTAChangeSet::channelChanges &chan = changes.chans.at(i);
+        chan.EQ.resize(EQ.at(i).size());
+        for (uint32_t j=0; j<EQ.at(i).size(); j++) {
+            chan.EQ.at(j).gain = EQ.at(i).at(j).getGain();
+            chan.EQ.at(j).freq = EQ.at(i).at(j).getFreq();
+            chan.EQ.at(j).Q = EQ.at(i).at(j).getQFact();
+            chan.EQ.at(j).type = EQ.at(i).at(j).getType();
+        }
+        chan.cut[0].charac = hiPass.at(i).getChar();
+        chan.cut[0].freq = hiPass.at(i).getFreq();
+        chan.cut[0].ord = hiPass.at(i).getOrd();
+        chan.cut[1].charac = loPass.at(i).getChar();
+        chan.cut[1].freq = loPass.at(i).getFreq();
+        chan.cut[1].ord = loPass.at(i).getOrd();
+        chan.thres = limiter.at(i).getThres();
+        chan.makeup = limiter.at(i).getMakeup();
+        chan.release = limiter.at(i).getReleaseTime();
+        chan.eqFlag = chan.cutFlag[0] = chan.cutFlag[1] = chan.limiterFlag = false;
     }
 
-    numDevices = Pa_GetDeviceCount();
-    if (Pa_GetHostApiCount() < 1) {
-        return -2;
+    return changes;
+}
+
+int CppRTA::commitChanges(const CppRTAChangeSet &changes) {
+    parameterUpdate *update = new parameterUpdate;
+    int returnID = 0;
+
+    // design everything here, on the calling thread
+    for (uint32_t i=0; i<changes.chans.size() && i<outDev.numChans; i++) {
+        const CppRTAChangeSet::channelChanges &chan = changes.chans.at(i);
+        if (!chan.eqFlag && !chan.cutFlag[0] && !chan.cutFlag[1] && !chan.limiterFlag) {
+            continue;
+        }
+
+        update->chans.push_back(channelUpdate());
+        channelUpdate &u = update->chans.back();
+        u.chanID = i;
+        u.eqFlag = chan.eqFlag;
+        u.cutFlag[0] = chan.cutFlag[0];
+        u.cutFlag[1] = chan.cutFlag[1];
+        u.limiterFlag = chan.limiterFlag;
+        u.firFlag = false;
+        u.thres = chan.thres;
+        u.makeup = chan.makeup;
+        u.release = chan.release;
+
+        if (chan.eqFlag) {
+            u.EQ.resize(chan.EQ.size());
+            for (uint32_t j=0; j<chan.EQ.size(); j++) {
+                if (j<EQ.at(i).size()) {
+                    u.EQ.at(j).setTopology(EQ.at(i).at(j).getTopology());
+                }
+                if (u.EQ.at(j).setParams(fs, chan.EQ.at(j).gain, chan.EQ.at(j).freq,
+                        chan.EQ.at(j).Q, chan.EQ.at(j).type) < 0) {
+                    returnID = -1;
+                }
+                u.EQ.at(j).setSmoothing(smoothing.at(i));
+            }
+        }
+        u.cut[0].setTopology(hiPass.at(i).getTopology());
+        u.cut[1].setTopology(loPass.at(i).getTopology());
+        for (uint32_t k=0; k<2; k++) {
+            if (chan.cutFlag[k] && u.cut[k].setParams(fs, chan.cut[k].freq, chan.cut[k].charac,
+                    (k == 0) ? HIGHPASS : LOWPASS, chan.cut[k].ord) < 0) {
+                returnID = -1;
+            }
+        }
+        // sizes the crossfade buffers here, so the audio thread does not allocate
+        if (chan.cutFlag[0]) {
+            u.cut[0].prepareTakeOver(hiPass.at(i));
+        }
+        if (chan.cutFlag[1]) {
+            u.cut[1].prepareTakeOver(loPass.at(i));
+        }
     }
 
-    numAPIs = Pa_GetHostApiCount();
-    for (PaHostApiIndex i=0; i<numAPIs; i++) {
-        apis.push_back(std::string(Pa_GetHostApiInfo(i)->name));
+    if (update->chans.empty()) {
+        delete update;
+        return returnID;
     }
 
-    Pa_Terminate();
+    publishUpdate(update);
 
-	return 0;
+    return returnID;
 }
 
-int CppRTA::getDevices(std::vector<deviceContainerRTA> &inDevices,
-                           std::vector<deviceContainerRTA> &outDevices) {
-    PaError paErr;
-    const PaDeviceInfo *paDevInfo;
-    PaDeviceIndex numDevices;
-    deviceContainerRTA devInfo;
-    const uint32_t maxNameLen = 50;
-
-    paErr = Pa_Initialize();
-    if (paErr != paNoError) {
+int CppRTA::setFirFilter(uint32_t chanID, uint32_t inChanID, const std::vector<double> &ir) {
+    if (chanID >= matrixIrs.size() || inChanID >= matrixIrs.at(chanID).size()) {
         return -1;
     }
 
-    numDevices = Pa_GetDeviceCount();
-    if (numDevices < 1) {
-        return -2;
+    // the whole matrix is built on this thread, the callback only swaps it
+    parameterUpdate *update = new parameterUpdate;
+    update->firMatrix.reset(newFirMatrix());
+    int error = update->firMatrix->setFilter(chanID, inChanID, ir);
+    if (error != 0) {
+        delete update;
+        return error;
     }
+    matrixIrs.at(chanID).at(inChanID) = ir;
+    publishUpdate(update);
+    return 0;
+}
 
-    for (PaDeviceIndex i=0; i<numDevices; i++) {
-        paDevInfo = Pa_GetDeviceInfo(i);
+int CppRTA::setChannelFir(uint32_t chanID, const std::vector<double> &ir) {
+    if (chanID >= outDev.numChans) {
+        return -1;
+    }
 
-        devInfo.name = paDevInfo->name;
-        if (devInfo.name.size()>maxNameLen) {
-            devInfo.name = devInfo.name.substr(0, maxNameLen) + std::string("...");
-        }
-        devInfo.ID = i;
-        devInfo.hostAPI = Pa_GetHostApiInfo(paDevInfo->hostApi)->name;
+    parameterUpdate *update = new parameterUpdate;
+    update->chans.push_back(channelUpdate());
+    channelUpdate &u = update->chans.back();
+    u.chanID = chanID;
+    u.eqFlag = u.cutFlag[0] = u.cutFlag[1] = u.limiterFlag = false;
+    u.firFlag = true;
+    u.fir.reset(new CppHybridConv(blockLen));
+    int error = u.fir->setFilter(ir);
+    channelIrs.at(chanID) = (error == 0) ? ir : std::vector<double>();
+    publishUpdate(update);
+    return error;
+}
 
-        if (paDevInfo->maxInputChannels>0) {
-            devInfo.numChans = paDevInfo->maxInputChannels;
-            devInfo.latency = paDevInfo->defaultLowInputLatency;
-            devInfo.inputFlag = true;
-            devInfo.name = std::string("(") + std::to_string(devInfo.ID) + std::string(") ") + devInfo.name
-            		+ std::string("  |  ") + std::to_string(devInfo.numChans) + std::string(" channels");
-            inDevices.push_back(devInfo);
-        }
+int CppRTA::clearChannelFir(uint32_t chanID) {
+    return setChannelFir(chanID, std::vector<double>());
+}
+
+int CppRTA::clearFirFilter(uint32_t chanID, uint32_t inChanID) {
+    if (chanID >= matrixIrs.size() || inChanID >= matrixIrs.at(chanID).size()) {
+        return -1;
+    }
 
-        if (paDevInfo->maxOutputChannels>0) {
-            devInfo.numChans = paDevInfo->maxOutputChannels;
-             devInfo.latency = paDevInfo->defaultLowOutputLatency;
-            devInfo.inputFlag = false;
-            devInfo.name = std::string("(") + std::to_string(devInfo.ID) + std::string(") ") + devInfo.name
-            		+ std::string("  |  ") + std::to_string(devInfo.numChans) + std::string(" channels");
-            outDevices.push_back(devInfo);
+    matrixIrs.at(chanID).at(inChanID).clear();
+    parameterUpdate *update = new parameterUpdate;
+    update->firMatrix.reset(newFirMatrix());
+    publishUpdate(update);
+    return 0;
+}
+
+void CppRTA::publishUpdate(parameterUpdate *update) {
+    std::chrono::duration<double> timeout(std::max(COMMIT_TIMEOUT_BLOCKS*(double) blockLen/fs, COMMIT_TIMEOUT_MIN));
+
+    delete appliedUpdate.exchange(nullptr);
+    if (streamActive.load()) {
+        {
+            std::unique_lock<std::mutex> lock(updateMutex);
+            pendingUpdate.store(update, std::memory_order_release);
+            updateApplied.wait_for(lock, timeout, [this] {
+                return appliedUpdate.load(std::memory_order_acquire) != nullptr;
+            });
+        }
+        // still pending means the callback stalled, it is applied here. One the callback
+        // took is in place a few swaps later.
+        update = pendingUpdate.exchange(nullptr, std::memory_order_acq_rel);
+        while (update == nullptr && appliedUpdate.load(std::memory_order_acquire) == nullptr) {
+            std::this_thread::yield();
         }
     }
 
-    Pa_Terminate();
+    if (update != nullptr) {
+        while (blockGuard.exchange(true, std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        releaseChains();
+        applyUpdate(update);
+        invalidateChains();
+        blockGuard.store(false, std::memory_order_release);
+        delete update;
+    }
+    delete appliedUpdate.exchange(nullptr);
+}
 
-	return 0;
+void CppRTA::applyUpdate(parameterUpdate *update) {
+    uint32_t chanID;
+
+    // swaps only, the replaced filters go back to the control thread with the update
+    for (uint32_t i=0; i<update->chans.size(); i++) {
+        channelUpdate &u = update->chans[i];
+        chanID = u.chanID;
+        if (u.eqFlag) {
+            for (uint32_t j=0; j<u.EQ.size() && j<EQ[chanID].size(); j++) {
+                u.EQ[j].takeOver(EQ[chanID][j]);
+            }
+            EQ[chanID].swap(u.EQ);
+        }
+        if (u.cutFlag[0]) {
+            u.cut[0].takeOver(hiPass[chanID]);
+            std::swap(hiPass[chanID], u.cut[0]);
+        }
+        if (u.cutFlag[1]) {
+            u.cut[1].takeOver(loPass[chanID]);
+            std::swap(loPass[chanID], u.cut[1]);
+        }
+        if (u.limiterFlag) {
+            limiter[chanID].setThreshold(u.thres);
+            limiter[chanID].setMakeupGain(u.makeup);
+            limiter[chanID].setReleaseTime(u.release);
+        }
+        if (u.firFlag) {
+            fir[chanID].swap(u.fir);
+        }
+    }
+    if (update->firMatrix) {
+        update->firMatrix->takeOver(*firMatrix);
+        firMatrix.swap(update->firMatrix);
+    }
 }
 
 int CppRTA::getTransferFunction(std::vector<double> &tf, uint32_t chanID, uint32_t nfft) {
@@ -293,8 +907,29 @@ int CppRTA::getTransferFunction(std::vector<double> &tf, uint32_t chanID, uint32
 	return returnID;
 }
 
+int CppRTA::getTransferFunction(std::vector<float> &tf, uint32_t chanID, uint32_t nfft) {
+    int returnID = 0;
+    if (chanID>=EQ.size()) {
+        return -1;
+    }
+    if (tf.size() != nfft/2+1) {
+        tf.resize(nfft/2+1, 0.0f);
+    }
+
+    returnID += hiPass.at(chanID).addTransferFunction(tf, nfft);
+    returnID += loPass.at(chanID).addTransferFunction(tf, nfft);
+
+    for (uint32_t i=0; i<EQ.at(chanID).size(); i++) {
+        returnID += EQ.at(chanID).at(i).addTransferFunction(tf, nfft);
+    }
+
+	return returnID;
+}
+
 CppRTA::~CppRTA(void) {
     this->stopStream();
+    delete pendingUpdate.exchange(nullptr);
+    delete appliedUpdate.exchange(nullptr);
 }
 
 //--------------------- License ------------------------------------------------
@@ -9,16 +9,209 @@ Author: (c) Hagen Jaeger    January 2017 - Now
 
 #include <vector>
 #include <fstream>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <cstdint>
 #include "portaudio.h"
 #include "CppDSP.h"
+#include "CppConvolver.h"
+#include "CppHybridConv.h"
+#include "CppRouter.h"
+#include "CppRingBuffer.h"
+#include "CppAsrc.h"
+#include "CppDenormal.h"
+#include "CppAudioBackend.h"
+#include "CppAudioSystem.h"
+#include "CppNullIO.h"
+
+// fall-off of the level and load meters after a peak in dB per second, and the level
+// they report for silence in dBFS
+#define METER_FALLOFF_DB 20.0
+#define METER_FLOOR_DB -120.0
+// longest wait for the callback to take parameter changes over, in block periods but at
+// least COMMIT_TIMEOUT_MIN seconds. A callback that stalled longer gets them applied on the
+// control thread.
+#define COMMIT_TIMEOUT_BLOCKS 2
+#define COMMIT_TIMEOUT_MIN 0.005
+#ifdef VDSP_USE_JACK
+#include "CppJackIO.h"
+#endif
+#ifdef VDSP_USE_ALSA
+#include "CppAlsaIO.h"
+#endif
+
+struct eqSettingsRTA {
+    double gain = 0.0;
+    double freq = 1000.0;
+    double Q = 0.71;
+    eqType type = PEAKEQ;
+};
 
-struct deviceContainerRTA {
-    std::string name, hostAPI;
-    double latency;
-    uint32_t ID = 0;
-    uint32_t numChans = 0;
-    bool inputFlag = false;
+struct cutSettingsRTA {
+    filterChar charac = FLAT_THRU;
+    double freq = 1000.0;
+    uint32_t ord = 2;
+};
+
+/*
+ * Collects any number of parameter changes for any number of channels. Obtain one
+ * from CppRTA::beginChanges(), which snapshots the current parameters, and hand it
+ * to CppRTA::commitChanges(), which designs every touched filter once and applies
+ * all of them together at the next block boundary. Setters mirror the CppRTA ones.
+ */
+class CppRTAChangeSet {
+
+public:
+    inline int setNumEQs(uint32_t chanID, uint32_t newSize) {
+        if (chanID<chans.size()) {
+            chans.at(chanID).EQ.resize(newSize);
+            chans.at(chanID).eqFlag = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setEq(uint32_t chanID, uint32_t eqID, eqType type, double freq, double gain, double Q) {
+        if (chanID<chans.size() && eqID<chans.at(chanID).EQ.size()) {
+            eqSettingsRTA &eq = chans.at(chanID).EQ.at(eqID);
+            eq.type = type;
+            eq.freq = freq;
+            eq.gain = gain;
+            eq.Q = Q;
+            chans.at(chanID).eqFlag = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setEqGain(uint32_t chanID, uint32_t eqID, double gain) {
+        if (chanID<chans.size() && eqID<chans.at(chanID).EQ.size()) {
+            chans.at(chanID).EQ.at(eqID).gain = gain;
+            chans.at(chanID).eqFlag = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setEqFrequency(uint32_t chanID, uint32_t eqID, double freq) {
+        if (chanID<chans.size() && eqID<chans.at(chanID).EQ.size()) {
+            chans.at(chanID).EQ.at(eqID).freq = freq;
+            chans.at(chanID).eqFlag = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setEqQFactor(uint32_t chanID, uint32_t eqID, double Q) {
+        if (chanID<chans.size() && eqID<chans.at(chanID).EQ.size()) {
+            chans.at(chanID).EQ.at(eqID).Q = Q;
+            chans.at(chanID).eqFlag = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setEqType(uint32_t chanID, uint32_t eqID, eqType type) {
+        if (chanID<chans.size() && eqID<chans.at(chanID).EQ.size()) {
+            chans.at(chanID).EQ.at(eqID).type = type;
+            chans.at(chanID).eqFlag = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setCutParams(filterType type, uint32_t chanID, filterChar charac, double freq, uint32_t ord) {
+        if (chanID<chans.size() && (type == HIGHPASS || type == LOWPASS)) {
+            cutSettingsRTA &cut = chans.at(chanID).cut[type == HIGHPASS ? 0 : 1];
+            cut.charac = charac;
+            cut.freq = freq;
+            cut.ord = ord;
+            chans.at(chanID).cutFlag[type == HIGHPASS ? 0 : 1] = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setCutCharacteristic(filterType type, uint32_t chanID, filterChar charac) {
+        if (chanID<chans.size() && (type == HIGHPASS || type == LOWPASS)) {
+            chans.at(chanID).cut[type == HIGHPASS ? 0 : 1].charac = charac;
+            chans.at(chanID).cutFlag[type == HIGHPASS ? 0 : 1] = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setCutFrequency(filterType type, uint32_t chanID, double freq) {
+        if (chanID<chans.size() && (type == HIGHPASS || type == LOWPASS)) {
+            chans.at(chanID).cut[type == HIGHPASS ? 0 : 1].freq = freq;
+            chans.at(chanID).cutFlag[type == HIGHPASS ? 0 : 1] = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setCutOrder(filterType type, uint32_t chanID, uint32_t ord) {
+        if (chanID<chans.size() && (type == HIGHPASS || type == LOWPASS)) {
+            chans.at(chanID).cut[type == HIGHPASS ? 0 : 1].ord = ord;
+            chans.at(chanID).cutFlag[type == HIGHPASS ? 0 : 1] = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setThreshold(uint32_t chanID, double thres) {
+        if (chanID<chans.size()) {
+            chans.at(chanID).thres = thres;
+            chans.at(chanID).limiterFlag = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setMakeupGain(uint32_t chanID, double makeupGainLog) {
+        if (chanID<chans.size()) {
+            chans.at(chanID).makeup = makeupGainLog;
+            chans.at(chanID).limiterFlag = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline int setReleaseTime(uint32_t chanID, double secRel) {
+        if (chanID<chans.size()) {
+            chans.at(chanID).release = secRel;
+            chans.at(chanID).limiterFlag = true;
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+private:
+    friend class CppRTA;
+
+    struct channelChanges {
+        std::vector<eqSettingsRTA> EQ;
+        cutSettingsRTA cut[2];
+        double thres, makeup, release;
+        bool eqFlag, cutFlag[2], limiterFlag;
+    };
+
+    std::vector<channelChanges> chans;
 };
 
 class CppRTA {
@@ -27,6 +220,8 @@ public:
 
     CppRTA(deviceContainerRTA inDev, deviceContainerRTA outDev, uint32_t blockLen, uint32_t fs);
 
+    // Host APIs and devices from the cache of CppAudioSystem, PortAudio is initialized
+    // only the first time.
     static int getHostAPIs(std::vector<std::string> &apis);
 
     static int getDevices(std::vector<deviceContainerRTA> &inDevices,
@@ -36,9 +231,53 @@ public:
 
     void stopStream();
 
+    // Moves a stopped instance to other devices, block length or sampling rate and
+    // keeps all parameters, routing gains, FIR filters and filter states. Filters are
+    // designed again only if the sampling rate changes, added outputs start flat.
+    // Returns -1 while streaming.
+    int reconfigure(deviceContainerRTA inDev, deviceContainerRTA outDev, uint32_t blockLen, uint32_t fs);
+
+    // Processes one block of blockLen frames between planar float buffers, for backends
+    // that drive the processing themselves. The samples of an output lie outStride floats
+    // apart, so interleaved hardware buffers can be written in place. Audio thread only,
+    // does not allocate.
+    void processBlock(const float *const *in, float *const *out, uint32_t outStride = 1);
+
+    inline uint32_t getBlockLen() const {
+        return blockLen;
+    }
+
+    inline uint32_t getSampleRate() const {
+        return fs;
+    }
+
+    inline uint32_t getNumIns() const {
+        return inDev.numChans;
+    }
+
+    inline uint32_t getNumOuts() const {
+        return outDev.numChans;
+    }
+
+    // While streaming the parameter setters design through a change set of their own, see
+    // commitChanges(). The running filters and limiters are only touched directly while
+    // stopped.
     inline int setNumEQs(uint32_t chanID, uint32_t newSize) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setNumEQs(chanID, newSize);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
         if (chanID<EQ.size()) {
+            uint32_t oldSize = (uint32_t) EQ.at(chanID).size();
             EQ.at(chanID).resize(newSize);
+            for (uint32_t i=oldSize; i<newSize; i++) {
+                EQ.at(chanID).at(i).setSampleRate(fs);
+            }
+            for (uint32_t i=0; i<newSize; i++) {
+                EQ.at(chanID).at(i).setSmoothing(smoothing.at(chanID));
+            }
+            invalidateChains();
             return 0;
         } else {
             return -1;
@@ -46,8 +285,14 @@ public:
     }
 
     inline int setEqGain(uint32_t chanID, uint32_t eqID, double gain) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setEqGain(chanID, eqID, gain);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
         if (chanID<EQ.size() && eqID<EQ.at(chanID).size()) {
             EQ.at(chanID).at(eqID).setGain(gain);
+            invalidateChains();
             return 0;
         } else {
             return -1;
@@ -55,8 +300,14 @@ public:
     }
 
     inline int setEqFrequency(uint32_t chanID, uint32_t eqID, double freq) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setEqFrequency(chanID, eqID, freq);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
         if (chanID<EQ.size() && eqID<EQ.at(chanID).size()) {
             EQ.at(chanID).at(eqID).setFreq(freq);
+            invalidateChains();
             return 0;
         } else {
             return -1;
@@ -64,8 +315,14 @@ public:
     }
 
     inline int setEqQFactor(uint32_t chanID, uint32_t eqID, double Q) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setEqQFactor(chanID, eqID, Q);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
         if (chanID<EQ.size() && eqID<EQ.at(chanID).size()) {
             EQ.at(chanID).at(eqID).setQFactor(Q);
+            invalidateChains();
             return 0;
         } else {
             return -1;
@@ -73,21 +330,68 @@ public:
     }
 
     inline int setEqType(uint32_t chanID, uint32_t eqID, eqType type) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setEqType(chanID, eqID, type);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
         if (chanID<EQ.size() && eqID<EQ.at(chanID).size()) {
             EQ.at(chanID).at(eqID).setType(type);
+            invalidateChains();
             return 0;
         } else {
             return -1;
         }
     }
 
+    // Resets the filter states, not while streaming.
+    inline int setEqTopology(uint32_t chanID, uint32_t eqID, filterTopology topology) {
+        if (streamActive.load()) {
+            return -1;
+        }
+        if (chanID<EQ.size() && eqID<EQ.at(chanID).size()) {
+            int error = EQ.at(chanID).at(eqID).setTopology(topology);
+            invalidateChains();
+            return error;
+        } else {
+            return -1;
+        }
+    }
+
+    // Resets the filter states, not while streaming.
+    inline int setCutTopology(filterType type, uint32_t chanID, filterTopology topology) {
+        if (streamActive.load()) {
+            return -1;
+        }
+    	if (chanID<hiPass.size() && chanID<loPass.size()) {
+        	if (type == HIGHPASS) {
+        		int error = hiPass.at(chanID).setTopology(topology);
+        		invalidateChains();
+        		return error;
+        	} else if (type == LOWPASS) {
+        		int error = loPass.at(chanID).setTopology(topology);
+        		invalidateChains();
+        		return error;
+        	}
+            return -1;
+        } else {
+            return -1;
+        }
+    }
+
     inline int setCutCharacteristic(filterType type, uint32_t chanID, filterChar charac) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setCutCharacteristic(type, chanID, charac);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
         if (chanID<hiPass.size() && chanID<loPass.size()) {
         	if (type == HIGHPASS) {
         		hiPass.at(chanID).setChar(charac);
         	} else if (type == LOWPASS) {
         		loPass.at(chanID).setChar(charac);
         	}
+            invalidateChains();
             return 0;
         } else {
             return -1;
@@ -95,12 +399,18 @@ public:
     }
 
     inline int setCutFrequency(filterType type, uint32_t chanID, double freq) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setCutFrequency(type, chanID, freq);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
     	if (chanID<hiPass.size() && chanID<loPass.size()) {
         	if (type == HIGHPASS) {
         		hiPass.at(chanID).setFreq(freq);
         	} else if (type == LOWPASS) {
         		loPass.at(chanID).setFreq(freq);
         	}
+            invalidateChains();
             return 0;
         } else {
             return -1;
@@ -108,30 +418,70 @@ public:
     }
 
     inline int setCutOrder(filterType type, uint32_t chanID, uint32_t ord) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setCutOrder(type, chanID, ord);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
     	if (chanID<hiPass.size() && chanID<loPass.size()) {
         	if (type == HIGHPASS) {
         		hiPass.at(chanID).setOrder(ord);
         	} else if (type == LOWPASS) {
         		loPass.at(chanID).setOrder(ord);
         	}
+            invalidateChains();
             return 0;
         } else {
             return -1;
         }
     }
 
+    inline int setCutParams(filterType type, uint32_t chanID, filterChar charac, double freq, uint32_t ord) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setCutParams(type, chanID, charac, freq, ord);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
+    	if (chanID<hiPass.size() && chanID<loPass.size()) {
+        	if (type == HIGHPASS) {
+        		int error = hiPass.at(chanID).setParams(fs, freq, charac, HIGHPASS, ord);
+        		invalidateChains();
+        		return error;
+        	} else if (type == LOWPASS) {
+        		int error = loPass.at(chanID).setParams(fs, freq, charac, LOWPASS, ord);
+        		invalidateChains();
+        		return error;
+        	}
+            return -1;
+        } else {
+            return -1;
+        }
+    }
+
     inline int setThreshold(uint32_t chanID, double thres) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setThreshold(chanID, thres);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
         if (chanID<limiter.size()) {
             limiter.at(chanID).setThreshold(thres);
+            invalidateChains();
             return 0;
         } else {
             return -1;
         }
     }
 
-    inline int setMakeupGain(uint32_t chanID, double makeupGainLog)  {
+    inline int setMakeupGain(uint32_t chanID, double makeupGainLog) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setMakeupGain(chanID, makeupGainLog);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
         if (chanID<limiter.size()) {
             limiter.at(chanID).setMakeupGain(makeupGainLog);
+            invalidateChains();
             return 0;
         } else {
             return -1;
@@ -139,14 +489,207 @@ public:
     }
 
     inline int setReleaseTime(uint32_t chanID, double secRel) {
+        if (streamActive.load()) {
+            CppRTAChangeSet changes = beginChanges();
+            int error = changes.setReleaseTime(chanID, secRel);
+            return (error == 0) ? commitChanges(changes) : error;
+        }
         if (chanID<limiter.size()) {
             limiter.at(chanID).setReleaseTime(secRel);
+            invalidateChains();
             return 0;
         } else {
             return -1;
         }
     }
 
+    // Parameter smoothing of all EQs and cutoffs of a channel, on by default. Not while
+    // streaming.
+    inline int setSmoothing(uint32_t chanID, bool smoothing) {
+        if (streamActive.load()) {
+            return -1;
+        }
+        if (chanID<EQ.size()) {
+            this->smoothing.at(chanID) = smoothing;
+            for (uint32_t i=0; i<EQ.at(chanID).size(); i++) {
+                EQ.at(chanID).at(i).setSmoothing(smoothing);
+            }
+            hiPass.at(chanID).setSmoothing(smoothing);
+            loPass.at(chanID).setSmoothing(smoothing);
+            invalidateChains();
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    inline bool getSmoothing(uint32_t chanID) {
+        return smoothing.at(chanID);
+    }
+
+    // Linear gain of input inChanID on output chanID, 0 disconnects. Changes ramp in.
+    inline int setRoutingGain(uint32_t chanID, uint32_t inChanID, double gain) {
+        int error = router.setGain(chanID, inChanID, gain);
+        invalidateChains();
+        return error;
+    }
+
+    inline int clearRouting(uint32_t chanID) {
+        int error = router.clearOutput(chanID);
+        invalidateChains();
+        return error;
+    }
+
+    // Back to the modulo mapping of outputs to inputs.
+    inline void setDefaultRouting() {
+        router.setDefaultRouting();
+        invalidateChains();
+    }
+
+    inline double getRoutingGain(uint32_t chanID, uint32_t inChanID) {
+        return router.getGain(chanID, inChanID);
+    }
+
+    // Convolves input inChanID into output chanID, the output then ignores the routing
+    // matrix. The matrix is rebuilt here and swapped in at a block boundary.
+    int setFirFilter(uint32_t chanID, uint32_t inChanID, const std::vector<double> &ir);
+
+    int clearFirFilter(uint32_t chanID, uint32_t inChanID);
+
+    // FIR filter of any length in the output chain, before the EQs. The convolver is
+    // built here and swapped in at a block boundary.
+    int setChannelFir(uint32_t chanID, const std::vector<double> &ir);
+
+    int clearChannelFir(uint32_t chanID);
+
+    // Periods a worker level of the channel FIR was muted since the filter was set.
+    inline uint32_t getChannelFirLateCount(uint32_t chanID) {
+        return (chanID < outDev.numChans) ? firLate[chanID].load(std::memory_order_relaxed) : 0;
+    }
+
+    // Frames the ring buffer between separate input and output streams keeps after
+    // every read. Only used if no duplex stream could be opened, not while streaming.
+    inline int setSplitStreamTarget(uint32_t frames) {
+        if (streamActive.load()) {
+            return -1;
+        }
+        asrc.setSetpoint(frames+2.0*blockLen);
+        return splitBuffer.setSize(inDev.numChans, blockLen, frames);
+    }
+
+    // true while separate input and output streams run instead of a duplex stream
+    inline bool isSplitStream() {
+        return streamActive.load() && !backend && paDuplexStream == nullptr && paInStream != nullptr;
+    }
+
+    inline uint32_t getSplitStreamTarget() {
+        return splitBuffer.getTarget();
+    }
+
+    // Latency in frames the split stream ring buffer currently adds.
+    inline uint32_t getSplitStreamFill() {
+        return splitBuffer.getFill();
+    }
+
+    inline uint32_t getSplitStreamUnderruns() {
+        return splitBuffer.getUnderrunCount();
+    }
+
+    inline uint32_t getSplitStreamOverruns() {
+        return splitBuffer.getOverrunCount();
+    }
+
+    // Resamples the input of separate streams to the output clock, steered by the
+    // ring buffer fill. On by default, not while streaming.
+    inline int setDriftCompensation(bool enable) {
+        if (streamActive.load()) {
+            return -1;
+        }
+        driftCompensation = enable;
+        return 0;
+    }
+
+    inline bool getDriftCompensation() {
+        return driftCompensation;
+    }
+
+    // Input frames per output frame of the drift compensation, 1 without drift.
+    inline double getDriftRatio() {
+        return driftRatio.load(std::memory_order_relaxed);
+    }
+
+#ifdef VDSP_USE_ALSA
+    // Runs ALSA hardware devices on one card directly with periods block lengths of
+    // buffer instead of through PortAudio. On by default, not while streaming.
+    inline int setDirectAlsa(bool enable, uint32_t periods = 2) {
+        if (streamActive.load() || periods < 2) {
+            return -1;
+        }
+        directAlsa = enable;
+        alsaPeriods = periods;
+        return 0;
+    }
+
+    inline bool isDirectAlsa() {
+        return dynamic_cast<CppAlsaIO*>(backend.get()) != nullptr;
+    }
+#endif
+
+    // Runs the processing on backend (e.g. a CppNullIO) instead of the devices from the
+    // next startStream() on, CppRTA takes ownership. nullptr returns to the devices.
+    // Not while streaming.
+    inline int setBackend(CppAudioBackend *backend) {
+        if (streamActive.load()) {
+            return -1;
+        }
+        this->backend.reset(backend);
+        userBackend = backend != nullptr;
+        return 0;
+    }
+
+    // backend that drives the processing, nullptr while PortAudio does
+    inline CppAudioBackend *getBackend() {
+        return backend.get();
+    }
+
+    inline uint32_t getBackendXrunCount() {
+        return backend ? backend->getXrunCount() : 0;
+    }
+
+    // Over- and underflows reported by PortAudio plus the xruns of a backend.
+    inline uint32_t getXrunCount() {
+        return paXruns.load(std::memory_order_relaxed)+getBackendXrunCount();
+    }
+
+    // Blocks processed so far, whichever backend drives the processing.
+    inline uint64_t getBlockCount() {
+        return blockCount.load(std::memory_order_relaxed);
+    }
+
+    // Share of the block period PortAudio spends in the callbacks, 0 for other backends.
+    double getCpuLoad();
+
+    // Meters written by the audio thread once per block, safe to read from any thread.
+    // Peaks are held and fall off by METER_FALLOFF_DB per second.
+    inline double getInputPeak(uint32_t chanID) {
+        return meterToDb(inMeters[chanID].load(std::memory_order_relaxed));
+    }
+
+    // Peak level of an output after its limiter, in dBFS.
+    inline double getOutputPeak(uint32_t chanID) {
+        return meterToDb(outMeters[chanID].load(std::memory_order_relaxed));
+    }
+
+    // Gain reduction of the limiter of an output at the end of the last block, in dB.
+    inline double getGainReduction(uint32_t chanID) {
+        return grMeters[chanID].load(std::memory_order_relaxed);
+    }
+
+    // Time the processing of a block takes as share of the block period, any backend.
+    inline double getDspLoad() {
+        return dspLoad.load(std::memory_order_relaxed);
+    }
+
     inline uint32_t getNumChans() {
 		return (uint32_t) EQ.size();
     }
@@ -198,6 +741,19 @@ public:
     		return 0;
     }
 
+    inline filterTopology getEqTopology(uint32_t chanID, uint32_t eqID) {
+		return EQ.at(chanID).at(eqID).getTopology();
+    }
+
+    inline filterTopology getCutTopology(filterType type, uint32_t chanID) {
+    	if (type == HIGHPASS) {
+    		return hiPass.at(chanID).getTopology();
+    	} else if (type == LOWPASS) {
+    		return loPass.at(chanID).getTopology();
+    	} else
+    		return UNKNOWN_TOPOLOGY;
+    }
+
     inline double getThreshold(uint32_t chanID) {
 		return limiter.at(chanID).getThres();
     }
@@ -210,8 +766,17 @@ public:
 		return limiter.at(chanID).getReleaseTime();
     }
 
+    CppRTAChangeSet beginChanges();
+
+    // Designs all touched filters on the calling thread and swaps them in at the next block
+    // boundary. Returns once they are in place, normally within one block period and
+    // after the COMMIT_TIMEOUT at the latest.
+    int commitChanges(const CppRTAChangeSet &changes);
+
     int getTransferFunction(std::vector<double> &tf, uint32_t chanID, uint32_t nfft);
 
+    int getTransferFunction(std::vector<float> &tf, uint32_t chanID, uint32_t nfft);
+
     ~CppRTA(void);
 
 protected:
@@ -235,12 +800,117 @@ protected:
                               void *userData);
 
 private:
+    // designed filters of one channel, waiting to be swapped in by the audio thread
+    struct channelUpdate {
+        uint32_t chanID;
+        bool eqFlag, cutFlag[2], limiterFlag, firFlag;
+        std::vector<CppEQ> EQ;
+        CppXover cut[2];
+        std::unique_ptr<CppHybridConv> fir;
+        double thres, makeup, release;
+    };
+
+    struct parameterUpdate {
+        std::vector<channelUpdate> chans;
+        // replaces the running FIR matrix if set
+        std::unique_ptr<CppConvolver> firMatrix;
+    };
+
+    // Stages every output actually runs. Identity cutoffs are left out (identity EQs mark
+    // themselves as bypassed), an output with the same input and the same chain as a
+    // lower one (source) copies its result. If all remaining EQ and cutoff stages run in
+    // direct form, they are compiled into one fused cascade.
+    struct channelChain {
+        uint32_t source;
+        bool hiPass, loPass, fused;
+        CppFusedCascade cascade;
+    };
+
+    void applyUpdate(parameterUpdate *update);
+
+    // Hands an update to the audio thread and frees it once applied, see commitChanges().
+    void publishUpdate(parameterUpdate *update);
+
+    // A FIR matrix sized to the devices with all filters of matrixIrs.
+    CppConvolver *newFirMatrix() const;
+
+    // Grows or shrinks the per output processors, added outputs get the defaults.
+    void resizeOutputs(uint32_t numOuts);
+
+    // Sizes the block buffers, the ring buffer, the resampler, the FIR matrix and the
+    // meters to the devices and the block length. The FIR matrix gets its filters again.
+    void resizeBuffers(uint32_t splitTarget);
+
+    // Output callback of separate streams: fills inData from the ring buffer.
+    void readSplitInput();
+
+    // Runs all output chains. With destinations (dest[i] points to the first sample of
+    // output i, its samples lie stride floats apart) the limiters write the final samples
+    // straight into them, otherwise outData holds the result.
+    void processOutputs(float *const *dest = nullptr, uint32_t stride = 1);
+
+    // Runs all output chains into an interleaved buffer.
+    void processInterleaved(float *interleaved);
+
+    // Rebuilds the chains on the audio thread, does not allocate.
+    void updateChains();
+
+    bool compileChain(uint32_t chanID);
+
+    // Hands the states of all fused cascades back to their stages.
+    void releaseChains();
+
+    bool sameChain(uint32_t chanA, uint32_t chanB);
+
+    inline void invalidateChains() {
+        chainDirty.store(true, std::memory_order_release);
+    }
+
+    static inline double meterToDb(float peak) {
+        return (peak > 0.0f) ? std::max(20.0*log10(peak), METER_FLOOR_DB) : METER_FLOOR_DB;
+    }
+
+    // Measures the levels and the load of the block just processed, audio thread only.
+    void updateMeters(float *const *dest, uint32_t stride, double seconds);
+
+    std::atomic<parameterUpdate*> pendingUpdate, appliedUpdate;
+    std::mutex updateMutex;
+    std::condition_variable updateApplied;
+    // held by the audio thread for every block, and by the control thread if it applies
+    // an update itself
+    std::atomic<bool> blockGuard;
+    std::atomic<bool> streamActive, chainDirty;
+    std::atomic<double> driftRatio;
+    std::atomic<uint32_t> paXruns;
+    std::atomic<uint64_t> blockCount;
+    std::unique_ptr< std::atomic<float>[] > inMeters, outMeters, grMeters;
+    std::unique_ptr< std::atomic<uint32_t>[] > firLate;
+    std::atomic<float> dspLoad;
+    float meterDecay;
+
     PaStream *paInStream, *paOutStream, *paDuplexStream;
     deviceContainerRTA inDev, outDev;
     std::vector< std::vector<CppEQ> > EQ;
     std::vector<CppXover> hiPass, loPass;
     std::vector<CppLimiter> limiter;
-    std::vector< std::vector<double> > inData, outData;
+    CppRouter router;
+    CppRingBuffer splitBuffer;
+    std::unique_ptr<CppAudioBackend> backend;
+#ifdef VDSP_USE_ALSA
+    uint32_t alsaPeriods;
+    bool directAlsa;
+#endif
+    CppAsrc asrc;
+    std::unique_ptr<CppConvolver> firMatrix;
+    std::vector< std::unique_ptr<CppHybridConv> > fir;
+    std::vector<channelChain> chains;
+    std::vector< std::vector<double> > inData, outData, asrcIn;
+    // impulse responses of the FIR filters, set again when the block length changes
+    std::vector< std::vector<double> > channelIrs;
+    std::vector< std::vector< std::vector<double> > > matrixIrs;
+    std::vector<float*> outPtrs;
+    std::vector<bool> smoothing;
+    bool driftCompensation, userBackend, paAcquired;
     uint32_t fs, blockLen;
 };
 
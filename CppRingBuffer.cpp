@@ -0,0 +1,133 @@
+/*------------------------------------------------------------------*\
+Implementation of a wait-free SPSC ring buffer for interleaved audio.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <cstring>
+#include "CppRingBuffer.h"
+
+CppRingBuffer::CppRingBuffer(void)
+    : writeIdx(0), readIdx(0), underruns(0), overruns(0), overflowed(false), writeTime(0),
+      numChans(0), mask(0), target(0), blockLen(0), priming(true) {
+
+}
+
+CppRingBuffer::CppRingBuffer(uint32_t numChans, uint32_t blockLen, uint32_t target)
+    : writeIdx(0), readIdx(0), underruns(0), overruns(0), overflowed(false), writeTime(0),
+      numChans(0), mask(0), target(0), blockLen(0), priming(true) {
+    setSize(numChans, blockLen, target);
+}
+
+int CppRingBuffer::setSize(uint32_t numChans, uint32_t blockLen, uint32_t target) {
+    uint32_t capacity = 1;
+
+    if (numChans < 1 || blockLen < 1) {
+        return -1;
+    }
+
+    // target plus a block in flight on each side plus one block of jitter, rounded up
+    // to a power of two so the wrapping frame indices map by masking
+    while (capacity < target+4*blockLen) {
+        capacity <<= 1;
+    }
+
+    this->numChans = numChans;
+    this->target = target;
+    this->blockLen = blockLen;
+    mask = capacity-1;
+    buf.assign(capacity*numChans, 0.0f);
+    reset();
+
+    return 0;
+}
+
+void CppRingBuffer::reset() {
+    writeIdx.store(0, std::memory_order_relaxed);
+    readIdx.store(0, std::memory_order_relaxed);
+    underruns.store(0, std::memory_order_relaxed);
+    overruns.store(0, std::memory_order_relaxed);
+    overflowed.store(false, std::memory_order_release);
+    writeTime.store(0, std::memory_order_release);
+    priming = true;
+}
+
+bool CppRingBuffer::write(const float *interleaved, uint32_t frames) {
+    uint32_t wr = writeIdx.load(std::memory_order_relaxed);
+    uint32_t rd = readIdx.load(std::memory_order_acquire);
+    uint32_t pos = wr & mask, first;
+
+    if (buf.empty() || (mask+1)-(wr-rd) < frames) {
+        overruns.fetch_add(1, std::memory_order_relaxed);
+        overflowed.store(true, std::memory_order_release);
+        return false;
+    }
+
+    first = std::min(frames, mask+1-pos);
+    memcpy(&buf[pos*numChans], interleaved, first*numChans*sizeof(float));
+    memcpy(&buf[0], interleaved+first*numChans, (frames-first)*numChans*sizeof(float));
+
+    writeTime.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+    writeIdx.store(wr+frames, std::memory_order_release);
+    return true;
+}
+
+double CppRingBuffer::getFillEstimate(double sampleRate) const {
+    int64_t stamp = writeTime.load(std::memory_order_relaxed), now;
+    uint32_t fill = getFill();
+    double captured;
+
+    // a write between both loads would pair a new fill with an old stamp
+    if (writeTime.load(std::memory_order_acquire) != stamp) {
+        stamp = writeTime.load(std::memory_order_relaxed);
+        fill = getFill();
+    }
+    if (stamp == 0) {
+        return fill;
+    }
+
+    now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    captured = std::min(std::max((now-stamp)*1e-9*sampleRate, 0.0), (double) blockLen);
+    return fill+captured;
+}
+
+bool CppRingBuffer::read(std::vector< std::vector<double> > &planar, uint32_t frames) {
+    uint32_t rd = readIdx.load(std::memory_order_relaxed);
+    uint32_t avail = writeIdx.load(std::memory_order_acquire)-rd;
+    uint32_t chans = std::min(numChans, (uint32_t) planar.size()), pos;
+
+    // the writer dropped data, back to the target instead of keeping the excess latency
+    if (overflowed.exchange(false, std::memory_order_acq_rel) && avail > target+frames) {
+        rd += avail-target-frames;
+        avail = target+frames;
+    }
+
+    if (priming && avail >= target+frames) {
+        priming = false;
+    } else if (!priming && avail < frames) {
+        underruns.fetch_add(1, std::memory_order_relaxed);
+        priming = true;
+    }
+
+    if (priming) {
+        for (uint32_t j=0; j<planar.size(); j++) {
+            std::fill(planar[j].begin(), planar[j].begin()+frames, 0.0);
+        }
+        readIdx.store(rd, std::memory_order_release);
+        return false;
+    }
+
+    for (uint32_t i=0; i<frames; i++) {
+        pos = ((rd+i) & mask)*numChans;
+        for (uint32_t j=0; j<chans; j++) {
+            planar[j][i] = buf[pos+j];
+        }
+    }
+    for (uint32_t j=chans; j<planar.size(); j++) {
+        std::fill(planar[j].begin(), planar[j].begin()+frames, 0.0);
+    }
+
+    readIdx.store(rd+frames, std::memory_order_release);
+    return true;
+}
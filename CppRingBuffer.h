@@ -0,0 +1,88 @@
+/*------------------------------------------------------------------*\
+Interface to a wait-free single producer / single consumer ring buffer
+for interleaved multichannel audio. It bridges two audio callbacks that
+run on different threads, e.g. separate input and output streams.
+
+The writer and the reader each own one frame index; the indices are
+published with release / acquire ordering, so neither side ever waits
+for the other, locks or allocates.
+
+The reader keeps a target fill: it starts (and restarts after an
+underrun) only when the buffer holds the target plus one block, so the
+target is the margin left after every read. On an underrun the reader
+outputs silence and primes again, on an overrun the writer drops its
+block and the reader skips back to the target. Both are counted.
+Nothing else is buffered, the added latency is exactly getFill().
+
+The writer also stamps the time of every write. getFillEstimate() adds
+the frames captured since then, which removes the block quantisation
+from the fill a clock drift control loop observes.
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPRINGBUFFER_H // include guard
+#define _CPPRINGBUFFER_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+
+class CppRingBuffer {
+
+public:
+    CppRingBuffer(void);
+
+    CppRingBuffer(uint32_t numChans, uint32_t blockLen, uint32_t target);
+
+    // Allocates for blocks of up to blockLen frames. Not while the callbacks run.
+    int setSize(uint32_t numChans, uint32_t blockLen, uint32_t target);
+
+    // Empties the buffer and the counters. Not while the callbacks run.
+    void reset();
+
+    // Writer: appends frames, returns false (and drops them) on an overrun.
+    bool write(const float *interleaved, uint32_t frames);
+
+    // Reader: takes frames into planar channels, returns false if it output silence.
+    bool read(std::vector< std::vector<double> > &planar, uint32_t frames);
+
+    inline uint32_t getFill() const {
+        return writeIdx.load(std::memory_order_acquire) - readIdx.load(std::memory_order_acquire);
+    }
+
+    // Reader: fill plus the frames the writer has captured since its last block,
+    // assuming blocks of blockLen frames at sampleRate.
+    double getFillEstimate(double sampleRate) const;
+
+    // Reader: true until the buffer holds the target again after a start or an underrun.
+    inline bool isPriming() const {
+        return priming;
+    }
+
+    inline uint32_t getTarget() const {
+        return target;
+    }
+
+    inline uint32_t getCapacity() const {
+        return mask+1;
+    }
+
+    inline uint32_t getUnderrunCount() const {
+        return underruns.load(std::memory_order_relaxed);
+    }
+
+    inline uint32_t getOverrunCount() const {
+        return overruns.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::vector<float> buf;
+    std::atomic<uint32_t> writeIdx, readIdx;
+    std::atomic<uint32_t> underruns, overruns;
+    std::atomic<bool> overflowed;
+    std::atomic<int64_t> writeTime;
+    uint32_t numChans, mask, target, blockLen;
+    bool priming;
+};
+
+#endif // end of include guard
@@ -0,0 +1,248 @@
+/*------------------------------------------------------------------*\
+Implementation of a sparse routing and mixing matrix with ramped
+crosspoint gains.
+\*------------------------------------------------------------------*/
+
+#include <algorithm>
+#include "CppRouter.h"
+
+CppRouter::CppRouter(void)
+    : table(nullptr), held(nullptr), rampCnt(0), lastLen(0), pending(nullptr), retired(nullptr),
+      numIns(0), numOuts(0), rampLen(441), fs(44100.0), secRamp(0.01) {
+
+}
+
+CppRouter::CppRouter(uint32_t numIns, uint32_t numOuts, double sampleRate)
+    : table(nullptr), held(nullptr), rampCnt(0), lastLen(0), pending(nullptr), retired(nullptr),
+      numIns(0), numOuts(0), rampLen(441), fs(44100.0), secRamp(0.01) {
+    setSize(numIns, numOuts, sampleRate);
+}
+
+CppRouter::~CppRouter(void) {
+    delete pending.exchange(nullptr);
+    delete retired.exchange(nullptr);
+    delete held;
+    delete table;
+}
+
+int CppRouter::setSize(uint32_t numIns, uint32_t numOuts, double sampleRate) {
+    if (numIns < 1 || sampleRate <= 0.0) {
+        return -1;
+    }
+
+    this->numIns = numIns;
+    this->numOuts = numOuts;
+    fs = sampleRate;
+    rampLen = std::max(1u, (uint32_t) (secRamp*fs));
+
+    delete pending.exchange(nullptr);
+    delete retired.exchange(nullptr);
+    delete held;
+    delete table;
+
+    targets.assign(numOuts*numIns, 0.0);
+    for (uint32_t i=0; i<numOuts; i++) {
+        targets[i*numIns+i%numIns] = 1.0;
+    }
+    table = new gainTable;
+    table->gains = targets;
+    table->rampLen = rampLen;
+    current = targets;
+
+    // every output can hold all inputs, so the audio thread never grows a list
+    active.resize(numOuts);
+    for (uint32_t i=0; i<numOuts; i++) {
+        active[i].clear();
+        active[i].reserve(numIns);
+    }
+    rampCnt = 0;
+    lastLen = 0;
+    rebuildActive();
+
+    return 0;
+}
+
+int CppRouter::resize(uint32_t numIns, uint32_t numOuts, double sampleRate) {
+    std::vector<double> oldTargets(targets);
+    uint32_t oldIns = this->numIns, oldOuts = this->numOuts;
+
+    if (setSize(numIns, numOuts, sampleRate) != 0) {
+        return -1;
+    }
+
+    for (uint32_t i=0; i<std::min(oldOuts, numOuts); i++) {
+        for (uint32_t j=0; j<numIns; j++) {
+            targets[i*numIns+j] = (j < oldIns) ? oldTargets[i*oldIns+j] : 0.0;
+        }
+    }
+    table->gains = targets;
+    current = targets;
+    rebuildActive();
+
+    return 0;
+}
+
+int CppRouter::setGain(uint32_t outID, uint32_t inID, double gain) {
+    if (outID >= numOuts || inID >= numIns) {
+        return -1;
+    }
+
+    targets[outID*numIns+inID] = gain;
+    publish();
+    return 0;
+}
+
+double CppRouter::getGain(uint32_t outID, uint32_t inID) const {
+    if (outID >= numOuts || inID >= numIns) {
+        return 0.0;
+    }
+    return targets[outID*numIns+inID];
+}
+
+int CppRouter::clearOutput(uint32_t outID) {
+    if (outID >= numOuts) {
+        return -1;
+    }
+
+    std::fill(targets.begin()+outID*numIns, targets.begin()+(outID+1)*numIns, 0.0);
+    publish();
+    return 0;
+}
+
+void CppRouter::setDefaultRouting() {
+    std::fill(targets.begin(), targets.end(), 0.0);
+    for (uint32_t i=0; i<numOuts; i++) {
+        targets[i*numIns+i%numIns] = 1.0;
+    }
+    publish();
+}
+
+int CppRouter::setRampTime(double secRamp) {
+    if (secRamp < 0.0 || secRamp > 10.0) {
+        return -1;
+    }
+
+    // takes effect with the next gain change
+    this->secRamp = secRamp;
+    rampLen = std::max(1u, (uint32_t) (secRamp*fs));
+    return 0;
+}
+
+void CppRouter::publish() {
+    gainTable *newTable = new gainTable;
+
+    newTable->gains = targets;
+    newTable->rampLen = rampLen;
+
+    // an unused pending table is replaced, the retired slot is emptied after the exchange
+    // so the audio thread can hand back what it holds and take the new table
+    delete pending.exchange(newTable, std::memory_order_acq_rel);
+    delete retired.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void CppRouter::rebuildActive() {
+    crosspoint point;
+    uint32_t idx;
+
+    for (uint32_t i=0; i<numOuts; i++) {
+        active[i].clear();
+        for (uint32_t j=0; j<numIns; j++) {
+            idx = i*numIns+j;
+            if (current[idx] == 0.0 && table->gains[idx] == 0.0) {
+                continue;
+            }
+            point.inID = j;
+            point.gain = current[idx];
+            point.target = table->gains[idx];
+            point.step = (rampCnt > 0) ? (point.target-point.gain)/rampCnt : 0.0;
+            active[i].push_back(point);
+        }
+    }
+}
+
+void CppRouter::update(uint32_t len) {
+    gainTable *newTable, *oldTable, *expected;
+    uint32_t done;
+
+    // the ramps ran through the last block
+    if (rampCnt > 0) {
+        done = std::min(lastLen, rampCnt);
+        rampCnt -= done;
+        for (uint32_t i=0; i<numOuts; i++) {
+            for (uint32_t j=0; j<active[i].size(); j++) {
+                crosspoint &point = active[i][j];
+                point.gain = (rampCnt > 0) ? point.gain+point.step*done : point.target;
+                current[i*numIns+point.inID] = point.gain;
+            }
+        }
+        // drops the crosspoints that faded out
+        if (rampCnt == 0) {
+            rebuildActive();
+        }
+    }
+    lastLen = len;
+
+    // a replaced table goes back through the retired slot. While the control thread has
+    // not emptied it yet, the table is held here and no new one is taken.
+    if (held != nullptr) {
+        expected = nullptr;
+        if (!retired.compare_exchange_strong(expected, held, std::memory_order_acq_rel)) {
+            return;
+        }
+        held = nullptr;
+    }
+    newTable = pending.exchange(nullptr, std::memory_order_acq_rel);
+    if (newTable == nullptr) {
+        return;
+    }
+    if (newTable->gains.size() == current.size()) {
+        oldTable = table;
+        table = newTable;
+        rampCnt = table->rampLen;
+        rebuildActive();
+    } else {
+        oldTable = newTable;
+    }
+    expected = nullptr;
+    if (!retired.compare_exchange_strong(expected, oldTable, std::memory_order_acq_rel)) {
+        held = oldTable;
+    }
+}
+
+void CppRouter::process(const std::vector< std::vector<double> > &in, std::vector<double> &out, uint32_t outID) {
+    uint32_t len = (uint32_t) out.size(), ramp = std::min(len, rampCnt), k;
+    double *y = out.data(), g, step;
+    const double *x;
+
+    std::fill(out.begin(), out.end(), 0.0);
+    if (outID >= numOuts) {
+        return;
+    }
+
+    // plain multiply-accumulate loops, vectorised by the compiler
+    for (uint32_t j=0; j<active[outID].size(); j++) {
+        const crosspoint &point = active[outID][j];
+        x = in[point.inID].data();
+        g = point.gain;
+        step = point.step;
+        for (k=0; k<ramp; k++) {
+            y[k] += (g+step*(k+1))*x[k];
+        }
+        g = (ramp < rampCnt) ? g+step*ramp : point.target;
+        for (; k<len; k++) {
+            y[k] += g*x[k];
+        }
+    }
+}
+
+bool CppRouter::sameRouting(uint32_t outA, uint32_t outB) const {
+    if (outA >= numOuts || outB >= numOuts || rampCnt > 0 || active[outA].size() != active[outB].size()) {
+        return false;
+    }
+    for (uint32_t j=0; j<active[outA].size(); j++) {
+        if (active[outA][j].inID != active[outB][j].inID || active[outA][j].gain != active[outB][j].gain) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+/*------------------------------------------------------------------*\
+Interface to an input x output routing and mixing matrix. Every output
+is the weighted sum of the inputs connected to it, each crosspoint has
+its own gain. Only crosspoints with a gain (or a gain still fading out)
+are visited, so large but sparsely used matrices stay cheap.
+
+Gains are set on the control thread and take effect at the next block
+boundary, where every changed crosspoint ramps linearly from its current
+to its new gain over the ramp time. The audio thread never allocates or
+frees; the gain tables travel through an atomic pointer and go back to
+the control thread for deletion.
+
+Without any setting, output i is connected to input i % numIns with unity
+gain (the former modulo mapping).
+\*------------------------------------------------------------------*/
+
+#ifndef _CPPROUTER_H // include guard
+#define _CPPROUTER_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+class CppRouter {
+
+public:
+    CppRouter(void);
+
+    CppRouter(uint32_t numIns, uint32_t numOuts, double sampleRate);
+
+    ~CppRouter(void);
+
+    // Resets all gains to the modulo mapping. Not while the audio thread processes.
+    int setSize(uint32_t numIns, uint32_t numOuts, double sampleRate);
+
+    // Like setSize(), but crosspoints within both sizes keep their gain (without a
+    // ramp), added outputs get the modulo mapping.
+    int resize(uint32_t numIns, uint32_t numOuts, double sampleRate);
+
+    // Linear gain of input inID on output outID, 0 disconnects.
+    int setGain(uint32_t outID, uint32_t inID, double gain);
+
+    double getGain(uint32_t outID, uint32_t inID) const;
+
+    // Disconnects all inputs of an output.
+    int clearOutput(uint32_t outID);
+
+    // Restores the modulo mapping.
+    void setDefaultRouting();
+
+    int setRampTime(double secRamp);
+
+    uint32_t getNumIns() const { return numIns; }
+    uint32_t getNumOuts() const { return numOuts; }
+
+    // Audio thread: true if two outputs currently get exactly the same mix.
+    bool sameRouting(uint32_t outA, uint32_t outB) const;
+
+    // Audio thread: true while gains are ramping.
+    bool isRamping() const { return rampCnt > 0; }
+
+    // Audio thread: advances the ramps by the last block and takes over new gains.
+    // Call it once per block of len samples before the outputs are mixed.
+    void update(uint32_t len);
+
+    // Audio thread: mixes the connected inputs into output outID.
+    void process(const std::vector< std::vector<double> > &in, std::vector<double> &out, uint32_t outID);
+
+private:
+    struct crosspoint {
+        uint32_t inID;
+        double gain, target, step;
+    };
+
+    // gains to ramp to, with the ramp length set when they were published
+    struct gainTable {
+        std::vector<double> gains;
+        uint32_t rampLen;
+    };
+
+    void publish();
+
+    void rebuildActive();
+
+    // control thread
+    std::vector<double> targets;
+
+    // audio thread
+    gainTable *table, *held;
+    std::vector<double> current;
+    std::vector< std::vector<crosspoint> > active;
+    uint32_t rampCnt, lastLen;
+
+    // the audio thread only fills an empty retired slot and holds a replaced table itself
+    // while the slot is busy, publish() empties it
+    std::atomic<gainTable*> pending, retired;
+    uint32_t numIns, numOuts, rampLen;
+    double fs, secRamp;
+};
+
+#endif // end of include guard
@@ -40,7 +40,17 @@
 #endif
 #define M_PI    3.14159265358979323846
 
-static double *wtable = NULL;
+#ifdef FFT_STATIC_TABLES
+// twiddle table generated at build time by fftTableGen (see CMakeLists.txt)
+extern const int fft_static_table_nfft;
+extern const double fft_static_wtable[];
+
+static const double *wtable = fft_static_wtable;
+#else
+static const double *wtable = NULL;
+#endif
+
+static double *wtable_heap = NULL;
 
 //------------------------------------------------------------------------------
 
@@ -53,33 +63,77 @@ int set_twiddle_table(int max_nfft)
         return -1; //"Error: number of FFT bins must be a power of two (%d)\n"
     }
 
+#ifdef FFT_STATIC_TABLES
+    // the read-only table serves all smaller sizes by stride
+    if (max_nfft <= fft_static_table_nfft)
+    {
+        wtable = fft_static_wtable;
+        return 0;
+    }
+#endif
+
     // real FFT by half-length complex FFT
     nfft = max_nfft/2;
 
-    delete[] wtable;
-    wtable = new double[3*max_nfft/2+1];
+    delete[] wtable_heap;
+    wtable_heap = new double[3*max_nfft/4+1];
 
     // first element is nfft
-    wtable[0] = (double) nfft;
+    wtable_heap[0] = (double) nfft;
 
     // compute exp(jw) table for complex fft
     for (i=0; i<nfft/2; i++)
     {
-        wtable[2*i+1] = cos(2 * i * M_PI / nfft);
-        wtable[2*i+2] = -sin(2 * i * M_PI / nfft);
+        wtable_heap[2*i+1] = cos(2 * i * M_PI / nfft);
+        wtable_heap[2*i+2] = -sin(2 * i * M_PI / nfft);
     }
 
     // compute cos table for real fft
     for (i=0; i<nfft/2; i++)
     {
-        wtable[i+nfft+1] = cos(i * M_PI / nfft);
+        wtable_heap[i+nfft+1] = cos(i * M_PI / nfft);
     }
 
+    wtable = wtable_heap;
+
     return 0;
 }
 
 //------------------------------------------------------------------------------
 
+static int table_stride(int nfft)
+{
+    int i, k;
+
+    // create new table if missing
+    if (wtable == NULL)
+        set_twiddle_table(2*nfft);
+
+    // Table stride
+    k = (int) wtable[0];
+
+    if (k < nfft)
+    {
+        // create new table if too small
+        set_twiddle_table(2*nfft);
+        return 0;
+    }
+
+    // compute table stride
+    i = 0;
+    while (k)
+    {
+        if (k == nfft)
+            return i;
+        k = k >> 1;
+        i++;
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+
 void magnitude(complex_float32 *input, float *result, int n)
 {
     int i;
@@ -126,8 +180,8 @@ int fft(float *input, complex_float32 *spectrum, int n)
     int i, ig, k, l, ngroups, nbutterflies, j, nfft, nstride;
     float tr, ti, rs, is, rd, id, rp, ip, ci, cj;
     complex_float32 ctemp, *x;
-    complex_float64 *w;
-    double *cos2table;
+    const complex_float64 *w;
+    const double *cos2table;
 
     nfft = n/2;
 
@@ -139,35 +193,8 @@ int fft(float *input, complex_float32 *spectrum, int n)
         return -2; //"Error: number of FFT bins must be a power of two (%d)\n"
     }
 
-    // create new table if missing
-    if (wtable == NULL)
-        set_twiddle_table(n);
-
-    // Table stride
-    k = (int) wtable[0];
-
-    if (k < nfft)
-    {
-        // create new table if too small
-        set_twiddle_table(n);
-        nstride = 1;
-    }
-    else
-    {
-        // compute table stride
-        nstride = -1;
-        i = 0;
-        while (k)
-        {
-            if (k == nfft)
-            {
-                nstride = i;
-                break;
-            }
-            k = k >> 1;
-            i++;
-        }
-    }
+    // create or grow table if necessary, compute table stride
+    nstride = table_stride(nfft);
 
     if (nstride < 0)
     {
@@ -179,7 +206,7 @@ int fft(float *input, complex_float32 *spectrum, int n)
         memcpy(spectrum, input, n*sizeof(float));
 
     x = spectrum;
-    w = (complex_float64 *) (wtable + 1);
+    w = (const complex_float64 *) (wtable + 1);
     cos2table = wtable + (nfft << nstride) + 1;
 
     //----- Bit Reverse Section ------------------------------------------------
@@ -310,8 +337,8 @@ int ifft(complex_float32 *spectrum, float *output, int n)
     int i, ig, k, l, ngroups, nbutterflies, j, nfft, nstride;
     float t0, tn, rs, is, rd, id, rp, ip, ci, cj, norm;
     complex_float32 ctemp, *x;
-    complex_float64 *w;
-    double *cos2table;
+    const complex_float64 *w;
+    const double *cos2table;
 
     nfft = n/2;
 
@@ -323,35 +350,8 @@ int ifft(complex_float32 *spectrum, float *output, int n)
         return -2; //"Error: number of FFT bins must be a power of two (%d)\n"
     }
 
-    // create new table if missing
-    if (wtable == NULL)
-        set_twiddle_table(n);
-
-    // Table stride
-    k = (int) wtable[0];
-
-    if (k < nfft)
-    {
-        // create new table if too small
-        set_twiddle_table(n);
-        nstride = 1;
-    }
-    else
-    {
-        // compute table stride
-        nstride = -1;
-        i = 0;
-        while (k)
-        {
-            if (k == nfft)
-            {
-                nstride = i;
-                break;
-            }
-            k = k >> 1;
-            i++;
-        }
-    }
+    // create or grow table if necessary, compute table stride
+    nstride = table_stride(nfft);
 
     if (nstride < 0)
     {
@@ -359,7 +359,7 @@ int ifft(complex_float32 *spectrum, float *output, int n)
     }
 
     x = (complex_float32 *) output;
-    w = (complex_float64 *) (wtable + 1);
+    w = (const complex_float64 *) (wtable + 1);
     cos2table = wtable + (nfft << nstride) + 1;
 
     //----- Half Length Preprocessing ------------------------------------------
@@ -535,8 +535,9 @@ int fft_double(double *input, complex_float64 *spectrum, int n)
 {
     int i, ig, k, l, ngroups, nbutterflies, j, nfft, nstride;
     double tr, ti, rs, is, rd, id, rp, ip, ci, cj;
-    complex_float64 ctemp, *x, *w;
-    double *cos2table;
+    complex_float64 ctemp, *x;
+    const complex_float64 *w;
+    const double *cos2table;
 
     nfft = n/2;
 
@@ -548,35 +549,8 @@ int fft_double(double *input, complex_float64 *spectrum, int n)
         return -2; //"Error: number of FFT bins must be a power of two (%d)\n"
     }
 
-    // create new table if missing
-    if (wtable == NULL)
-        set_twiddle_table(n);
-
-    // Table stride
-    k = (int) wtable[0];
-
-    if (k < nfft)
-    {
-        // create new table if too small
-        set_twiddle_table(n);
-        nstride = 1;
-    }
-    else
-    {
-        // compute table stride
-        nstride = -1;
-        i = 0;
-        while (k)
-        {
-            if (k == nfft)
-            {
-                nstride = i;
-                break;
-            }
-            k = k >> 1;
-            i++;
-        }
-    }
+    // create or grow table if necessary, compute table stride
+    nstride = table_stride(nfft);
 
     if (nstride < 0)
     {
@@ -588,7 +562,7 @@ int fft_double(double *input, complex_float64 *spectrum, int n)
         memcpy(spectrum, input, n*sizeof(double));
 
     x = spectrum;
-    w = (complex_float64 *) (wtable + 1);
+    w = (const complex_float64 *) (wtable + 1);
     cos2table = wtable + (nfft << nstride) + 1;
 
     //----- Bit Reverse Section ------------------------------------------------
@@ -718,8 +692,9 @@ int ifft_double(complex_float64 *spectrum, double *output, int n)
 {
     int i, ig, k, l, ngroups, nbutterflies, j, nfft, nstride;
     double t0, tn, rs, is, rd, id, rp, ip, ci, cj, norm;
-    complex_float64 ctemp, *x, *w;
-    double *cos2table;
+    complex_float64 ctemp, *x;
+    const complex_float64 *w;
+    const double *cos2table;
 
     nfft = n/2;
 
@@ -731,35 +706,8 @@ int ifft_double(complex_float64 *spectrum, double *output, int n)
         return -2; //"Error: number of FFT bins must be a power of two (%d)\n"
     }
 
-    // create new table if missing
-    if (wtable == NULL)
-        set_twiddle_table(n);
-
-    // Table stride
-    k = (int) wtable[0];
-
-    if (k < nfft)
-    {
-        // create new table if too small
-        set_twiddle_table(n);
-        nstride = 1;
-    }
-    else
-    {
-        // compute table stride
-        nstride = -1;
-        i = 0;
-        while (k)
-        {
-            if (k == nfft)
-            {
-                nstride = i;
-                break;
-            }
-            k = k >> 1;
-            i++;
-        }
-    }
+    // create or grow table if necessary, compute table stride
+    nstride = table_stride(nfft);
 
     if (nstride < 0)
     {
@@ -767,7 +715,7 @@ int ifft_double(complex_float64 *spectrum, double *output, int n)
     }
 
     x = (complex_float64 *) output;
-    w = (complex_float64 *) (wtable + 1);
+    w = (const complex_float64 *) (wtable + 1);
     cos2table = wtable + (nfft << nstride) + 1;
 
     //----- Half Length Preprocessing ------------------------------------------
@@ -16,7 +16,8 @@ Example:
     float input[NFFT];
     float output[NFFT];
 
-    // initialization (once)
+    // initialization (once, only needed for sizes beyond the table
+    // generated at build time, see FFT_TABLE_SIZE in CMakeLists.txt)
     set_twiddle_table(MAX_FFT);
 
     // fft computation (for each block)
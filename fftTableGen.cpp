@@ -0,0 +1,82 @@
+/*----------------------------------------------------------------------------*\
+| Build time generator for the static FFT twiddle table                        |
+|                                                                              |
+|   Writes a C++ source file holding the twiddle table for the largest FFT     |
+|   size in exactly the layout produced by set_twiddle_table(), so fft.cpp     |
+|   can use it from read-only memory without any warm-up computation.         |
+|   Every smaller power-of-two size is served from the same table by stride.   |
+|                                                                              |
+|   Usage: fftTableGen <output file> <max nfft>                                |
+\*----------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define M_PI    3.14159265358979323846
+
+//------------------------------------------------------------------------------
+
+static int is_power_of_two(int n)
+{
+    return (n >= 4) && ((n & (n-1)) == 0);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    int i, max_nfft, nfft;
+    FILE *file;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <output file> <max nfft>\n", argv[0]);
+        return 1;
+    }
+
+    max_nfft = atoi(argv[2]);
+    if (!is_power_of_two(max_nfft))
+    {
+        fprintf(stderr, "Error: number of FFT bins must be a power of two (%d)\n", max_nfft);
+        return 1;
+    }
+
+    file = fopen(argv[1], "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error: could not open <%s> for writing\n", argv[1]);
+        return 1;
+    }
+
+    // real FFT by half-length complex FFT
+    nfft = max_nfft/2;
+
+    fprintf(file, "// Generated by fftTableGen, do not edit.\n\n");
+    fprintf(file, "extern const int fft_static_table_nfft = %d;\n\n", max_nfft);
+    fprintf(file, "extern const double fft_static_wtable[%d] = {\n", 3*max_nfft/4+1);
+
+    // first element is nfft
+    fprintf(file, "    %d.0,\n", nfft);
+
+    // exp(jw) table for complex fft
+    for (i=0; i<nfft/2; i++)
+    {
+        fprintf(file, "    %.17g, %.17g,\n", cos(2 * i * M_PI / nfft), -sin(2 * i * M_PI / nfft));
+    }
+
+    // cos table for real fft
+    for (i=0; i<nfft/2; i++)
+    {
+        fprintf(file, "    %.17g,\n", cos(i * M_PI / nfft));
+    }
+
+    fprintf(file, "};\n");
+
+    if (fclose(file) != 0)
+    {
+        return 1;
+    }
+
+    return 0;
+}
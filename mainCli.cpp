@@ -0,0 +1,250 @@
+/*------------------------------------------------------------------*\
+Headless runner of virtualDSP (virtualDSP-cli), without any Qt
+dependency, for systems without a display (e.g. a Raspberry Pi as
+dedicated loudspeaker processor) and for scripted measurements.
+
+It opens the given devices (or the null backend, see CppNullIO.h),
+applies a preset file stored by the GUI, runs until SIGINT/SIGTERM or
+the given duration and prints xruns, CPU load and the latency of split
+streams to stdout every few seconds. Optionally a controller drives it
+remotely over OSC (see CppControl.h).
+\*------------------------------------------------------------------*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <csignal>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include "CppRTA.h"
+#include "CppPreset.h"
+#include "CppControl.h"
+
+static volatile std::sig_atomic_t quitFlag = 0;
+
+static void onSignal(int) {
+    quitFlag = 1;
+}
+
+static void printUsage(const char *name) {
+    std::cout << "Usage: " << name << " [options]\n"
+              << "  -l          list host APIs and devices, then exit\n"
+              << "  -i <id>     input device ID (see -l), default: first input device\n"
+              << "  -o <id>     output device ID (see -l), default: first output device\n"
+              << "  -r <fs>     sample rate, default: the one of the preset, else 48000\n"
+              << "  -b <len>    block length in frames, default: 512\n"
+              << "  -p <file>   preset (.vdsp) to apply, as stored by the GUI\n"
+              << "  -s <sec>    seconds between two statistics lines, 0: none, default: 5\n"
+              << "  -t <sec>    stop after sec seconds, default: run until SIGINT/SIGTERM\n"
+              << "  -n          null backend instead of a sound card\n"
+              << "  -c <num>    channels of the null backend, default: the ones of the preset, else 2\n"
+              << "  -f <file>   input file of the null backend (WAV, RF64, CAF or raw float32)\n"
+              << "  -w <file>   output WAV file of the null backend\n"
+              << "  -x          null backend as fast as possible instead of at the block rate\n"
+              << "  -u <port>   OSC control server on this UDP port\n"
+              << "  -a <addr>   address the control server binds, default: 127.0.0.1\n";
+}
+
+static int listDevices() {
+    std::vector<std::string> apis;
+    std::vector<deviceContainerRTA> inDevices, outDevices;
+
+    if (CppRTA::getHostAPIs(apis) != 0 || CppRTA::getDevices(inDevices, outDevices) != 0) {
+        std::cerr << "Error: Could not query the audio devices." << std::endl;
+        return -1;
+    }
+    std::cout << "Host APIs:" << std::endl;
+    for (uint32_t i=0; i<apis.size(); i++) {
+        std::cout << "  " << apis[i] << std::endl;
+    }
+    std::cout << "Input devices:" << std::endl;
+    for (uint32_t i=0; i<inDevices.size(); i++) {
+        std::cout << "  " << inDevices[i].name << "  |  " << inDevices[i].hostAPI << std::endl;
+    }
+    std::cout << "Output devices:" << std::endl;
+    for (uint32_t i=0; i<outDevices.size(); i++) {
+        std::cout << "  " << outDevices[i].name << "  |  " << outDevices[i].hostAPI << std::endl;
+    }
+    return 0;
+}
+
+// Device with the PortAudio index id, the first one for a negative id.
+static int findDevice(const std::vector<deviceContainerRTA> &devices, long id, deviceContainerRTA &device) {
+    for (uint32_t i=0; i<devices.size(); i++) {
+        if (id < 0 || devices[i].ID == (uint32_t) id) {
+            device = devices[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void printStats(CppRTA *rta, CppNullIO *nullIO, double seconds) {
+    std::cout << std::fixed << std::setprecision(1) << "t=" << seconds << "s"
+              << " blocks=" << rta->getBlockCount()
+              << " xruns=" << rta->getXrunCount();
+    if (nullIO != nullptr) {
+        std::cout << std::setprecision(3) << " process=" << 1e3*nullIO->getMeanProcessTime()
+                  << "/" << 1e3*nullIO->getMaxProcessTime() << "ms";
+    } else {
+        std::cout << std::setprecision(1) << " cpu=" << 100.0*rta->getCpuLoad() << "%";
+    }
+    if (rta->isSplitStream()) {
+        std::cout << std::setprecision(6) << " drift=" << rta->getDriftRatio()
+                  << " fill=" << rta->getSplitStreamFill() << "/" << rta->getSplitStreamTarget()
+                  << " underruns=" << rta->getSplitStreamUnderruns()
+                  << " overruns=" << rta->getSplitStreamOverruns();
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<deviceContainerRTA> inDevices, outDevices;
+    deviceContainerRTA inDevice, outDevice;
+    std::string presetPath, inPath, outPath, controlAddr = "127.0.0.1", arg;
+    long inID = -1, outID = -1;
+    uint32_t fs = 0, presetFs = 0, presetChans = 0, blockLen = 512, numChans = 0, controlPort = 0;
+    double statsInterval = 5.0, duration = 0.0;
+    bool useNull = false, freewheel = false;
+    CppNullIO *nullIO = nullptr;
+    CppControlServer control;
+    CppRTA *rta;
+
+    for (int k=1; k<argc; k++) {
+        arg = argv[k];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "-l") {
+            return (listDevices() == 0) ? 0 : 1;
+        } else if (arg == "-n") {
+            useNull = true;
+        } else if (arg == "-x") {
+            freewheel = true;
+        } else if (arg.size() == 2 && arg[0] == '-' && k+1 < argc) {
+            const char *val = argv[++k];
+            switch (arg[1]) {
+            case 'i': inID = std::strtol(val, nullptr, 10); break;
+            case 'o': outID = std::strtol(val, nullptr, 10); break;
+            case 'r': fs = (uint32_t) std::strtoul(val, nullptr, 10); break;
+            case 'b': blockLen = (uint32_t) std::strtoul(val, nullptr, 10); break;
+            case 'c': numChans = (uint32_t) std::strtoul(val, nullptr, 10); break;
+            case 's': statsInterval = std::strtod(val, nullptr); break;
+            case 't': duration = std::strtod(val, nullptr); break;
+            case 'p': presetPath = val; break;
+            case 'f': inPath = val; break;
+            case 'w': outPath = val; break;
+            case 'u': controlPort = (uint32_t) std::strtoul(val, nullptr, 10); break;
+            case 'a': controlAddr = val; break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!presetPath.empty() && CppPreset::peek(presetPath, presetFs, presetChans) != 0) {
+        std::cerr << "Error: Could not read preset <" << presetPath << ">." << std::endl;
+        return 1;
+    }
+    if (fs == 0) {
+        fs = (presetFs > 0) ? presetFs : 48000;
+    }
+    if (blockLen == 0) {
+        std::cerr << "Error: Block length must not be 0." << std::endl;
+        return 1;
+    }
+
+    if (useNull) {
+        if (numChans == 0) {
+            numChans = (presetChans > 0) ? presetChans : 2;
+        }
+        inDevice.name = outDevice.name = "null";
+        inDevice.numChans = outDevice.numChans = numChans;
+        inDevice.inputFlag = true;
+    } else {
+        if (CppRTA::getDevices(inDevices, outDevices) != 0 ||
+            findDevice(inDevices, inID, inDevice) != 0 || findDevice(outDevices, outID, outDevice) != 0) {
+            std::cerr << "Error: Could not find the audio devices (see -l)." << std::endl;
+            return 1;
+        }
+    }
+
+    rta = new CppRTA(inDevice, outDevice, blockLen, fs);
+    if (!presetPath.empty()) {
+        if (CppPreset::load(rta, presetPath, presetFs) != 0) {
+            std::cerr << "Error: Could not read preset <" << presetPath << ">." << std::endl;
+            delete rta;
+            return 1;
+        }
+        if (presetFs != fs) {
+            std::cout << "Note: Preset was stored at " << presetFs << " Hz, running at " << fs << " Hz." << std::endl;
+        }
+    }
+
+    if (useNull) {
+        nullIO = new CppNullIO();
+        nullIO->setRealtime(!freewheel);
+        if (!inPath.empty()) {
+            nullIO->setInputFile(inPath);
+        }
+        if (!outPath.empty()) {
+            nullIO->setOutputFile(outPath, AUDIOFILE_WAV, SAMPLE_FLOAT32);
+        }
+        rta->setBackend(nullIO);
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    try {
+        rta->startStream();
+    } catch (const std::invalid_argument &e) {
+        std::cerr << "Error: Could not start audio: " << e.what() << std::endl;
+        delete rta;
+        return 1;
+    }
+    if (controlPort > 0) {
+        try {
+            control.start((uint16_t) controlPort, controlAddr);
+        } catch (const std::invalid_argument &e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            delete rta;
+            return 1;
+        }
+        std::cout << "Control server on " << controlAddr << ":" << controlPort << "." << std::endl;
+    }
+    std::cout << "Running " << inDevice.name << " -> " << outDevice.name << " at " << fs
+              << " Hz, " << blockLen << " frames per block." << std::endl;
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now(), lastStats = t0, now;
+    double elapsed;
+    while (!quitFlag && !(nullIO != nullptr && nullIO->isFinished())) {
+        // remote changes are applied on this thread, which also starts and stops rta
+        std::this_thread::sleep_for(std::chrono::milliseconds(control.isRunning() ? 10 : 100));
+        if (control.isRunning()) {
+            control.processCommands(rta);
+        }
+        now = std::chrono::steady_clock::now();
+        elapsed = std::chrono::duration<double>(now-t0).count();
+        if (statsInterval > 0.0 && std::chrono::duration<double>(now-lastStats).count() >= statsInterval) {
+            printStats(rta, nullIO, elapsed);
+            lastStats = now;
+        }
+        if (duration > 0.0 && elapsed >= duration) {
+            break;
+        }
+    }
+
+    control.stop();
+    rta->stopStream();
+    printStats(rta, nullIO, std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count());
+    delete rta;
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <QSizePolicy>
 #include "mainwindow.h"
+#include "CppPreset.h"
 #include <stdexcept>
 
 #define NFFT 0x8000
@@ -85,6 +86,7 @@ MainWindow::MainWindow(int width, int height, QWidget *parent)
     }
 
     CppRTA::getDevices(inDevices, outDevices);
+    deviceGeneration = CppAudioSystem::instance().getGeneration();
     inDevice = inDevices.at(0);
     outDevice = outDevices.at(0);
     rtIO = new CppRTA(inDevice, outDevice, blockLenIO, fs);
@@ -325,6 +327,14 @@ MainWindow::MainWindow(int width, int height, QWidget *parent)
 		connect(copyMenu, SIGNAL(triggered(QAction*)), this, SLOT(copyMenuHandle(QAction*)));
 	}
 
+    // devices plugged in or removed show up in the menus, scanned in the background
+    if (inDeviceMenu != nullptr && outDeviceMenu != nullptr) {
+        connect(inDeviceMenu, SIGNAL(aboutToShow()), this, SLOT(deviceListRequest()));
+        connect(outDeviceMenu, SIGNAL(aboutToShow()), this, SLOT(deviceListRequest()));
+    }
+    connect(&deviceTimer, SIGNAL(timeout()), this, SLOT(deviceListUpdate()));
+    deviceTimer.start(1000);
+
 	this->loadParams("default_params.vdsp");
     statusTxt.clear();
     statusTxt.appendPlainText(QString("Welcome to virtualDSP!") + QString("\n"));
@@ -336,15 +346,21 @@ void MainWindow::inOutButtonHandle() {
 
     if (!streamFlag) {
         inOutButton.setIcon(pauseIcon);
-        if (rtIO != nullptr) {
-        	this->storeParams("params.vdsp");
-            delete rtIO;
-            rtIO = nullptr;
-        }
         try {
-            rtIO = new CppRTA(inDevice, outDevice, blockLenIO, fs);
+#ifdef VDSP_USE_JACK
+            // the native JACK client runs at the period and rate of the server
+            if (CppJackIO::isJackHostAPI(outDevice.hostAPI) && CppJackIO::getServerConfig(blockLenIO, fs) == 0) {
+                statusTxt.appendPlainText(QString("inOutButtonHandle: JACK server runs with ") + QString::number(blockLenIO)
+                                 + QString(" frames at ") + QString::number(fs) + QString(" Hz.") + QString("\n"));
+            }
+#endif
+            // the processing moves to the current settings, parameters and filter states stay
+            if (rtIO == nullptr) {
+                rtIO = new CppRTA(inDevice, outDevice, blockLenIO, fs);
+            } else {
+                rtIO->reconfigure(inDevice, outDevice, blockLenIO, fs);
+            }
             rtIO->startStream();
-            this->loadParams("params.vdsp");
             statusTxt.appendPlainText(QString("inOutButtonHandle: Audio round trip started.") + QString("\n"));
         } catch (const std::exception& err) {
             statusTxt.appendPlainText(QString("inOutButtonHandle: Audio initialization error:\n")+QString(err.what())
@@ -365,7 +381,7 @@ void MainWindow::inOutButtonHandle() {
 
 void MainWindow::plotUpdate() {
     if (rtIO != nullptr) {
-        std::vector<double> transferFcn(NFFT/2+1, 0.0);
+        std::vector<float> transferFcn(NFFT/2+1, 0.0f);
         rtIO->getTransferFunction(transferFcn, actChan, NFFT);
 
         for (unsigned int i=0; i<NFFT/2+1; i++) {
@@ -401,6 +417,26 @@ void MainWindow::deviceMenuUpdate() {
     }
 }
 
+void MainWindow::deviceListUpdate() {
+    uint64_t generation = CppAudioSystem::instance().getGeneration();
+
+    if (generation == deviceGeneration) {
+        return;
+    }
+    deviceGeneration = generation;
+    CppRTA::getDevices(inDevices, outDevices);
+    this->deviceMenuUpdate();
+    statusTxt.appendPlainText(QString("deviceListUpdate: Audio devices changed, ") + QString::number(inDevices.size())
+                     + QString(" inputs and ") + QString::number(outDevices.size()) + QString(" outputs found.") + QString("\n"));
+}
+
+void MainWindow::deviceListRequest() {
+    // a scan restarts PortAudio, only where devices are not watched anyway
+    if (!CppAudioSystem::instance().isWatching()) {
+        CppAudioSystem::instance().requestRefresh();
+    }
+}
+
 void MainWindow::copyMenuUpdate() {
 	if (copyMenu != nullptr) {
 		copyMenu->clear();
@@ -484,9 +520,8 @@ void MainWindow::sampleRateMenuHandle(QAction *currentAction) {
     }
     if (streamFlag) {
         inOutButtonHandle();
-    } else {
-    	inOutButtonHandle();
-    	inOutButtonHandle();
+    } else if (rtIO != nullptr) {
+        rtIO->reconfigure(inDevice, outDevice, blockLenIO, fs);
     }
     this->plotUpdate();
     statusTxt.appendPlainText("sampleRateMenuHandle: Set sampling rate to <" + QString::number(fs) + QString(">.\n"));
@@ -527,21 +562,29 @@ void MainWindow::outDeviceMenuHandle(QAction *currentAction) {
     if (streamFlag) {
         inOutButtonHandle();
     }
+    // the channel widgets address the outputs of the new device right away
+    if (rtIO != nullptr) {
+        rtIO->reconfigure(inDevice, outDevice, blockLenIO, fs);
+    }
     statusTxt.appendPlainText(QString("outDeviceMenuHandle: Changed output device to ") + QString::fromStdString(outDevice.name) + QString("\n"));
 }
 
 void MainWindow::copyMenuHandle(QAction *currentAction) {
 	int copyChan = currentAction->data().toInt();
-	rtIO->setNumEQs(copyChan, rtIO->getNumEQs(actChan));
-	for (unsigned int i=0; i<rtIO->getNumEQs(copyChan); i++) {
-		rtIO->setEqGain(copyChan, i, rtIO->getEqGain(actChan, i));
-		rtIO->setEqFrequency(copyChan, i, rtIO->getEqFrequency(actChan, i));
-		rtIO->setEqQFactor(copyChan, i, rtIO->getEqQFactor(actChan, i));
-		rtIO->setEqType(copyChan, i, rtIO->getEqType(actChan, i));
+	CppRTAChangeSet changes = rtIO->beginChanges();
+	changes.setNumEQs(copyChan, rtIO->getNumEQs(actChan));
+	for (unsigned int i=0; i<rtIO->getNumEQs(actChan); i++) {
+		changes.setEq(copyChan, i, rtIO->getEqType(actChan, i), rtIO->getEqFrequency(actChan, i),
+				rtIO->getEqGain(actChan, i), rtIO->getEqQFactor(actChan, i));
 	}
-	rtIO->setThreshold(copyChan, rtIO->getThreshold(actChan));
-	rtIO->setMakeupGain(copyChan, rtIO->getMakeupGain(actChan));
-	rtIO->setReleaseTime(copyChan, rtIO->getReleaseTime(actChan));
+	changes.setCutParams(HIGHPASS, copyChan, rtIO->getCutCharacteristic(HIGHPASS, actChan),
+			rtIO->getCutFrequency(HIGHPASS, actChan), rtIO->getCutOrder(HIGHPASS, actChan));
+	changes.setCutParams(LOWPASS, copyChan, rtIO->getCutCharacteristic(LOWPASS, actChan),
+			rtIO->getCutFrequency(LOWPASS, actChan), rtIO->getCutOrder(LOWPASS, actChan));
+	changes.setThreshold(copyChan, rtIO->getThreshold(actChan));
+	changes.setMakeupGain(copyChan, rtIO->getMakeupGain(actChan));
+	changes.setReleaseTime(copyChan, rtIO->getReleaseTime(actChan));
+	rtIO->commitChanges(changes);
     statusTxt.appendPlainText(QString("copyMenuHandle: Copied settings from channel <") + QString::number(actChan+1)
                     + QString("> to <") + QString::number(copyChan+1) + QString(">.") + QString("\n"));
 }
@@ -565,32 +608,34 @@ void MainWindow::channelWidgetHandle(double chanNr) {
 
 void MainWindow::eqNrWidgetHandle(double eqNr) {
     actEQ.at(actChan) = (unsigned int) eqNr-1;
+    CppRTAChangeSet changes = rtIO->beginChanges();
     if (rtIO->getNumEQs(actChan) < eqNr) {
         if (rtIO != nullptr) {
-            rtIO->setNumEQs(actChan, eqNr);
+            changes.setNumEQs(actChan, eqNr);
         } else {
         	statusTxt.appendPlainText(QString("eqNrWidgetHandle: Error setting EQ Number: Audio instance not initialized. Try restarting."));
         }
     } else {
     	unsigned int i=0;
     	for (i=rtIO->getNumEQs(actChan)-1; qAbs(rtIO->getEqGain(actChan, i))<0.01 && rtIO->getEqType(actChan, i)>NOTCH && i>=eqNr; i--) {
-			rtIO->setNumEQs(actChan, i);
+			changes.setNumEQs(actChan, i);
     	}
     }
     if (stereoLockFlag && actChan+1<outDevice.numChans) {
         actEQ.at(actChan+1) = (unsigned int) eqNr-1;
         if (rtIO->getNumEQs(actChan+1) < eqNr) {
             if (rtIO != nullptr) {
-                rtIO->setNumEQs(actChan+1, eqNr);
+                changes.setNumEQs(actChan+1, eqNr);
             }  else {
             	statusTxt.appendPlainText(QString("eqNrWidgetHandle: Error setting EQ Number: Audio instance not initialized. Try restarting."));
             }
         } else {
         	unsigned int i=0;
         	for (i=rtIO->getNumEQs(actChan+1)-1; qAbs(rtIO->getEqGain(actChan+1, i))<0.01 && rtIO->getEqType(actChan+1, i)>NOTCH && i>eqNr; i--) {}
-        	rtIO->setNumEQs(actChan+1, i);
+        	changes.setNumEQs(actChan+1, i);
         }
     }
+    rtIO->commitChanges(changes);
     this->updateEQWidgets();
     this->plotUpdate();
     statusTxt.appendPlainText(QString("eqNrWidgetHandle: Set EQ nr. of channel ") + QString::number(actChan+1)
@@ -599,10 +644,12 @@ void MainWindow::eqNrWidgetHandle(double eqNr) {
 
 void MainWindow::eqGainWidgetHandle(double gain) {
     if (rtIO != nullptr) {
-        rtIO->setEqGain(actChan, actEQ.at(actChan), gain);
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setEqGain(actChan, actEQ.at(actChan), gain);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setEqGain(actChan+1, actEQ.at(actChan+1), gain);
+        	changes.setEqGain(actChan+1, actEQ.at(actChan+1), gain);
         }
+        rtIO->commitChanges(changes);
         statusTxt.appendPlainText(QString("eqGainWidgetHandle: Set gain of EQ ") + QString::number(actEQ.at(actChan)+1) + QString(" of channel ")
                           + QString::number(actChan+1) + QString(" to ") + QString::number(rtIO->getEqGain(actChan, actEQ.at(actChan)))
                           + QString(", ") + QString::number(rtIO->getNumEQs(actChan)) + QString(" EQs allocated.") + QString("\n"));
@@ -614,10 +661,12 @@ void MainWindow::eqGainWidgetHandle(double gain) {
 
 void MainWindow::eqFreqWidgetHandle(double freq) {
     if (rtIO != nullptr) {
-        rtIO->setEqFrequency(actChan, actEQ.at(actChan), freq);
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setEqFrequency(actChan, actEQ.at(actChan), freq);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setEqFrequency(actChan+1, actEQ.at(actChan+1), freq);
+        	changes.setEqFrequency(actChan+1, actEQ.at(actChan+1), freq);
         }
+        rtIO->commitChanges(changes);
         statusTxt.appendPlainText(QString("eqFreqWidgetHandle: Set frequency of EQ ") + QString::number(actEQ.at(actChan)+1) + QString(" of channel ")
                           + QString::number(actChan+1) + QString(" to ") + QString::number(rtIO->getEqFrequency(actChan, actEQ.at(actChan)))
                           + QString(", ") + QString::number(rtIO->getNumEQs(actChan)) + QString(" EQs allocated.") + QString("\n"));
@@ -629,10 +678,12 @@ void MainWindow::eqFreqWidgetHandle(double freq) {
 
 void MainWindow::eqQFactWidgetHandle(double QFact) {
     if (rtIO != nullptr) {
-        rtIO->setEqQFactor(actChan, actEQ.at(actChan), QFact);
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setEqQFactor(actChan, actEQ.at(actChan), QFact);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setEqQFactor(actChan+1, actEQ.at(actChan+1), QFact);
+        	changes.setEqQFactor(actChan+1, actEQ.at(actChan+1), QFact);
         }
+        rtIO->commitChanges(changes);
         statusTxt.appendPlainText(QString("eqQFactWidgetHandle: Set QFactor of EQ ") + QString::number(actEQ.at(actChan)+1) + QString(" of channel ")
                           + QString::number(actChan+1) + QString(" to ") + QString::number(rtIO->getEqQFactor(actChan, actEQ.at(actChan)))
                           + QString(", ") + QString::number(rtIO->getNumEQs(actChan)) + QString(" EQs allocated.") + QString("\n"));
@@ -645,11 +696,13 @@ void MainWindow::eqQFactWidgetHandle(double QFact) {
 void MainWindow::eqTypeWidgetHandle(double type) {
 	eqType castedType = (eqType) ((int) type);
     if (rtIO != nullptr) {
-        rtIO->setEqType(actChan, actEQ.at(actChan), castedType);
-        this->eqTypeWidget.setValueText(QString::fromStdString(std::string(CppEQ::getTypeName(castedType))));
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setEqType(actChan, actEQ.at(actChan), castedType);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setEqType(actChan+1, actEQ.at(actChan+1), castedType);
+        	changes.setEqType(actChan+1, actEQ.at(actChan+1), castedType);
         }
+        rtIO->commitChanges(changes);
+        this->eqTypeWidget.setValueText(QString::fromStdString(std::string(CppEQ::getTypeName(castedType))));
         statusTxt.appendPlainText(QString("eqTypeWidgetHandle: Set type of EQ ") + QString::number(actEQ.at(actChan)+1) + QString(" of channel ")
                           + QString::number(actChan+1) + QString(" to ")
 						  + QString::fromStdString(CppEQ::getTypeName(rtIO->getEqType(actChan, actEQ.at(actChan))))
@@ -663,11 +716,13 @@ void MainWindow::eqTypeWidgetHandle(double type) {
 void MainWindow::hiPassCharWidgetHandle(double charac) {
 	filterChar castedCharac = (filterChar) ((int) charac);
     if (rtIO != nullptr) {
-        rtIO->setCutCharacteristic(HIGHPASS, actChan, castedCharac);
-        hiPassCharWidget.setValueText(QString::fromStdString(std::string(CppXover::getCharName(castedCharac))));
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setCutCharacteristic(HIGHPASS, actChan, castedCharac);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setCutCharacteristic(HIGHPASS, actChan+1, (filterChar) ((int) charac));
+        	changes.setCutCharacteristic(HIGHPASS, actChan+1, (filterChar) ((int) charac));
         }
+        rtIO->commitChanges(changes);
+        hiPassCharWidget.setValueText(QString::fromStdString(std::string(CppXover::getCharName(castedCharac))));
         statusTxt.appendPlainText(QString("hiPassCharWidgetHandle: Set high pass characteristics of channel ") + QString::number(actChan+1)
         						  + QString(" to ") + QString::fromStdString(CppXover::getCharName(rtIO->getCutCharacteristic(HIGHPASS, actChan))) + QString("\n"));
     } else {
@@ -678,10 +733,12 @@ void MainWindow::hiPassCharWidgetHandle(double charac) {
 
 void MainWindow::hiPassFreqWidgetHandle(double freq) {
     if (rtIO != nullptr) {
-        rtIO->setCutFrequency(HIGHPASS, actChan, freq);
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setCutFrequency(HIGHPASS, actChan, freq);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setCutFrequency(HIGHPASS, actChan+1, freq);
+        	changes.setCutFrequency(HIGHPASS, actChan+1, freq);
         }
+        rtIO->commitChanges(changes);
         statusTxt.appendPlainText(QString("hiPassFreqWidgetHandle: Set high pass frequency of channel ") + QString::number(actChan+1)
         						  + QString(" to ") + QString::number(rtIO->getCutFrequency(HIGHPASS, actChan)) + QString("\n"));
     } else {
@@ -692,10 +749,12 @@ void MainWindow::hiPassFreqWidgetHandle(double freq) {
 
 void MainWindow::hiPassOrdWidgetHandle(double ord) {
     if (rtIO != nullptr) {
-        rtIO->setCutOrder(HIGHPASS, actChan, ord);
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setCutOrder(HIGHPASS, actChan, ord);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setCutOrder(HIGHPASS, actChan+1, ord);
+        	changes.setCutOrder(HIGHPASS, actChan+1, ord);
         }
+        rtIO->commitChanges(changes);
         statusTxt.appendPlainText(QString("hiPassOrdWidgetHandle: Set high pass order of channel ") + QString::number(actChan+1)
         						  + QString(" to ") + QString::number(rtIO->getCutOrder(HIGHPASS, actChan)) + QString("\n"));
     } else {
@@ -707,11 +766,13 @@ void MainWindow::hiPassOrdWidgetHandle(double ord) {
 void MainWindow::loPassCharWidgetHandle(double charac) {
 	filterChar castedCharac = (filterChar) ((int) charac);
     if (rtIO != nullptr) {
-        rtIO->setCutCharacteristic(LOWPASS, actChan, castedCharac);
-        loPassCharWidget.setValueText(QString::fromStdString(std::string(CppXover::getCharName(castedCharac))));
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setCutCharacteristic(LOWPASS, actChan, castedCharac);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setCutCharacteristic(LOWPASS, actChan+1, (filterChar) ((int) charac));
+        	changes.setCutCharacteristic(LOWPASS, actChan+1, (filterChar) ((int) charac));
         }
+        rtIO->commitChanges(changes);
+        loPassCharWidget.setValueText(QString::fromStdString(std::string(CppXover::getCharName(castedCharac))));
         statusTxt.appendPlainText(QString("loPassCharWidgetHandle: Set low pass characteristics of channel ") + QString::number(actChan+1)
         						  + QString(" to ") + QString::fromStdString(CppXover::getCharName(rtIO->getCutCharacteristic(LOWPASS, actChan))) + QString("\n"));
     } else {
@@ -722,10 +783,12 @@ void MainWindow::loPassCharWidgetHandle(double charac) {
 
 void MainWindow::loPassFreqWidgetHandle(double freq) {
     if (rtIO != nullptr) {
-        rtIO->setCutFrequency(LOWPASS, actChan, freq);
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setCutFrequency(LOWPASS, actChan, freq);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setCutFrequency(LOWPASS, actChan+1, freq);
+        	changes.setCutFrequency(LOWPASS, actChan+1, freq);
         }
+        rtIO->commitChanges(changes);
         statusTxt.appendPlainText(QString("loPassFreqWidgetHandle: Set low pass frequency of channel ") + QString::number(actChan+1)
         						  + QString(" to ") + QString::number(rtIO->getCutFrequency(LOWPASS, actChan)) + QString("\n"));
     } else {
@@ -736,10 +799,12 @@ void MainWindow::loPassFreqWidgetHandle(double freq) {
 
 void MainWindow::loPassOrdWidgetHandle(double ord) {
     if (rtIO != nullptr) {
-        rtIO->setCutOrder(LOWPASS, actChan, ord);
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setCutOrder(LOWPASS, actChan, ord);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setCutOrder(LOWPASS, actChan+1, ord);
+        	changes.setCutOrder(LOWPASS, actChan+1, ord);
         }
+        rtIO->commitChanges(changes);
         statusTxt.appendPlainText(QString("loPassOrdWidgetHandle: Set low pass order of channel ") + QString::number(actChan+1)
         						  + QString(" to ") + QString::number(rtIO->getCutOrder(LOWPASS, actChan)) + QString("\n"));
     } else {
@@ -750,10 +815,12 @@ void MainWindow::loPassOrdWidgetHandle(double ord) {
 
 void MainWindow::limitThresWidgetHandle(double thres) {
     if (rtIO != nullptr) {
-        rtIO->setThreshold(actChan, thres);
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setThreshold(actChan, thres);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setThreshold(actChan+1, thres);
+        	changes.setThreshold(actChan+1, thres);
         }
+        rtIO->commitChanges(changes);
         statusTxt.appendPlainText(QString("limitThresWidgetHandle: Set limiter threshold of channel ") + QString::number(actChan+1)
 						  + QString(" to ") + QString::number(rtIO->getThreshold(actChan)) + QString("\n"));
     } else {
@@ -763,10 +830,12 @@ void MainWindow::limitThresWidgetHandle(double thres) {
 
 void MainWindow::limitMakeupWidgetHandle(double gain) {
     if (rtIO != nullptr) {
-        rtIO->setMakeupGain(actChan, gain);
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setMakeupGain(actChan, gain);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setMakeupGain(actChan+1, gain);
+        	changes.setMakeupGain(actChan+1, gain);
         }
+        rtIO->commitChanges(changes);
         statusTxt.appendPlainText(QString("limitMakeupWidgetHandle: Set limiter makeup gain of channel ") + QString::number(actChan+1)
 						  + QString(" to ") + QString::number(rtIO->getMakeupGain(actChan)) + QString("\n"));
     }  else {
@@ -776,10 +845,12 @@ void MainWindow::limitMakeupWidgetHandle(double gain) {
 
 void MainWindow::limitRelWidgetHandle(double relTime) {
     if (rtIO != nullptr) {
-        rtIO->setReleaseTime(actChan, relTime);
+        CppRTAChangeSet changes = rtIO->beginChanges();
+        changes.setReleaseTime(actChan, relTime);
         if (stereoLockFlag && actChan+1<outDevice.numChans) {
-        	rtIO->setReleaseTime(actChan+1, relTime);
+        	changes.setReleaseTime(actChan+1, relTime);
         }
+        rtIO->commitChanges(changes);
         statusTxt.appendPlainText(QString("limitRelWidgetHandle: Set limiter release time of channel ") + QString::number(actChan+1)
 						  + QString(" to ") + QString::number(rtIO->getReleaseTime(actChan)) + QString("\n"));
     }  else {
@@ -827,50 +898,10 @@ void MainWindow::updateLimiterWidgets() {
 }
 
 int MainWindow::storeParams(const char* fileName) {
-    uint32_t numEQsPerChan, tmpInt;
-    double tmpDouble;
     QString tmpStr = QCoreApplication::applicationDirPath();
 	tmpStr.append(QString("/") + QString(fileName));
-	QByteArray tmpBA = tmpStr.toLatin1();
-	const char *filePath = tmpBA.data();
-    std::ofstream fStr(filePath, std::ios::binary | std::ios::trunc);
-
-    if (fStr.good() && rtIO != nullptr) {
-    	fStr.write((char*)&fs, sizeof(uint32_t));
-    	fStr.write((char*)&outDevice.numChans, sizeof(uint32_t));
-        for (uint32_t i=0; i<outDevice.numChans; i++) {
-        	numEQsPerChan = rtIO->getNumEQs(i);
-        	fStr.write((char*)&numEQsPerChan, sizeof(uint32_t));
-            for (uint32_t j=0; j<numEQsPerChan; j++) {
-                tmpDouble = rtIO->getEqGain(i,j);
-                fStr.write((char*)&tmpDouble, sizeof(double));
-                tmpDouble = rtIO->getEqFrequency(i,j);
-                fStr.write((char*)&tmpDouble, sizeof(double));
-                tmpDouble = rtIO->getEqQFactor(i,j);
-                fStr.write((char*)&tmpDouble, sizeof(double));
-                tmpInt = rtIO->getEqType(i,j);
-                fStr.write((char*)&tmpInt, sizeof(uint32_t));
-            }
-            tmpInt = rtIO->getCutOrder(HIGHPASS, i);
-            fStr.write((char*)&tmpInt, sizeof(uint32_t));
-            tmpInt = (uint32_t) rtIO->getCutCharacteristic(HIGHPASS, i);
-            fStr.write((char*)&tmpInt, sizeof(uint32_t));
-            tmpDouble = rtIO->getCutFrequency(HIGHPASS, i);
-            fStr.write((char*)&tmpDouble, sizeof(double));
-            tmpInt = rtIO->getCutOrder(LOWPASS, i);
-			fStr.write((char*)&tmpInt, sizeof(uint32_t));
-            tmpInt = (uint32_t) rtIO->getCutCharacteristic(LOWPASS, i);
-            fStr.write((char*)&tmpInt, sizeof(uint32_t));
-            tmpDouble = rtIO->getCutFrequency(LOWPASS, i);
-            fStr.write((char*)&tmpDouble, sizeof(double));
-
-            tmpDouble = rtIO->getThreshold(i);
-            fStr.write((char*)&tmpDouble, sizeof(double));
-            tmpDouble = rtIO->getMakeupGain(i);
-            fStr.write((char*)&tmpDouble, sizeof(double));
-            tmpDouble = rtIO->getReleaseTime(i);
-            fStr.write((char*)&tmpDouble, sizeof(double));
-        }
+
+    if (CppPreset::store(rtIO, tmpStr.toStdString(), fs) == 0) {
         statusTxt.appendPlainText(QString("storeParams: Successfully stored current parameters in <") + tmpStr + QString(">.") + QString("\n"));
         return 0;
     } else {
@@ -880,50 +911,10 @@ int MainWindow::storeParams(const char* fileName) {
 }
 
 int MainWindow::loadParams(const char* fileName) {
-    uint32_t tmpInt, numOutChansFile, numEQsPerChan;
-    double tmpDouble;
     QString tmpStr = QCoreApplication::applicationDirPath();
 	tmpStr.append(QString("/") + QString(fileName));
-	QByteArray tmpBA = tmpStr.toLatin1();
-	const char *filePath = tmpBA.data();
-    std::ifstream fStr(filePath, std::ios::binary);
-
-    if (fStr.good() && rtIO != nullptr) {
-        fStr.read((char*)&fs, sizeof(uint32_t));
-        fStr.read((char*)&numOutChansFile, sizeof(uint32_t));
-        for (uint32_t i=0; i<outDevice.numChans && i<numOutChansFile; i++) {
-        	fStr.read((char*)&numEQsPerChan, sizeof(uint32_t));
-        	rtIO->setNumEQs(i, numEQsPerChan);
-            for (uint32_t j=0; j<numEQsPerChan; j++) {
-                fStr.read((char*)&tmpDouble, sizeof(double));
-                rtIO->setEqGain(i, j, tmpDouble);
-                fStr.read((char*)&tmpDouble, sizeof(double));
-                rtIO->setEqFrequency(i, j, tmpDouble);
-                fStr.read((char*)&tmpDouble, sizeof(double));
-                rtIO->setEqQFactor(i, j, tmpDouble);
-                fStr.read((char*)&tmpInt, sizeof(uint32_t));
-                rtIO->setEqType(i, j, (eqType)tmpInt);
-            }
-			fStr.read((char*)&tmpInt, sizeof(uint32_t));
-			rtIO->setCutOrder(HIGHPASS, i, tmpInt);
-            fStr.read((char*)&tmpInt, sizeof(uint32_t));
-			rtIO->setCutCharacteristic(HIGHPASS, i, (filterChar) tmpInt);
-			fStr.read((char*)&tmpDouble, sizeof(double));
-			rtIO->setCutFrequency(HIGHPASS, i, tmpDouble);
-			fStr.read((char*)&tmpInt, sizeof(uint32_t));
-			rtIO->setCutOrder(LOWPASS, i, tmpInt);
-			fStr.read((char*)&tmpInt, sizeof(uint32_t));
-			rtIO->setCutCharacteristic(LOWPASS, i, (filterChar) tmpInt);
-			fStr.read((char*)&tmpDouble, sizeof(double));
-			rtIO->setCutFrequency(LOWPASS, i, tmpDouble);
-
-            fStr.read((char*)&tmpDouble, sizeof(double));
-            rtIO->setThreshold(i, tmpDouble);
-            fStr.read((char*)&tmpDouble, sizeof(double));
-            rtIO->setMakeupGain(i, tmpDouble);
-            fStr.read((char*)&tmpDouble, sizeof(double));
-            rtIO->setReleaseTime(i, tmpDouble);
-        }
+
+    if (CppPreset::load(rtIO, tmpStr.toStdString(), fs) == 0) {
 		this->updateEQWidgets();
 		this->updateCutWidgets();
 		this->updateLimiterWidgets();
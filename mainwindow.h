@@ -4,6 +4,7 @@
 #include <QMainWindow>
 #include <QPushButton>
 #include <QPlainTextEdit>
+#include <QTimer>
 #include <vector>
 
 #include "qcustomplot.h"
@@ -29,6 +30,8 @@ private slots:
     void inDeviceMenuHandle(QAction *currentAction);
     void outDeviceMenuHandle(QAction *currentAction);
     void copyMenuHandle(QAction *currentAction);
+    void deviceListUpdate();
+    void deviceListRequest();
 
     void channelWidgetHandle(double chanNr);
     void eqNrWidgetHandle(double eqNr);
@@ -70,6 +73,8 @@ private:
 
     QPlainTextEdit statusTxt;
 
+    QTimer deviceTimer;
+
     QMenuBar menuBar;
     QMenu *settingsMenu, *blockLenMenu, *sampleRateMenu, *hostApiMenu, *inDeviceMenu,
           *outDeviceMenu, *copyMenu;
@@ -81,6 +86,7 @@ private:
     std::string hostAPI;
     deviceContainerRTA inDevice, outDevice;
 
+    uint64_t deviceGeneration;
     uint32_t blockLenIO, fs, actChan;
     bool streamFlag, tenTimesFlag, stereoLockFlag;
 };